@@ -1,18 +1,30 @@
 #pragma once
 
 
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include <thread/lock.hpp>
 #include <boost/any.hpp>
 #include <boost/serialization/singleton.hpp>
 #include <bus/func_traits.hpp>
 #include <logger/logger.hpp>
-#include <timer/timer_message.hpp>
+#include <common/metrics.hpp>
+#include <message/message.hpp>
 
 
 #define MSG_BUS boost::serialization::singleton<micro::core::message_bus>::get_mutable_instance()
 #define MSG_BUS_SUB MSG_BUS.subscribe
 #define MSG_BUS_PUB MSG_BUS.publish
+#define MSG_BUS_PUB_ASYNC MSG_BUS.publish_async
+#define MSG_BUS_FLUSH MSG_BUS.flush
+#define MSG_BUS_FLUSH_IDLE MSG_BUS.flush_idle
+
+#define MAX_BUS_OUTBOUND_MSG_COUNT                 1024
 
 
 namespace micro
@@ -28,7 +40,78 @@ namespace micro
             typedef std::unordered_multimap<std::string, any_type> invokers_type;
             typedef std::unordered_multimap<std::string, any_type>::iterator iterator_type;
 
-            message_bus() : m_msg_invokers(128) {}
+            typedef std::shared_ptr<message> msg_ptr_type;
+            typedef std::vector<msg_ptr_type> batch_type;
+            typedef std::function<int32_t(const batch_type &)> batch_functor_type;
+            typedef std::function<int32_t(msg_ptr_type &)> msg_functor_type;
+            typedef std::unordered_map<std::string, batch_type> batches_type;
+
+            //per thread pending messages of async publish, owner thread flushes, timer flushes it when owner stays idle
+            //batches taken out under m_mutex and delivered without lock; one delivery at a time keeps order of thread's messages
+            class outbound_buffer
+            {
+            public:
+
+                outbound_buffer() : m_count(0), m_delivering(false), m_flush_gen(0), m_seen_gen(0) {}
+
+                std::mutex m_mutex;                         //m_batches, m_count, m_delivering and generations
+
+                size_t m_count;
+
+                bool m_delivering;                          //m_flushing taken by owner or timer, flush meanwhile leaves messages for next round
+
+                uint64_t m_flush_gen;                       //taken by flush so far
+
+                uint64_t m_seen_gen;                        //flush generation when timer last found messages pending
+
+                batches_type m_batches;
+
+                batches_type m_flushing;
+            };
+
+            typedef std::shared_ptr<outbound_buffer> buffer_ptr_type;
+
+            //thread local owner, pending messages delivered when thread exits
+            class outbound_buffer_holder
+            {
+            public:
+
+                outbound_buffer_holder(message_bus *bus) : m_bus(bus), m_buf(std::make_shared<outbound_buffer>()) { bus->register_buffer(m_buf); }
+
+                ~outbound_buffer_holder()
+                {
+                    try
+                    {
+                        //timer may be delivering earlier messages of this thread
+                        bool taken = false;
+                        while (!(taken = m_bus->begin_delivery(*m_buf)) && m_bus->pending(*m_buf))
+                        {
+                            std::this_thread::yield();
+                        }
+
+                        if (taken)
+                        {
+                            m_bus->deliver(*m_buf);
+                        }
+                    }
+                    catch (...)
+                    {
+                        LOG_ERROR << "message bus flush exception on thread exit";
+                    }
+                }
+
+                message_bus *m_bus;
+
+                buffer_ptr_type m_buf;
+            };
+
+            message_bus()
+                : m_msg_invokers(128)
+                , m_max_outbound_count(MAX_BUS_OUTBOUND_MSG_COUNT)
+                , m_published(METRICS_COUNTER("micro_bus_published_total", "Messages published to message bus.", "mode=\"sync\""))
+                , m_published_async(METRICS_COUNTER("micro_bus_published_total", "Messages published to message bus.", "mode=\"async\""))
+                , m_flushed_batches(METRICS_COUNTER("micro_bus_flushed_batches_total", "Batches delivered by message bus flush."))
+            {}
             virtual ~message_bus() { w_lock_guard lock_guard(m_mutex); m_msg_invokers.clear(); }
 
         public:
@@ -70,10 +153,7 @@ namespace micro
                 using function_type = std::function<ret_type(args_type...)>;
                 std::string msg_type = topic + "|" + typeid(function_type).name();
 
-                if (topic != BROADCAST_TIMER_TICK)
-                {
-                    //LOG_DEBUG << "message bus publish: " << msg_type;
-                }
+                m_published.add();
 
                 r_lock_guard lock_guard(m_mutex);
                 auto range = m_msg_invokers.equal_range(msg_type);
@@ -96,6 +176,8 @@ namespace micro
             {
                 std::string msg_type = topic + "|" + typeid(function_type).name();
 
+                m_published.add();
+
                 r_lock_guard lock_guard(m_mutex);
                 auto range = m_msg_invokers.equal_range(msg_type);
                 if (range.first == m_msg_invokers.end())
@@ -111,12 +193,240 @@ namespace micro
                 }
             }
 
+            //publish message to bus asynchronously: buffered in calling thread and delivered in batch by flush
+            void publish_async(const std::string &topic, msg_ptr_type msg)
+            {
+                outbound_buffer &buf = local_outbound_buffer();
+                m_published_async.add();
+
+                size_t count = 0;
+                {
+                    std::unique_lock<std::mutex> lock(buf.m_mutex);
+                    buf.m_batches[topic].push_back(std::move(msg));
+                    count = ++buf.m_count;
+                }
+
+                if (count >= m_max_outbound_count)
+                {
+                    flush();
+                }
+            }
+
+            //deliver messages buffered by publish_async in calling thread, one batch per topic and subscriber
+            //flush called by subscriber, or while timer delivers earlier messages, leaves them to next flush
+            void flush()
+            {
+                outbound_buffer &buf = local_outbound_buffer();
+                if (begin_delivery(buf))
+                {
+                    deliver(buf);
+                }
+            }
+
+            //timer: deliver buffers of threads that did not flush since previous call, e.g. threads without loop
+            void flush_idle()
+            {
+                std::vector<buffer_ptr_type> buffers;
+                {
+                    std::unique_lock<std::mutex> lock(m_buffers_mutex);
+
+                    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [](const std::weak_ptr<outbound_buffer> &buf) { return buf.expired(); }), m_buffers.end());
+                    for (auto &buf : m_buffers)
+                    {
+                        if (buffer_ptr_type ptr = buf.lock())
+                        {
+                            buffers.push_back(ptr);
+                        }
+                    }
+                }
+
+                for (auto &buf : buffers)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(buf->m_mutex);
+                        if (0 == buf->m_count)
+                        {
+                            continue;
+                        }
+
+                        //first sighting: give owner one period to flush itself
+                        if (buf->m_seen_gen != buf->m_flush_gen + 1)
+                        {
+                            buf->m_seen_gen = buf->m_flush_gen + 1;
+                            continue;
+                        }
+                    }
+
+                    //owner flushing right now otherwise
+                    if (begin_delivery(*buf))
+                    {
+                        deliver(*buf);
+                    }
+                }
+            }
+
+            void set_max_outbound_count(size_t count) { m_max_outbound_count = std::max(count, (size_t)1); }
+
+        protected:
+
+            //end delivery however it leaves, subscriber may throw
+            class delivery_guard
+            {
+            public:
+
+                delivery_guard(outbound_buffer &buf) : m_buf(buf) {}
+
+                ~delivery_guard()
+                {
+                    std::unique_lock<std::mutex> lock(m_buf.m_mutex);
+                    m_buf.m_delivering = false;
+                }
+
+                outbound_buffer &m_buf;
+            };
+
+            //clears batches left by subscriber exception so next round does not deliver them twice
+            class batches_guard
+            {
+            public:
+
+                batches_guard(batches_type &batches) : m_batches(batches) {}
+
+                ~batches_guard()
+                {
+                    for (auto &batch : m_batches)
+                    {
+                        batch.second.clear();
+                    }
+                }
+
+                batches_type &m_batches;
+            };
+
+            //false: nothing pending or buffer delivered by other thread right now
+            bool begin_delivery(outbound_buffer &buf)
+            {
+                std::unique_lock<std::mutex> lock(buf.m_mutex);
+                if (0 == buf.m_count || buf.m_delivering)
+                {
+                    return false;
+                }
+
+                buf.m_delivering = true;
+                buf.m_flushing.swap(buf.m_batches);
+                buf.m_count = 0;
+                buf.m_flush_gen++;
+
+                return true;
+            }
+
+            bool pending(outbound_buffer &buf)
+            {
+                std::unique_lock<std::mutex> lock(buf.m_mutex);
+                return 0 != buf.m_count;
+            }
+
+            //after begin_delivery, no lock held: subscribers may publish, flush or subscribe
+            void deliver(outbound_buffer &buf)
+            {
+                delivery_guard end_delivery(buf);
+                batches_guard clear_flushing(buf.m_flushing);
+
+                std::vector<batch_functor_type> batch_functors;
+                std::vector<msg_functor_type> msg_functors;
+
+                for (auto &batch : buf.m_flushing)
+                {
+                    if (batch.second.empty())
+                    {
+                        continue;
+                    }
+
+                    m_flushed_batches.add();
+
+                    batch_functors.clear();
+                    msg_functors.clear();
+                    get_batch_functors(batch.first, batch_functors, msg_functors);
+
+                    //subscribers called without bus lock, they may subscribe or publish
+                    for (auto &f : batch_functors)
+                    {
+                        f(batch.second);
+                    }
+
+                    for (auto &f : msg_functors)
+                    {
+                        for (auto &msg : batch.second)
+                        {
+                            f(msg);
+                        }
+                    }
+
+                    batch.second.clear();                   //keep capacity for next round
+                }
+            }
+
+            //batch subscribers of topic, else single message subscribers
+            void get_batch_functors(const std::string &topic, std::vector<batch_functor_type> &batch_functors, std::vector<msg_functor_type> &msg_functors)
+            {
+                static const std::string batch_type_name = std::string("|") + typeid(batch_functor_type).name();
+                static const std::string msg_type_name = std::string("|") + typeid(msg_functor_type).name();
+
+                r_lock_guard lock_guard(m_mutex);
+
+                auto range = m_msg_invokers.equal_range(topic + batch_type_name);
+                for (iterator_type it = range.first; it != range.second; it++)
+                {
+                    batch_functors.push_back(boost::any_cast<batch_functor_type>(it->second));
+                }
+
+                if (!batch_functors.empty())
+                {
+                    return;
+                }
+
+                range = m_msg_invokers.equal_range(topic + msg_type_name);
+                if (range.first == range.second)
+                {
+                    LOG_ERROR << "could not find topic invoke function: " << topic;
+                }
+
+                for (iterator_type it = range.first; it != range.second; it++)
+                {
+                    msg_functors.push_back(boost::any_cast<msg_functor_type>(it->second));
+                }
+            }
+
+            void register_buffer(const buffer_ptr_type &buf)
+            {
+                std::unique_lock<std::mutex> lock(m_buffers_mutex);
+                m_buffers.push_back(buf);
+            }
+
+            outbound_buffer & local_outbound_buffer()
+            {
+                static thread_local outbound_buffer_holder holder(this);
+                return *holder.m_buf;
+            }
+
         protected:
 
             rw_mutex m_mutex;
 
             invokers_type m_msg_invokers;
 
+            std::atomic<size_t> m_max_outbound_count;
+
+            std::mutex m_buffers_mutex;
+
+            std::vector<std::weak_ptr<outbound_buffer>> m_buffers;          //outbound buffer of every thread that published async
+
+            metrics_counter &m_published;
+
+            metrics_counter &m_published_async;
+
+            metrics_counter &m_flushed_batches;
+
         };
 
     }
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <functional>
+#include <boost/serialization/singleton.hpp>
+#include <thread/lock.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+
+#define METRICS boost::serialization::singleton<micro::core::metrics_registry>::get_mutable_instance()
+#define METRICS_COUNTER METRICS.counter
+#define METRICS_GAUGE METRICS.gauge
+
+#define METRICS_SHARD_COUNT                 16                      //power of 2
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //monotonic counter, each thread adds to its own cache line, summed when read
+        class metrics_counter
+        {
+        public:
+
+            metrics_counter() = default;
+
+            metrics_counter(const metrics_counter &) = delete;
+
+            metrics_counter & operator=(const metrics_counter &) = delete;
+
+            void add(uint64_t n = 1) { m_shards[shard_idx()].m_value.fetch_add(n, std::memory_order_relaxed); }
+
+            uint64_t value() const
+            {
+                uint64_t sum = 0;
+                for (auto &shard : m_shards)
+                {
+                    sum += shard.m_value.load(std::memory_order_relaxed);
+                }
+
+                return sum;
+            }
+
+        protected:
+
+            //threads spread over shards round robin on first use
+            static size_t shard_idx() { return thread_slot_idx() & (METRICS_SHARD_COUNT - 1); }
+
+            struct alignas(CACHE_LINE_SIZE) shard
+            {
+                std::atomic<uint64_t> m_value{ 0 };
+            };
+
+            shard m_shards[METRICS_SHARD_COUNT];
+        };
+
+        //metric families with labelled series, exported in prometheus text format
+        //counters live as long as registry, gauges are sampled on export and removed by owner
+        //gauges registered twice with same name and labels (e.g. modules sharing a name) are exported once,
+        //first registered one is sampled, next one takes over when it is removed
+        class metrics_registry
+        {
+        public:
+
+            typedef std::function<double()> sampler_type;
+
+            typedef uint64_t gauge_id_type;
+
+            metrics_registry() : m_next_gauge_id(0) {}
+
+            //same name and labels return same counter, labels: k1="v1",k2="v2"
+            metrics_counter & counter(const std::string &name, const std::string &help, const std::string &labels = std::string())
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                family &f = get_family(name, help, "counter");
+                for (auto &s : f.m_series)
+                {
+                    if (s.m_labels == labels && s.m_counter)
+                    {
+                        return *s.m_counter;
+                    }
+                }
+
+                series s;
+                s.m_labels = labels;
+                s.m_counter = std::allocate_shared<metrics_counter>(cache_aligned_allocator<metrics_counter>());
+                f.m_series.push_back(s);
+
+                return *s.m_counter;
+            }
+
+            //sampler called on export thread, owner removes gauge before sampler state is gone
+            gauge_id_type gauge(const std::string &name, const std::string &help, const std::string &labels, sampler_type sampler)
+            {
+                return add_sampler(name, help, "gauge", labels, sampler);
+            }
+
+            //monotonic value kept elsewhere, like thread cpu time, sampled on export
+            gauge_id_type counter_func(const std::string &name, const std::string &help, const std::string &labels, sampler_type sampler)
+            {
+                return add_sampler(name, help, "counter", labels, sampler);
+            }
+
+            void remove_gauge(gauge_id_type id)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                for (auto &it : m_families)
+                {
+                    auto &all = it.second.m_series;
+                    for (auto s = all.begin(); s != all.end(); s++)
+                    {
+                        if (s->m_gauge_id == id)
+                        {
+                            all.erase(s);
+                            return;
+                        }
+                    }
+                }
+            }
+
+            //prometheus text exposition format 0.0.4
+            std::string to_prometheus()
+            {
+                std::ostringstream os;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (auto &it : m_families)
+                {
+                    const family &f = it.second;
+                    if (f.m_series.empty())
+                    {
+                        continue;
+                    }
+
+                    os << "# HELP " << it.first << " " << f.m_help << "\n";
+                    os << "# TYPE " << it.first << " " << f.m_type << "\n";
+
+                    std::set<std::string> seen;
+                    for (auto &s : f.m_series)
+                    {
+                        if (!seen.insert(s.m_labels).second)
+                        {
+                            continue;
+                        }
+
+                        os << it.first;
+                        if (!s.m_labels.empty())
+                        {
+                            os << "{" << s.m_labels << "}";
+                        }
+
+                        os << " ";
+                        write_value(os, s);
+                        os << "\n";
+                    }
+                }
+
+                return os.str();
+            }
+
+            //name{labels} --> value, for debug output
+            std::map<std::string, double> snapshot()
+            {
+                std::map<std::string, double> values;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (auto &it : m_families)
+                {
+                    for (auto &s : it.second.m_series)
+                    {
+                        //first registered of duplicate series wins, as in to_prometheus
+                        values.insert({ s.m_labels.empty() ? it.first : it.first + "{" + s.m_labels + "}", sample(s) });
+                    }
+                }
+
+                return values;
+            }
+
+            //cpu time consumed by thread, loop busy time when thread only runs event loop
+            static double thread_cpu_seconds(std::thread::native_handle_type thread)
+            {
+#ifdef _WIN32
+                FILETIME creation, exit, kernel, user;
+                if (!GetThreadTimes(thread, &creation, &exit, &kernel, &user))
+                {
+                    return 0;
+                }
+
+                uint64_t ticks = ((uint64_t)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) + ((uint64_t)user.dwHighDateTime << 32 | user.dwLowDateTime);
+                return ticks / 1e7;
+#else
+                clockid_t clock;
+                struct timespec ts;
+                if (0 != pthread_getcpuclockid(thread, &clock) || 0 != clock_gettime(clock, &ts))
+                {
+                    return 0;
+                }
+
+                return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+            }
+
+            //label value escaped for prometheus
+            static std::string escape(const std::string &value)
+            {
+                std::string out;
+                out.reserve(value.size());
+
+                for (char c : value)
+                {
+                    if ('\\' == c || '"' == c)
+                    {
+                        out.push_back('\\');
+                        out.push_back(c);
+                    }
+                    else if ('\n' == c)
+                    {
+                        out.append("\\n");
+                    }
+                    else
+                    {
+                        out.push_back(c);
+                    }
+                }
+
+                return out;
+            }
+
+        protected:
+
+            class series
+            {
+            public:
+
+                std::string m_labels;
+
+                std::shared_ptr<metrics_counter> m_counter;
+
+                sampler_type m_sampler;
+
+                gauge_id_type m_gauge_id = 0;
+            };
+
+            class family
+            {
+            public:
+
+                std::string m_help;
+
+                std::string m_type;
+
+                std::vector<series> m_series;
+            };
+
+            gauge_id_type add_sampler(const std::string &name, const std::string &help, const char *type, const std::string &labels, sampler_type sampler)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                series s;
+                s.m_labels = labels;
+                s.m_sampler = sampler;
+                s.m_gauge_id = ++m_next_gauge_id;
+
+                get_family(name, help, type).m_series.push_back(s);
+                return s.m_gauge_id;
+            }
+
+            family & get_family(const std::string &name, const std::string &help, const char *type)
+            {
+                family &f = m_families[name];
+                if (f.m_type.empty())
+                {
+                    f.m_help = help;
+                    f.m_type = type;
+                }
+
+                return f;
+            }
+
+            //counters exact, integral gauges without exponent
+            static void write_value(std::ostream &os, const series &s)
+            {
+                if (s.m_counter)
+                {
+                    os << s.m_counter->value();
+                    return;
+                }
+
+                double value = sample(s);
+                if (std::isnan(value))
+                {
+                    os << "NaN";
+                }
+                else if (std::isinf(value))
+                {
+                    os << (value > 0 ? "+Inf" : "-Inf");
+                }
+                else if (std::fabs(value) < 1e15 && value == (double)(int64_t)value)
+                {
+                    os << (int64_t)value;
+                }
+                else
+                {
+                    os << std::setprecision(12) << value;
+                }
+            }
+
+            static double sample(const series &s)
+            {
+                if (s.m_counter)
+                {
+                    return (double)s.m_counter->value();
+                }
+
+                try
+                {
+                    return s.m_sampler ? s.m_sampler() : 0;
+                }
+                catch (...)
+                {
+                    return 0;
+                }
+            }
+
+        protected:
+
+            std::mutex m_mutex;
+
+            gauge_id_type m_next_gauge_id;
+
+            std::map<std::string, family> m_families;               //sorted by name for stable output
+        };
+
+    }
+
+}
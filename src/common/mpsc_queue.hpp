@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //intrusive multi producer single consumer queue, node type has T *m_next
+        //producers push with one cas, consumer takes whole list at once and gets it back in push order
+        template<typename T>
+        class mpsc_queue
+        {
+        public:
+
+            mpsc_queue() : m_head(nullptr) {}
+
+            mpsc_queue(const mpsc_queue &) = delete;
+
+            mpsc_queue & operator=(const mpsc_queue &) = delete;
+
+            //true: queue was empty, consumer needs wake up
+            bool push(T *node)
+            {
+                T *head = m_head.load(std::memory_order_relaxed);
+                do
+                {
+                    node->m_next = head;
+                } while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+
+                return nullptr == head;
+            }
+
+            //consumer only: all pushed nodes, oldest first, linked by m_next
+            T * pop_all()
+            {
+                T *node = m_head.exchange(nullptr, std::memory_order_acquire);
+
+                //pushed as stack, reverse to fifo
+                T *first = nullptr;
+                while (node)
+                {
+                    T *next = node->m_next;
+                    node->m_next = first;
+                    first = node;
+                    node = next;
+                }
+
+                return first;
+            }
+
+            bool empty() const { return nullptr == m_head.load(std::memory_order_relaxed); }
+
+        protected:
+
+            std::atomic<T *> m_head;
+        };
+
+    }
+
+}
@@ -47,6 +47,8 @@ namespace micro
 
             virtual void fire_channel_read_complete() = 0;
 
+            virtual void fire_channel_batch_read_complete() = 0;
+
             virtual void fire_channel_write() = 0;
 
             virtual void fire_channel_write_complete() = 0;
@@ -104,6 +104,11 @@ namespace micro
                 if (m_head) m_head->fire_channel_read_complete();
             }
 
+            virtual void fire_channel_batch_read_complete()
+            {
+                if (m_head) m_head->fire_channel_batch_read_complete();
+            }
+
             virtual void fire_channel_write()
             {
                 if (m_head) m_head->fire_channel_write();
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <io/http_server.hpp>
+#include <io/http_router.hpp>
+#include <common/metrics.hpp>
+
+
+#define HTTP_ADMIN_METRICS_PATH             "/metrics"
+#define HTTP_ADMIN_DEBUG_VARS_PATH          "/debug/vars"
+#define HTTP_ADMIN_METRICS_CONTENT_TYPE     "text/plain; version=0.0.4; charset=utf-8"
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //admin endpoints: prometheus metrics and json dump of framework counters
+        //standalone admin server runs until stopped or destroyed, like http_server
+        class http_admin
+        {
+        public:
+
+            http_admin() : m_server(m_router.functor())
+            {
+                attach(m_router);
+            }
+
+            //standalone admin server on its own loop
+            int32_t listen(const std::string &ip, uint16_t port)
+            {
+                return m_server.listen(ip, port, 1);
+            }
+
+            void stop() { m_server.stop(); }
+
+            //add admin routes to router of existing server
+            static void attach(http_router &router)
+            {
+                router.get(HTTP_ADMIN_METRICS_PATH, [](http_req &req, http_rsp &rsp)
+                {
+                    rsp.set_header("Content-Type", HTTP_ADMIN_METRICS_CONTENT_TYPE);
+                    rsp.end(METRICS.to_prometheus());
+                });
+
+                router.get(HTTP_ADMIN_DEBUG_VARS_PATH, [](http_req &req, http_rsp &rsp)
+                {
+                    rsp.set_header("Content-Type", "application/json");
+                    rsp.end(debug_vars());
+                });
+            }
+
+            static std::string debug_vars()
+            {
+                std::ostringstream os;
+                os << std::setprecision(12) << "{";
+
+                bool first = true;
+                for (auto &it : METRICS.snapshot())
+                {
+                    os << (first ? "\n" : ",\n") << "  \"";
+                    first = false;
+
+                    for (char c : it.first)
+                    {
+                        if ('"' == c || '\\' == c)
+                        {
+                            os << '\\';
+                        }
+
+                        os << c;
+                    }
+
+                    //json has no NaN / Infinity
+                    os << "\": ";
+                    if (std::isfinite(it.second))
+                    {
+                        os << it.second;
+                    }
+                    else
+                    {
+                        os << "null";
+                    }
+                }
+
+                os << "\n}\n";
+                return os.str();
+            }
+
+        protected:
+
+            http_router m_router;
+
+            http_server m_server;
+        };
+
+    }
+
+}
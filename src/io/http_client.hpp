@@ -1,25 +1,279 @@
 #pragma once
 
+#include <map>
+#include <deque>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include <functional>
+#include <unordered_map>
 #include <io/http_macro.hpp>
+#include <logger/logger.hpp>
 #include <thread/uv_thread_pool.hpp>
 
 
+#define DEFAULT_HTTP_CLIENT_MAX_CONNS           8                       //per host
+#define DEFAULT_HTTP_CLIENT_PIPELINE_DEPTH      4                       //requests in flight per connection
+#define DEFAULT_HTTP_CLIENT_IDLE_TIMEOUT        30000                   //ms, idle pooled connection closed
+#define DEFAULT_HTTP_DNS_TTL                    60000                   //ms
+#define HTTP_CLIENT_MAX_RETRIES                 1                       //idempotent request on reused connection
+
+
 namespace micro
 {
     namespace core
     {
 
+        //response of client request, views valid while response holds the chunk
+        class http_client_rsp
+        {
+        public:
+
+            int32_t m_error = 0;                            //0 or uv error code: UV_ECONNREFUSED, UV_EAI_NONAME...
+
+            int m_status_code = 0;
+
+            http_headers m_headers;
+
+            boost::string_view m_body;
+
+            http_chunk::ptr_type m_chunk;
+        };
+
+        class http_client_conn;
+
+        //request builder: method, target, headers, body, callback and timeout
+        class http_client_req
+        {
+        public:
+
+            typedef std::function<void(http_client_rsp &rsp)> callback_type;
+
+            typedef std::shared_ptr<http_client_req> ptr_type;
+
+            typedef std::multimap<uint64_t, ptr_type> deadline_map_type;
+
+            http_client_req() = default;
+
+            http_client_req(const std::string &method, const std::string &url) : m_method(method)
+            {
+                set_url(url);
+            }
+
+            //url: http://host[:port][/path][?query]
+            http_client_req & set_url(const std::string &url)
+            {
+                if (ERR_SUCCESS != parse_url(url, m_host, m_port, m_target))
+                {
+                    LOG_ERROR << "http client invalid url: " << url;
+                    m_host.clear();
+                }
+
+                return *this;
+            }
+
+            http_client_req & set_method(const std::string &method) { m_method = method; return *this; }
+
+            //Host, Connection and Content-Length are added unless set here
+            http_client_req & set_header(const std::string &name, const std::string &value)
+            {
+                m_headers.emplace_back(name, value);
+                return *this;
+            }
+
+            http_client_req & set_body(std::string body)
+            {
+                auto owner = std::make_shared<const std::string>(std::move(body));
+                return set_body(boost::string_view(*owner), owner);
+            }
+
+            //zero copy: body written straight from data, owner keeps it alive until written
+            http_client_req & set_body(boost::string_view data, std::shared_ptr<const void> owner)
+            {
+                m_body = data;
+                m_body_owner = owner;
+                return *this;
+            }
+
+            //ms from submit to response, 0: no timeout
+            http_client_req & set_timeout(uint64_t timeout) { m_timeout = timeout; return *this; }
+
+            http_client_req & set_callback(callback_type callback) { m_callback = callback; return *this; }
+
+            bool has_header(const char *name) const
+            {
+                for (auto &it : m_headers)
+                {
+                    if (http_iequals(it.first, name))
+                    {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            //idempotent requests may be sent again when reused connection closed before response
+            bool idempotent() const
+            {
+                return "GET" == m_method || "HEAD" == m_method || "PUT" == m_method || "DELETE" == m_method || "OPTIONS" == m_method;
+            }
+
+            static int32_t parse_url(const std::string &url, std::string &host, uint16_t &port, std::string &target)
+            {
+                size_t pos = 0;
+                if (0 == url.compare(0, 7, "http://"))
+                {
+                    pos = 7;
+                }
+                else if (std::string::npos != url.find("://"))
+                {
+                    return ERR_FAILED;
+                }
+
+                size_t path = url.find_first_of("/?", pos);
+                std::string authority = url.substr(pos, path == std::string::npos ? std::string::npos : path - pos);
+
+                port = 80;
+                size_t colon = authority.rfind(':');
+                if (colon != std::string::npos && authority.find(']', colon) == std::string::npos)
+                {
+                    port = (uint16_t)atoi(authority.c_str() + colon + 1);
+                    authority.resize(colon);
+                }
+
+                //[v6 literal]
+                if (authority.size() > 2 && '[' == authority.front() && ']' == authority.back())
+                {
+                    authority = authority.substr(1, authority.size() - 2);
+                }
+
+                host = authority;
+                target = path == std::string::npos ? "/" : url.substr(path);
+                if ('?' == target[0])
+                {
+                    target.insert(0, "/");
+                }
+
+                return (host.empty() || 0 == port) ? ERR_FAILED : ERR_SUCCESS;
+            }
+
+        public:
+
+            std::string m_method = "GET";
+
+            std::string m_host;
+
+            uint16_t m_port = 80;
+
+            std::string m_target = "/";                     //path and query
+
+            std::vector<std::pair<std::string, std::string>> m_headers;
+
+            boost::string_view m_body;
+
+            std::shared_ptr<const void> m_body_owner;
+
+            uint64_t m_timeout = 0;
+
+            callback_type m_callback;
+
+            //client loop state
+
+            uint32_t m_retries = 0;
+
+            bool m_done = false;                            //callback invoked, timed out requests skipped
+
+            http_client_conn * m_conn = nullptr;            //connection request is in flight on
+
+            bool m_has_deadline = false;
+
+            deadline_map_type::iterator m_deadline;
+        };
+
+        class http_host_pool;
+
+        //pooled keep alive connection to one host, requests pipelined in order
+        class http_client_conn : public http_context
+        {
+        public:
+
+            typedef std::shared_ptr<http_client_req> req_ptr_type;
+
+            http_client_conn(http_host_pool *host) : m_host(host), m_connected(false) {}
+
+            bool available(uint32_t depth) const { return m_connected && !m_closing && !m_no_more_req && m_inflight.size() < depth; }
+
+            //requests are written in order, responses matched to m_inflight
+            void send(http_write_req *write_req) { do_write(write_req, false); }
+
+        protected:
+
+            virtual void on_closing();
+
+        public:
+
+            http_host_pool * m_host;
+
+            bool m_connected;
+
+            std::deque<req_ptr_type> m_inflight;            //sent, waiting for response in order
+        };
+
+        //connections and waiting requests of one host:port
+        class http_host_pool
+        {
+        public:
+
+            typedef std::shared_ptr<http_client_req> req_ptr_type;
+
+            http_host_pool(const std::string &host, uint16_t port) : m_host(host), m_port(port), m_connecting(0), m_resolving(false) {}
+
+        public:
+
+            std::string m_host;
+
+            uint16_t m_port;
+
+            std::deque<req_ptr_type> m_waiting;             //not yet sent
+
+            std::vector<http_client_conn *> m_conns;
+
+            uint32_t m_connecting;
+
+            bool m_resolving;
+        };
+
+        //resolved address of host:port, expires after ttl
+        class http_dns_entry
+        {
+        public:
+
+            struct sockaddr_storage m_addr;
+
+            uint64_t m_expire = 0;                          //loop time ms
+        };
+
         class http_client
         {
         public:
 
             typedef std::function<void(http_rsp & rsp)> svc_functor;
 
+            typedef std::shared_ptr<http_client_req> req_ptr_type;
+
+            typedef std::shared_ptr<http_host_pool> host_ptr_type;
+
             template<typename Type>
             friend void attachEvents(Type* instance, http_parser_settings& settings);
 
-            struct Options 
+            friend class http_client_conn;
+
+            struct Options
             {
                 std::string host = "localhost";
 
@@ -30,14 +284,17 @@ namespace micro
                 std::string url = "/";
             };
 
+            //requests sent by request(), callbacks run on client loop thread
+            http_client()
+            {
+                init();
+            }
+
+            //connect() sends request of options to functor
             http_client(Options o, svc_functor functor) : m_functor(functor)
             {
                 m_opts = o;
-
-                m_pool.init();
-                m_pool.start();
-
-                //connect();
+                init();
             }
 
             http_client(std::string ustr, svc_functor functor) : m_functor(functor)
@@ -46,199 +303,794 @@ namespace micro
 
                 m_opts.host = u.host;
 
-                if (u.port) 
+                if (u.port > 0)
                 {
                     m_opts.port = u.port;
                 }
 
-                if (!u.path.empty()) 
+                if (!u.path.empty())
                 {
                     m_opts.url = u.path;
                 }
 
-                m_pool.init();
-                m_pool.start();
-
-                //connect();
+                init();
             }
 
-            ~http_client() 
+            ~http_client()
             {
-            m_pool.stop();
-            m_pool.exit();
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_stopping = true;
+                }
+
+                uv_async_send(&m_async);
+
+                m_pool.stop();
+                m_pool.exit();
             }
 
             void connect()
             {
-                struct addrinfo ai;
-                ai.ai_family = PF_INET;
-                ai.ai_socktype = SOCK_STREAM;
-                ai.ai_protocol = IPPROTO_TCP;
-                ai.ai_flags = 0;
+                request(m_opts.method, m_opts.host, (uint16_t)m_opts.port, m_opts.url, [this](http_client_rsp &crsp)
+                {
+                    http_rsp rsp;
+                    rsp.m_status_code = crsp.m_status_code;
+                    rsp.m_body = crsp.m_body.to_string();
 
-                m_loop = m_pool.get_loop();
+                    m_functor(rsp);
+                });
+            }
 
-                static std::function<void(uv_getaddrinfo_t* req, int status, struct addrinfo* res)> on_resolved;
+            //thread safe, callback runs on client loop thread, req callback replaced
+            int32_t send(http_client_req req, http_client_req::callback_type callback)
+            {
+                req.m_callback = callback;
+                return send(std::move(req));
+            }
 
-                static std::function<void(uv_connect_t* req, int status)> on_before_connect;
+            //response delivered by future, views in response stay valid with it
+            std::future<http_client_rsp> send_future(http_client_req req)
+            {
+                auto promise = std::make_shared<std::promise<http_client_rsp>>();
+                std::future<http_client_rsp> future = promise->get_future();
 
-                on_before_connect = [&](uv_connect_t* req, int status) 
+                req.m_callback = [promise](http_client_rsp &rsp) { promise->set_value(rsp); };
+                if (ERR_SUCCESS != send(std::move(req)))
                 {
+                    http_client_rsp rsp;
+                    rsp.m_error = UV_ECANCELED;
+                    promise->set_value(rsp);
+                }
 
-                    // @TODO
-                    // Populate address and time info for logging / stats etc.
+                return future;
+            }
 
-                    on_connect(req, status);
-                };
+            int32_t send(http_client_req req)
+            {
+                if (req.m_host.empty())
+                {
+                    return ERR_FAILED;
+                }
 
-                on_resolved = [&](uv_getaddrinfo_t* req, int status, struct addrinfo* res) 
+                if (req.m_target.empty())
                 {
+                    req.m_target = "/";
+                }
 
-                    char addr[17] = { '\0' };
+                return submit(std::make_shared<http_client_req>(std::move(req)));
+            }
 
-                    uv_ip4_name((struct sockaddr_in*) res->ai_addr, addr, 16);
-                    uv_freeaddrinfo(res);
+            //url: http://host[:port][/path][?query]
+            int32_t request(const std::string &method, const std::string &url, http_client_req::callback_type callback)
+            {
+                return send(http_client_req(method, url), callback);
+            }
 
-                    struct sockaddr_in dest;
-                    uv_ip4_addr(addr, m_opts.port, &dest);
+            int32_t request(const std::string &method, const std::string &host, uint16_t port, const std::string &target, http_client_req::callback_type callback)
+            {
+                http_client_req req;
+                req.m_method = method;
+                req.m_host = host;
+                req.m_port = port;
+                req.m_target = target;
 
-                    http_context * context = new http_context();
+                return send(std::move(req), callback);
+            }
 
-                    context->m_handle.data = context;
-                    http_parser_init(&context->m_parser, HTTP_RESPONSE);
-                    context->m_parser.data = context;
+            int32_t get(const std::string &url, http_client_req::callback_type callback) { return request("GET", url, callback); }
 
-                    uv_tcp_init(m_loop, &context->m_handle);
-                    //uv_tcp_keepalive(&context->handle, 1, 60);
+            //pool settings, set before first request
+            void set_max_conns(uint32_t max_conns) { m_max_conns = std::max(max_conns, (uint32_t)1); }
 
-                    uv_tcp_connect(
-                        &context->m_connect_req,
-                        &context->m_handle,
-                        (const struct sockaddr*) &dest,
-                        [](uv_connect_t* req, int status) 
-                    {
-                        on_before_connect(req, status);
-                    });
-                };
+            void set_pipeline_depth(uint32_t depth) { m_pipeline_depth = std::max(depth, (uint32_t)1); }
 
-                auto cb = [](uv_getaddrinfo_t* req, int status, struct addrinfo* res) 
-                {
-                    on_resolved(req, status, res);
-                };
+            void set_idle_timeout(uint64_t idle_timeout) { m_idle_timeout = idle_timeout; }
+
+            void set_dns_ttl(uint64_t dns_ttl) { m_dns_ttl = dns_ttl; }
 
-                uv_getaddrinfo(m_loop, &m_addr_req, cb, m_opts.host.c_str(), std::to_string(m_opts.port).c_str(), &ai);
-                //uv_run(m_loop, UV_RUN_DEFAULT);
+        protected:
+
+            void init()
+            {
+                m_max_conns = DEFAULT_HTTP_CLIENT_MAX_CONNS;
+                m_pipeline_depth = DEFAULT_HTTP_CLIENT_PIPELINE_DEPTH;
+                m_idle_timeout = DEFAULT_HTTP_CLIENT_IDLE_TIMEOUT;
+                m_dns_ttl = DEFAULT_HTTP_DNS_TTL;
+                m_stopping = false;
+                m_settings = http_parser_settings();
+
+                attachEvents(this, m_settings);
+
+                m_pool.init();
+                m_loop = m_pool.get_loop();
 
+                uv_timer_init(m_loop, &m_timeout_timer);
+                m_timeout_timer.data = this;
+
+                // submitted requests and shutdown handed to loop thread
+                m_async.data = this;
+                uv_async_init(m_loop, &m_async, [](uv_async_t *async)
+                {
+                    static_cast<http_client *>(async->data)->on_async();
+                });
+
+                m_pool.start();
             }
 
-            int complete(http_parser* parser, svc_functor functor)
+            int32_t submit(req_ptr_type req)
             {
-                http_context * context = reinterpret_cast<http_context *>(parser->data);
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    if (m_stopping)
+                    {
+                        return ERR_FAILED;
+                    }
 
-                http_rsp rsp;
-                rsp.m_body = context->m_body.str();
-                rsp.m_parser = *parser;
+                    m_submits.push_back(req);
+                }
 
-                functor(rsp);
-                return 0;
+                uv_async_send(&m_async);
+                return ERR_SUCCESS;
             }
 
-            void on_connect(uv_connect_t* req, int status)
+            void on_async()
             {
-                http_context* context = reinterpret_cast<http_context *>(req->handle->data);
-                static http_parser_settings settings;
-                attachEvents(this, settings);
+                std::vector<req_ptr_type> submits;
+                bool stopping = false;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    submits.swap(m_submits);
+                    stopping = m_stopping;
+                }
 
-                if (status == -1) {
-                    // @TODO
-                    // Error Callback
-                    uv_close((uv_handle_t*)req->handle, free_context);
+                if (stopping)
+                {
+                    shutdown();
                     return;
                 }
 
-                static std::function<void(uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf)> read;
+                for (auto &req : submits)
+                {
+                    if (req->m_timeout)
+                    {
+                        add_deadline(req);
+                    }
+
+                    host_ptr_type &host = m_hosts[req->m_host + ":" + std::to_string(req->m_port)];
+                    if (!host)
+                    {
+                        host = std::make_shared<http_host_pool>(req->m_host, req->m_port);
+                    }
+
+                    host->m_waiting.push_back(req);
+                    dispatch(host.get());
+                }
+            }
 
-                read = [&](uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf) 
+            //loop thread: close all connections, fail waiting requests, stop loop
+            void shutdown()
+            {
+                for (auto &it : m_hosts)
                 {
+                    http_host_pool *host = it.second.get();
+
+                    std::deque<req_ptr_type> waiting;
+                    waiting.swap(host->m_waiting);
+                    for (auto &req : waiting)
+                    {
+                        fail(req, UV_ECANCELED);
+                    }
+
+                    std::vector<http_client_conn *> conns = host->m_conns;
+                    for (auto conn : conns)
+                    {
+                        conn->close();
+                    }
+                }
+
+                m_deadlines.clear();
+                uv_timer_stop(&m_timeout_timer);
+                uv_close((uv_handle_t *)&m_timeout_timer, nullptr);
 
-                    http_context * context = static_cast<http_context *>(tcp->data);
+                uv_close((uv_handle_t *)&m_async, nullptr);
+                uv_stop(m_loop);
+            }
 
-                    if (nread >= 0) 
+            //send waiting requests: idle connection, else new connection, else pipeline on least busy one
+            void dispatch(http_host_pool *host)
+            {
+                while (!host->m_waiting.empty())
+                {
+                    http_client_conn *idle = nullptr, *busy = nullptr;
+
+                    for (auto conn : host->m_conns)
                     {
-                        auto parsed = (ssize_t)http_parser_execute(&context->m_parser, &settings, buf->base, nread);
+                        if (!conn->available(m_pipeline_depth))
+                        {
+                            continue;
+                        }
 
-                        if (parsed < nread) 
+                        if (conn->m_inflight.empty())
                         {
-                            uv_close((uv_handle_t*)&context->m_handle, free_context);
+                            idle = conn;
+                            break;
                         }
 
-                        if (parsed != nread) 
+                        if (!busy || conn->m_inflight.size() < busy->m_inflight.size())
                         {
-                            // @TODO
-                            // Error Callback
+                            busy = conn;
                         }
                     }
-                    else 
+
+                    if (idle)
                     {
-                        if (nread != UV_EOF) 
+                        send(idle);
+                        continue;
+                    }
+
+                    if (host->m_conns.size() < m_max_conns && host->m_connecting < host->m_waiting.size())
+                    {
+                        if (ERR_SUCCESS != open_conn(host))
                         {
-                            return; // maybe do something interesting here...
+                            return;
                         }
 
-                        uv_close((uv_handle_t*)&context->m_handle, free_context);
+                        continue;
+                    }
+
+                    //non idempotent requests are not pipelined, wait for idle connection
+                    if (busy && host->m_waiting.front()->idempotent())
+                    {
+                        send(busy);
+                        continue;
+                    }
+
+                    return;
+                }
+            }
+
+            //new connection to cached address, resolve first if expired
+            int32_t open_conn(http_host_pool *host)
+            {
+                std::string key = host->m_host + ":" + std::to_string(host->m_port);
+
+                auto it = m_dns.find(key);
+                if (it == m_dns.end() || it->second.m_expire <= uv_now(m_loop))
+                {
+                    resolve(host, key);
+                    return ERR_FAILED;
+                }
+
+                http_client_conn *conn = new http_client_conn(host);
+
+                uv_tcp_init(m_loop, &conn->m_handle);
+                http_parser_init(&conn->m_parser, HTTP_RESPONSE);
+                conn->m_parser.data = conn;
+                conn->m_handle.data = conn;
+                conn->m_owner = this;
+                conn->m_settings = &m_settings;
+                conn->m_idle_timeout = m_idle_timeout;
+                conn->init_idle_timer(m_loop);
+
+                host->m_conns.push_back(conn);
+                host->m_connecting++;
+
+                int status = uv_tcp_connect(&conn->m_connect_req, &conn->m_handle, (const struct sockaddr *)&it->second.m_addr, [](uv_connect_t *req, int status)
+                {
+                    http_client_conn *conn = static_cast<http_client_conn *>(req->handle->data);
+                    static_cast<http_client *>(conn->m_owner)->on_connected(conn, status);
+                });
+
+                if (0 != status)
+                {
+                    //waiting requests fail on close unless another connection takes them
+                    host->m_connecting--;
+                    conn->m_no_more_req = true;
+                    m_conn_error = status;
+                    conn->close();
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            void resolve(http_host_pool *host, const std::string &key)
+            {
+                if (host->m_resolving)
+                {
+                    return;
+                }
+
+                host->m_resolving = true;
+
+                http_dns_req *dns_req = new http_dns_req();
+                dns_req->m_client = this;
+                dns_req->m_key = key;
+                dns_req->m_req.data = dns_req;
+
+                struct addrinfo hints;
+                memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_protocol = IPPROTO_TCP;
+
+                int status = uv_getaddrinfo(m_loop, &dns_req->m_req, [](uv_getaddrinfo_t *req, int status, struct addrinfo *res)
+                {
+                    http_dns_req *dns_req = static_cast<http_dns_req *>(req->data);
+                    dns_req->m_client->on_resolved(dns_req->m_key, status, res);
+
+                    uv_freeaddrinfo(res);
+                    delete dns_req;
+                }, host->m_host.c_str(), std::to_string(host->m_port).c_str(), &hints);
+
+                if (0 != status)
+                {
+                    delete dns_req;
+                    on_resolved(key, status, nullptr);
+                }
+            }
+
+            void on_resolved(const std::string &key, int status, struct addrinfo *res)
+            {
+                auto it = m_hosts.find(key);
+                if (it == m_hosts.end())
+                {
+                    return;
+                }
+
+                http_host_pool *host = it->second.get();
+                host->m_resolving = false;
+
+                if (0 != status || nullptr == res)
+                {
+                    LOG_ERROR << "http client resolve error: " << key << " " << uv_err_name(status ? status : UV_EAI_NONAME);
+
+                    std::deque<req_ptr_type> waiting;
+                    waiting.swap(host->m_waiting);
+                    for (auto &req : waiting)
+                    {
+                        fail(req, status ? status : UV_EAI_NONAME);
                     }
 
-                    free(buf->base);
-                };
+                    return;
+                }
+
+                http_dns_entry &entry = m_dns[key];
+                memset(&entry.m_addr, 0, sizeof(entry.m_addr));
+                memcpy(&entry.m_addr, res->ai_addr, res->ai_addrlen);
+                entry.m_expire = uv_now(m_loop) + m_dns_ttl;
+
+                if (!m_stopping)
+                {
+                    dispatch(host);
+                }
+            }
+
+            void on_connected(http_client_conn *conn, int status)
+            {
+                if (conn->m_closing)
+                {
+                    return;
+                }
+
+                http_host_pool *host = conn->m_host;
+                host->m_connecting--;
 
-                uv_buf_t req_buf;
-                std::string reqstr = m_opts.method + " " + m_opts.url + " HTTP/1.1" + CRLF + 
-                    //
-                    // @TODO
-                    // Add user's headers here
-                    //
-                    "Connection: keep-alive" + CRLF + CRLF;
+                if (0 != status)
+                {
+                    LOG_ERROR << "http client connect error: " << host->m_host << ":" << host->m_port << " " << uv_err_name(status);
+
+                    conn->m_no_more_req = true;
+                    m_conn_error = status;
+                    conn->close();
+                    return;
+                }
 
-                req_buf.base = (char*)reqstr.c_str();
-                req_buf.len = (unsigned long)reqstr.size();
+                conn->m_connected = true;
+                uv_tcp_nodelay(&conn->m_handle, 1);
+                http_no_sigpipe(&conn->m_handle);
 
-                uv_read_start(
-                    req->handle,
-                    [](uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) 
+                uv_read_start((uv_stream_t *)&conn->m_handle,
+                    [](uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
                     {
-                        *buf = uv_buf_init((char*)malloc(suggested_size), (unsigned int)suggested_size);
+                        static_cast<http_context *>(handle->data)->alloc_read(buf);
                     },
-                    [](uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf) 
+                    [](uv_stream_t *tcp, ssize_t nread, const uv_buf_t *buf)
                     {
-                        read(tcp, nread, buf);
+                        http_client_conn *conn = static_cast<http_client_conn *>(tcp->data);
+                        static_cast<http_client *>(conn->m_owner)->read(conn, nread);
                     });
 
-                uv_write(
-                    &context->m_write_req,
-                    req->handle,
-                    &req_buf,
-                    1,
-                    NULL);
+                dispatch(host);
+            }
+
+            //write next waiting request of host on connection
+            void send(http_client_conn *conn)
+            {
+                http_host_pool *host = conn->m_host;
+
+                req_ptr_type req = host->m_waiting.front();
+                host->m_waiting.pop_front();
+
+                http_write_req *write_req = http_write_req::acquire();
+                format_request(*req, write_req->m_data);
+                write_req->m_body = req->m_body;
+                write_req->m_body_owner = req->m_body_owner;
+
+                req->m_conn = conn;
+                conn->m_inflight.push_back(req);
+                conn->m_req_seq++;
+                conn->restart_idle_timer();
+
+                conn->send(write_req);
+            }
+
+            //request line and headers, body written from its own buffer
+            void format_request(const http_client_req &req, std::string &out)
+            {
+                out.append(req.m_method).append(" ").append(req.m_target).append(" HTTP/1.1").append(CRLF);
+
+                if (!req.has_header("Host"))
+                {
+                    bool v6 = std::string::npos != req.m_host.find(':');
+
+                    out.append("Host: ").append(v6 ? "[" : "").append(req.m_host).append(v6 ? "]" : "");
+                    if (80 != req.m_port)
+                    {
+                        out.append(":").append(std::to_string(req.m_port));
+                    }
+
+                    out.append(CRLF);
+                }
+
+                for (auto &it : req.m_headers)
+                {
+                    out.append(it.first).append(": ").append(it.second).append(CRLF);
+                }
+
+                bool has_body = !req.m_body.empty() || "POST" == req.m_method || "PUT" == req.m_method || "PATCH" == req.m_method;
+                if (has_body && !req.has_header("Content-Length") && !req.has_header("Transfer-Encoding"))
+                {
+                    out.append("Content-Length: ").append(std::to_string(req.m_body.size())).append(CRLF);
+                }
+
+                if (!req.has_header("Connection"))
+                {
+                    out.append("Connection: keep-alive").append(CRLF);
+                }
+
+                out.append(CRLF);
+            }
+
+            void read(http_client_conn *conn, ssize_t nread)
+            {
+                if (nread > 0)
+                {
+                    if (ERR_SUCCESS != conn->parse((size_t)nread, [this, conn]() { complete(conn); }))
+                    {
+                        m_conn_error = UV_EPROTO;
+                        conn->close();
+                    }
+
+                    return;
+                }
+
+                if (nread < 0)
+                {
+                    //response delimited by connection close
+                    if (UV_EOF == nread && conn->m_chunk)
+                    {
+                        http_parser_execute(&conn->m_parser, &m_settings, nullptr, 0);
+                        if (conn->m_msg_done)
+                        {
+                            conn->m_msg_done = false;
+                            http_parser_pause(&conn->m_parser, 0);
+                            complete(conn);
+                        }
+                    }
+
+                    m_conn_error = (UV_EOF == nread) ? UV_ECONNRESET : (int32_t)nread;
+                    conn->close();
+                }
+            }
+
+            //HEAD response has no body
+            int headers_complete(http_parser* parser)
+            {
+                http_client_conn *conn = static_cast<http_client_conn *>(parser->data);
+                return (!conn->m_inflight.empty() && "HEAD" == conn->m_inflight.front()->m_method) ? 1 : 0;
+            }
+
+            //response of oldest request on connection
+            void complete(http_client_conn *conn)
+            {
+                if (conn->m_inflight.empty())
+                {
+                    m_conn_error = UV_EPROTO;
+                    conn->close();
+                    return;
+                }
+
+                req_ptr_type req = conn->m_inflight.front();
+                conn->m_inflight.pop_front();
+                conn->m_rsp_seq++;
+                req->m_conn = nullptr;
+
+                http_client_rsp rsp;
+                rsp.m_status_code = conn->m_parser.status_code;
+                rsp.m_body = conn->view(conn->m_body);
+                conn->fill_headers(rsp.m_headers);
+                rsp.m_chunk = conn->m_chunk;
+
+                bool keep_alive = http_should_keep_alive(&conn->m_parser);
+                if (!keep_alive)
+                {
+                    //server closes after this response, requests pipelined after it not processed, send again
+                    conn->m_no_more_req = true;
+
+                    while (!conn->m_inflight.empty())
+                    {
+                        conn->m_inflight.back()->m_conn = nullptr;
+                        conn->m_host->m_waiting.push_front(conn->m_inflight.back());
+                        conn->m_inflight.pop_back();
+                    }
+                }
+
+                invoke(req, rsp);
+
+                if (!keep_alive)
+                {
+                    m_conn_error = UV_ECONNRESET;
+                    conn->close();
+                    return;
+                }
+
+                conn->restart_idle_timer();
+                dispatch(conn->m_host);
+            }
+
+            //connection closing: retry or fail its requests, then refill pool
+            void on_conn_closing(http_client_conn *conn)
+            {
+                http_host_pool *host = conn->m_host;
+
+                auto it = std::find(host->m_conns.begin(), host->m_conns.end(), conn);
+                if (it != host->m_conns.end())
+                {
+                    host->m_conns.erase(it);
+                }
+
+                if (!conn->m_connected && !conn->m_no_more_req)
+                {
+                    host->m_connecting--;
+                }
+
+                int32_t error = m_conn_error ? m_conn_error : UV_ECONNRESET;
+                m_conn_error = 0;
+
+                std::deque<req_ptr_type> inflight;
+                inflight.swap(conn->m_inflight);
+
+                //retried requests keep their order in front of waiting ones
+                for (auto rit = inflight.rbegin(); rit != inflight.rend(); ++rit)
+                {
+                    req_ptr_type req = *rit;
+                    req->m_conn = nullptr;
+
+                    if (req->m_done)
+                    {
+                        continue;
+                    }
+
+                    if (!m_stopping && req->idempotent() && req->m_retries < HTTP_CLIENT_MAX_RETRIES)
+                    {
+                        req->m_retries++;
+                        host->m_waiting.push_front(req);
+                    }
+                    else
+                    {
+                        fail(req, error);
+                    }
+                }
+
+                if (m_stopping)
+                {
+                    return;
+                }
+
+                //no connection left to take requests after connect failure
+                if (!conn->m_connected && host->m_conns.empty())
+                {
+                    std::deque<req_ptr_type> waiting;
+                    waiting.swap(host->m_waiting);
+                    for (auto &req : waiting)
+                    {
+                        fail(req, error);
+                    }
+
+                    return;
+                }
+
+                dispatch(host);
+            }
+
+            void fail(req_ptr_type req, int32_t error)
+            {
+                http_client_rsp rsp;
+                rsp.m_error = error;
+
+                invoke(req, rsp);
+            }
+
+            void invoke(req_ptr_type req, http_client_rsp &rsp)
+            {
+                if (req->m_done)
+                {
+                    return;
+                }
+
+                req->m_done = true;
+                if (req->m_has_deadline)
+                {
+                    req->m_has_deadline = false;
+                    m_deadlines.erase(req->m_deadline);
+                }
+
+                if (!req->m_callback)
+                {
+                    return;
+                }
+
+                try
+                {
+                    req->m_callback(rsp);
+                }
+                catch (...)
+                {
+                    LOG_ERROR << "http client callback exception: " << req->m_host << req->m_target;
+                }
+            }
+
+            void add_deadline(req_ptr_type req)
+            {
+                uint64_t deadline = uv_now(m_loop) + req->m_timeout;
+
+                req->m_deadline = m_deadlines.emplace(deadline, req);
+                req->m_has_deadline = true;
+
+                if (m_deadlines.begin() == req->m_deadline)
+                {
+                    start_timeout_timer();
+                }
+            }
+
+            //timer fires at earliest deadline
+            void start_timeout_timer()
+            {
+                if (m_deadlines.empty())
+                {
+                    uv_timer_stop(&m_timeout_timer);
+                    return;
+                }
+
+                uint64_t now = uv_now(m_loop);
+                uint64_t deadline = m_deadlines.begin()->first;
+
+                uv_timer_start(&m_timeout_timer, [](uv_timer_t *timer)
+                {
+                    static_cast<http_client *>(timer->data)->on_timeout();
+                }, deadline > now ? deadline - now : 0, 0);
+            }
+
+            //waiting request dropped from queue, request in flight closes its connection
+            void on_timeout()
+            {
+                uint64_t now = uv_now(m_loop);
+
+                while (!m_deadlines.empty() && m_deadlines.begin()->first <= now)
+                {
+                    req_ptr_type req = m_deadlines.begin()->second;
+                    http_client_conn *conn = req->m_conn;
+
+                    if (nullptr == conn)
+                    {
+                        auto it = m_hosts.find(req->m_host + ":" + std::to_string(req->m_port));
+                        if (it != m_hosts.end())
+                        {
+                            std::deque<req_ptr_type> &waiting = it->second->m_waiting;
+                            waiting.erase(std::remove(waiting.begin(), waiting.end(), req), waiting.end());
+                        }
+                    }
+
+                    fail(req, UV_ETIMEDOUT);
+
+                    //pipelined responses can not be skipped
+                    if (conn)
+                    {
+                        m_conn_error = UV_ECONNABORTED;
+                        conn->close();
+                    }
+                }
+
+                start_timeout_timer();
             }
 
         protected:
 
+            class http_dns_req
+            {
+            public:
+
+                uv_getaddrinfo_t m_req;
+
+                http_client * m_client;
+
+                std::string m_key;
+            };
+
             Options m_opts;
 
             uv_thread_pool m_pool;
 
             uv_loop_t * m_loop;
 
-            uv_tcp_t m_socket;
-
             svc_functor m_functor;
 
-            uv_getaddrinfo_t m_addr_req;
+            http_parser_settings m_settings;
 
-            uv_shutdown_t m_shutdown_req;
+            uv_async_t m_async;
+
+            std::mutex m_mutex;
+
+            std::vector<req_ptr_type> m_submits;            //from any thread to loop thread
+
+            std::atomic<bool> m_stopping;                   //set under m_mutex, read lock free on loop thread
+
+            std::unordered_map<std::string, host_ptr_type> m_hosts;
+
+            std::unordered_map<std::string, http_dns_entry> m_dns;
+
+            int32_t m_conn_error = 0;                       //reason of connection being closed
+
+            uv_timer_t m_timeout_timer;
+
+            http_client_req::deadline_map_type m_deadlines;
+
+            uint32_t m_max_conns;
+
+            uint32_t m_pipeline_depth;
+
+            uint64_t m_idle_timeout;
+
+            uint64_t m_dns_ttl;
 
         };
 
+        inline void http_client_conn::on_closing()
+        {
+            static_cast<http_client *>(m_owner)->on_conn_closing(this);
+        }
+
     }
 
 }
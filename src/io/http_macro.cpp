@@ -9,8 +9,7 @@ const std::string CRLF = "\r\n";
 void free_context(uv_handle_t* handle) 
 {
     auto* context = reinterpret_cast<micro::core::http_context *>(handle->data);
-    context->m_writes.clear();
-    free(context);
+    delete context;
 }
 
 
@@ -28,59 +27,54 @@ namespace micro
         template <class Type>
         void attachEvents(Type * instance, http_parser_settings & settings)
         {
-            // http parser callback types
-            static std::function<int(http_parser* parser)> on_message_complete;
-
-            static auto callback = instance->m_functor;
-            // called once a connection has been made and the message is complete.
-            on_message_complete = [&](http_parser* parser) -> int 
-            {
-                return instance->complete(parser, callback);
-                return 0;
-            };
-
-            // called after the url has been parsed.
+            // called after the url has been parsed, url may come in pieces.
             settings.on_url =
                 [](http_parser* parser, const char* at, size_t len) -> int {
                 micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
-                if (at && context) { context->m_url = std::string(at, len); }
+                context->append_field(context->m_url, at, len);
                 return 0;
             };
 
             // called when there are either fields or values in the request.
             settings.on_header_field =
                 [](http_parser* parser, const char* at, size_t length) -> int {
-                return 0;
+                micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
+                return ERR_SUCCESS == context->on_header_field(at, length) ? 0 : 1;
             };
 
             // called when header value is given
             settings.on_header_value =
                 [](http_parser* parser, const char* at, size_t length) -> int {
-                return 0;
+                micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
+                return ERR_SUCCESS == context->on_header_value(at, length) ? 0 : 1;
             };
 
             // called once all fields and values have been parsed.
             settings.on_headers_complete =
                 [](http_parser* parser) -> int {
                 micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
-                context->m_method = std::string(http_method_str((enum http_method) parser->method));
-                return 0;
+                return static_cast<Type *>(context->m_owner)->headers_complete(parser);
             };
 
-            // called when there is a body for the request.
+            // called when there is a body for the request, streamed body goes to stream data functor.
             settings.on_body =
                 [](http_parser* parser, const char* at, size_t len) -> int {
                 micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
-                if (at && context && (int)len > -1) {
-                    context->m_body << std::string(at, len);
+                if (context->m_stream) {
+                    if (context->m_stream->m_on_data) { context->m_stream->m_on_data(boost::string_view(at, len)); }
+                    return 0;
                 }
+                context->append_field(context->m_body, at, len);
                 return 0;
             };
 
-            // called after all other events.
+            // called after all other events, pause to hand over message while receive chunk holds it.
             settings.on_message_complete =
                 [](http_parser* parser) -> int {
-                return on_message_complete(parser);
+                micro::core::http_context* context = static_cast<micro::core::http_context*>(parser->data);
+                context->m_msg_done = true;
+                http_parser_pause(parser, 1);
+                return 0;
             };
         }
 
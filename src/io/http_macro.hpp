@@ -3,7 +3,18 @@
 #include <string>
 #include <sstream>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <utility>
+#include <cstdio>
+#include <cstring>
+#include <boost/utility/string_view.hpp>
 #include <common/common.hpp>
+#include <common/error.hpp>
+#include <io/http_pool.hpp>
 #include <3rd/http_parser/http_parser.h>
 #include <3rd/http_parser/uri.h>
 __BEGIN_DECLS__
@@ -16,90 +27,1196 @@ __END_DECLS__
     exit(1); \
   }
 
+#define DEFAULT_HTTP_IDLE_TIMEOUT           60000                   //ms
+#define DEFAULT_HTTP_MAX_REQUESTS           1000                    //per connection
+#define DEFAULT_HTTP_MAX_REQUEST_SIZE       (8 * 1024 * 1024)       //request line, headers and body
+#define MAX_HTTP_HEADER_COUNT               64                      //more headers fail the request
+#define MAX_HTTP_ROUTE_PARAMS               16
+#define DEFAULT_HTTP_MAX_QUEUED_WRITE       (1024 * 1024)           //bytes queued by streaming response writer
+
 extern const std::string CRLF;
 
-extern void free_context(uv_handle_t *);
+extern void free_context(uv_handle_t *);
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        template <class Type>
+        extern void attachEvents(Type* instance, http_parser_settings& settings);
+
+        template <class T>
+        class http_buffer : public std::stringbuf 
+        {
+
+            friend class http_req;
+            friend class http_rsp;
+
+            T * m_stream;
+
+            http_buffer<T>(std::ostream& str) {}
+
+            ~http_buffer() = default;
+
+            virtual int sync()
+            {
+                std::string out = str();
+                std::ostringstream buf;
+
+                buf << out;
+                out = buf.str();
+                m_stream->write_or_end(out, true);
+                buf.flush();
+                str("");
+
+                return 0;
+            }
+        };
+
+        template <class Type>
+        class http_stream : virtual public std::ostream
+        {
+
+        public:
+
+            http_stream() : std::ostream(std::cout.rdbuf()) {}
+
+            //std::stringstream m_stream;
+
+        };
+
+        //ascii case insensitive compare without locale or allocation
+        inline bool http_iequals(boost::string_view lhs, boost::string_view rhs)
+        {
+            if (lhs.size() != rhs.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < lhs.size(); i++)
+            {
+                char l = lhs[i], r = rhs[i];
+                if (l != r && ((l | 0x20) != (r | 0x20) || (l | 0x20) < 'a' || (l | 0x20) > 'z'))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        //comma separated header value contains token, e.g. Connection: keep-alive, Close
+        inline bool http_has_token(boost::string_view list, boost::string_view token)
+        {
+            while (!list.empty())
+            {
+                size_t end = list.find(',');
+                boost::string_view item = list.substr(0, end);
+
+                while (!item.empty() && (' ' == item.front() || '\t' == item.front())) item.remove_prefix(1);
+                while (!item.empty() && (' ' == item.back() || '\t' == item.back())) item.remove_suffix(1);
+
+                if (http_iequals(item, token))
+                {
+                    return true;
+                }
+
+                if (boost::string_view::npos == end)
+                {
+                    break;
+                }
+
+                list.remove_prefix(end + 1);
+            }
+
+            return false;
+        }
+
+        //write to socket closed by peer fails with EPIPE instead of raising SIGPIPE, process signal disposition untouched
+        //libuv writes with writev so MSG_NOSIGNAL can not be passed: SO_NOSIGPIPE where platform has it, uv loop threads block SIGPIPE otherwise
+        inline void http_no_sigpipe(uv_tcp_t *handle)
+        {
+#ifdef SO_NOSIGPIPE
+            uv_os_fd_t fd;
+            if (0 == uv_fileno((uv_handle_t *)handle, &fd))
+            {
+                int on = 1;
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+            }
+#else
+            (void)handle;
+#endif
+        }
+
+        //flat table of header views, common headers resolved once when added
+        class http_headers
+        {
+        public:
+
+            typedef std::pair<boost::string_view, boost::string_view> header_type;
+
+            typedef const header_type * const_iterator;
+
+            http_headers() : m_count(0), m_content_length(0), m_has_content_length(false) {}
+
+            //false when table full
+            bool add(boost::string_view name, boost::string_view value)
+            {
+                if (m_count >= MAX_HTTP_HEADER_COUNT)
+                {
+                    return false;
+                }
+
+                m_headers[m_count++] = header_type(name, value);
+
+                switch (name.size())
+                {
+                case 4:
+                    if (http_iequals(name, "Host")) m_host = value;
+                    break;
+                case 10:
+                    if (http_iequals(name, "Connection")) m_connection = value;
+                    break;
+                case 12:
+                    if (http_iequals(name, "Content-Type")) m_content_type = value;
+                    break;
+                case 14:
+                    if (http_iequals(name, "Content-Length")) set_content_length(value);
+                    break;
+                case 17:
+                    if (http_iequals(name, "Transfer-Encoding")) m_transfer_encoding = value;
+                    break;
+                default:
+                    break;
+                }
+
+                return true;
+            }
+
+            //value of first header with name, empty view if none
+            boost::string_view get(boost::string_view name) const
+            {
+                for (size_t i = 0; i < m_count; i++)
+                {
+                    if (http_iequals(m_headers[i].first, name))
+                    {
+                        return m_headers[i].second;
+                    }
+                }
+
+                return boost::string_view();
+            }
+
+            bool has(boost::string_view name) const
+            {
+                for (size_t i = 0; i < m_count; i++)
+                {
+                    if (http_iequals(m_headers[i].first, name))
+                    {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            void clear() { *this = http_headers(); }
+
+            size_t size() const { return m_count; }
+
+            bool empty() const { return 0 == m_count; }
+
+            const header_type & operator[](size_t i) const { return m_headers[i]; }
+
+            const_iterator begin() const { return m_headers; }
+
+            const_iterator end() const { return m_headers + m_count; }
+
+            boost::string_view host() const { return m_host; }
+
+            boost::string_view connection() const { return m_connection; }
+
+            boost::string_view content_type() const { return m_content_type; }
+
+            boost::string_view transfer_encoding() const { return m_transfer_encoding; }
+
+            bool has_content_length() const { return m_has_content_length; }
+
+            uint64_t content_length() const { return m_content_length; }
+
+            bool chunked() const { return http_iequals(m_transfer_encoding, "chunked"); }
+
+        protected:
+
+            void set_content_length(boost::string_view value)
+            {
+                uint64_t length = 0;
+                for (char c : value)
+                {
+                    if (c < '0' || c > '9')
+                    {
+                        return;
+                    }
+
+                    length = length * 10 + (c - '0');
+                }
+
+                m_content_length = length;
+                m_has_content_length = !value.empty();
+            }
+
+        protected:
+
+            header_type m_headers[MAX_HTTP_HEADER_COUNT];
+
+            size_t m_count;
+
+            boost::string_view m_host;
+
+            boost::string_view m_connection;
+
+            boost::string_view m_content_type;
+
+            boost::string_view m_transfer_encoding;
+
+            uint64_t m_content_length;
+
+            bool m_has_content_length;
+        };
+
+        //route params: names owned by router, values point into request url
+        class http_params
+        {
+        public:
+
+            typedef std::pair<boost::string_view, boost::string_view> param_type;
+
+            typedef const param_type * const_iterator;
+
+            http_params() : m_count(0) {}
+
+            bool add(boost::string_view name, boost::string_view value)
+            {
+                if (m_count >= MAX_HTTP_ROUTE_PARAMS)
+                {
+                    return false;
+                }
+
+                m_params[m_count++] = param_type(name, value);
+                return true;
+            }
+
+            //value of param with name, empty view if none
+            boost::string_view get(boost::string_view name) const
+            {
+                for (size_t i = 0; i < m_count; i++)
+                {
+                    if (m_params[i].first == name)
+                    {
+                        return m_params[i].second;
+                    }
+                }
+
+                return boost::string_view();
+            }
+
+            //drop params added after count, router backtracking
+            void resize(size_t count) { m_count = count < m_count ? count : m_count; }
+
+            void clear() { m_count = 0; }
+
+            size_t size() const { return m_count; }
+
+            bool empty() const { return 0 == m_count; }
+
+            const param_type & operator[](size_t i) const { return m_params[i]; }
+
+            const_iterator begin() const { return m_params; }
+
+            const_iterator end() const { return m_params + m_count; }
+
+        protected:
+
+            param_type m_params[MAX_HTTP_ROUTE_PARAMS];
+
+            size_t m_count;
+        };
+
+        //views into receive chunk, valid while request holds the chunk
+        class http_req
+        {
+        public:
+
+            boost::string_view m_url;
+
+            boost::string_view m_method;
+
+            boost::string_view m_body;
+
+            http_headers m_headers;
+
+            http_params m_params;
+
+            http_chunk::ptr_type m_chunk;
+        };
+
+        //flow control of streaming response writer: bytes queued until uv write callback
+        class http_writer_state
+        {
+        public:
+
+            http_writer_state(size_t max_queued) : m_queued(0), m_blocked(false), m_aborted(false), m_max_queued(max_queued) {}
+
+            //true if queued bytes still within limit
+            bool on_queued(size_t size)
+            {
+                if (m_queued.fetch_add(size) + size <= m_max_queued)
+                {
+                    return true;
+                }
+
+                m_blocked = true;
+
+                //written meanwhile, no drain callback will come for it
+                return m_queued.load() <= m_max_queued / 2 && m_blocked.exchange(false);
+            }
+
+            //loop thread: bytes written or dropped, drain callback when blocked writer falls under half of limit
+            void on_released(size_t size)
+            {
+                if (m_queued.fetch_sub(size) - size <= m_max_queued / 2 && m_blocked.exchange(false) && m_on_drain)
+                {
+                    m_on_drain();
+                }
+            }
+
+        public:
+
+            std::atomic<size_t> m_queued;
+
+            std::atomic<bool> m_blocked;
+
+            std::atomic<bool> m_aborted;            //connection closed before response written
+
+            size_t m_max_queued;
+
+            std::function<void()> m_on_drain;
+        };
+
+        //owns response bytes until uv write callback, pooled per thread
+        class http_write_req
+        {
+        public:
+
+            typedef http_object_pool<http_write_req, HTTP_POOL_MAX_FREE_WRITES> pool_type;
+
+            static http_write_req * acquire() { return pool_type::acquire(); }
+
+            //response will not be written: connection closed or write failed
+            static void abort(http_write_req *write_req)
+            {
+                if (write_req->m_writer)
+                {
+                    write_req->m_writer->m_aborted = true;
+                }
+
+                release(write_req);
+            }
+
+            static void release(http_write_req *write_req)
+            {
+                if (write_req->m_writer)
+                {
+                    write_req->m_writer->on_released(write_req->m_counted);
+                    write_req->m_writer.reset();
+                    write_req->m_counted = 0;
+                }
+
+                //keep buffer capacity of usual responses for reuse
+                if (write_req->m_data.capacity() > HTTP_READ_CHUNK_SIZE)
+                {
+                    std::string().swap(write_req->m_data);
+                }
+
+                write_req->m_data.clear();
+                write_req->m_body.clear();
+                write_req->m_body_owner.reset();
+                write_req->m_close = false;
+
+                pool_type::release(write_req);
+            }
+
+        public:
+
+            uv_write_t m_req;
+
+            std::string m_data;
+
+            boost::string_view m_body;                      //written after m_data without copy
+
+            std::shared_ptr<const void> m_body_owner;       //keeps m_body alive until written
+
+            bool m_close = false;
+
+            std::shared_ptr<http_writer_state> m_writer;    //set for streaming response writes
+
+            size_t m_counted = 0;                           //bytes accounted to writer
+        };
+
+        //response of pipelined request waiting for earlier responses
+        class http_pending_rsp
+        {
+        public:
+
+            //written in arrival order, each released by its own write callback
+            std::vector<http_write_req *> m_writes;
+
+            bool m_ended = false;
+
+            bool m_close = false;
+        };
+
+        //offset of parsed field in receive chunk
+        class http_field
+        {
+        public:
+
+            size_t m_off = 0;
+
+            size_t m_len = 0;
+        };
+
+        class http_header_field
+        {
+        public:
+
+            http_field m_name;
+
+            http_field m_value;
+        };
+
+        class http_rsp;
+
+        class http_context;
+
+        class http_completion_queue;
+
+        //request body delivered in pieces on loop thread instead of buffered
+        //pause and resume stop and restart socket reads, call them on loop thread
+        class http_body_stream
+        {
+        public:
+
+            typedef std::function<void(boost::string_view data)> data_functor_type;
+
+            typedef std::function<void(http_req&, http_rsp&)> end_functor_type;
+
+            typedef std::function<void()> abort_functor_type;
+
+            void pause();
+
+            void resume();
+
+            bool paused() const;
+
+        public:
+
+            http_req m_req;                         //url, method and headers, body left empty
+
+            data_functor_type m_on_data;
+
+            end_functor_type m_on_end;              //run like request handler when body done
+
+            abort_functor_type m_on_abort;          //connection closed before body done
+
+            http_context * m_context = nullptr;     //reset when body done or connection closed
+        };
+
+        class http_context
+        {
+
+        public:
+
+            typedef std::map<uint64_t, http_pending_rsp> pending_rsps_type;
+
+            typedef void (*resume_func_type)(http_context *);
+
+            http_context()
+                : m_req_seq(0)
+                , m_rsp_seq(0)
+                , m_req_count(0)
+                , m_idle_timeout(DEFAULT_HTTP_IDLE_TIMEOUT)
+                , m_max_requests(DEFAULT_HTTP_MAX_REQUESTS)
+                , m_keep_alive(true)
+                , m_no_more_req(false)
+                , m_closing(false)
+                , m_closed_handles(0)
+                , m_owner(nullptr)
+                , m_settings(nullptr)
+                , m_len(0)
+                , m_msg_start(0)
+                , m_msg_done(false)
+                , m_header_count(0)
+                , m_in_header_value(false)
+                , m_refs(0)
+                , m_completions(nullptr)
+                , m_parsed(0)
+                , m_read_paused(false)
+                , m_resume(nullptr)
+                , m_in_parse(false)
+            {}
+
+            virtual ~http_context()
+            {
+                for (auto &it : m_pending_rsps)
+                {
+                    for (auto write_req : it.second.m_writes)
+                    {
+                        http_write_req::abort(write_req);
+                    }
+                }
+
+                detach_stream();
+            }
+
+            //clear parsed fields for next request on the same connection
+            void reset_req()
+            {
+                m_url = http_field();
+                m_body = http_field();
+                m_header_count = 0;
+                m_in_header_value = false;
+            }
+
+            //parser header callbacks: name pieces until a value piece starts the value
+            int32_t on_header_field(const char *at, size_t len)
+            {
+                if (m_in_header_value || 0 == m_header_count)
+                {
+                    if (m_header_count >= MAX_HTTP_HEADER_COUNT)
+                    {
+                        return ERR_FAILED;
+                    }
+
+                    m_header_fields[m_header_count++] = http_header_field();
+                    m_in_header_value = false;
+                }
+
+                append_field(m_header_fields[m_header_count - 1].m_name, at, len);
+                return ERR_SUCCESS;
+            }
+
+            int32_t on_header_value(const char *at, size_t len)
+            {
+                if (0 == m_header_count)
+                {
+                    return ERR_FAILED;
+                }
+
+                m_in_header_value = true;
+                append_field(m_header_fields[m_header_count - 1].m_value, at, len);
+                return ERR_SUCCESS;
+            }
+
+            //views of parsed headers, valid while receive chunk holds them
+            void fill_headers(http_headers &headers) const
+            {
+                for (size_t i = 0; i < m_header_count; i++)
+                {
+                    headers.add(view(m_header_fields[i].m_name), view(m_header_fields[i].m_value));
+                }
+            }
+
+            //uv alloc callback: free tail of receive chunk, compact or grow it when short
+            void alloc_read(uv_buf_t *buf)
+            {
+                if (!m_chunk)
+                {
+                    m_chunk = http_chunk::acquire();
+                    m_len = 0;
+                    m_msg_start = 0;
+                }
+                else if (m_chunk->m_capacity - m_len < HTTP_MIN_READ_SIZE && ERR_SUCCESS != rebase_chunk())
+                {
+                    //request too large, read callback gets UV_ENOBUFS
+                    *buf = uv_buf_init(nullptr, 0);
+                    return;
+                }
+
+                *buf = uv_buf_init(m_chunk->m_data + m_len, (unsigned int)(m_chunk->m_capacity - m_len));
+            }
+
+            //parse bytes of last read in place, on_message called at the end of each message while its views are valid
+            template<typename functor_type>
+            int32_t parse(size_t nread, functor_type on_message)
+            {
+                size_t off = m_parsed;
+                m_len += nread;
+                m_in_parse = true;
+
+                while (off < m_len && !m_no_more_req && !m_closing && !m_read_paused)
+                {
+                    off += http_parser_execute(&m_parser, m_settings, m_chunk->m_data + off, m_len - off);
+                    m_parsed = off;
+
+                    if (m_msg_done)
+                    {
+                        //parser paused at message end
+                        m_msg_done = false;
+                        http_parser_pause(&m_parser, 0);
+
+                        on_message();
+
+                        reset_req();
+                        m_msg_start = off;
+                        continue;
+                    }
+
+                    //body stream paused, rest of read parsed on resume
+                    if (m_read_paused && HPE_PAUSED == HTTP_PARSER_ERRNO(&m_parser))
+                    {
+                        break;
+                    }
+
+                    if (HPE_OK != HTTP_PARSER_ERRNO(&m_parser))
+                    {
+                        m_in_parse = false;
+                        return ERR_FAILED;
+                    }
+                }
+
+                m_in_parse = false;
+
+                //streamed body bytes already delivered, only unparsed bytes kept
+                if (m_stream)
+                {
+                    m_msg_start = m_parsed;
+                }
+
+                //no partial message, chunk back to pool while connection idle
+                if (m_msg_start >= m_len)
+                {
+                    m_chunk.reset();
+                    m_len = 0;
+                    m_msg_start = 0;
+                    m_parsed = 0;
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            //body stream backpressure: stop socket reads and parser
+            void pause_read()
+            {
+                if (m_read_paused || m_closing)
+                {
+                    return;
+                }
+
+                m_read_paused = true;
+                http_parser_pause(&m_parser, 1);
+
+                //in parse owner stops reads after parser returns
+                if (!m_in_parse)
+                {
+                    uv_read_stop((uv_stream_t*)&m_handle);
+                }
+            }
+
+            void resume_read()
+            {
+                if (!m_read_paused || m_closing)
+                {
+                    return;
+                }
+
+                m_read_paused = false;
+                http_parser_pause(&m_parser, 0);
+
+                //resumed inside data functor, parser goes on
+                if (!m_in_parse && m_resume)
+                {
+                    m_resume(this);
+                }
+            }
+
+            //body done or connection closed, stream no longer controls connection
+            std::shared_ptr<http_body_stream> detach_stream()
+            {
+                std::shared_ptr<http_body_stream> stream;
+                stream.swap(m_stream);
+
+                if (stream)
+                {
+                    stream->m_context = nullptr;
+                }
+
+                return stream;
+            }
+
+            //parser data callback: field bytes are moved next to earlier ones if not contiguous (chunked body)
+            void append_field(http_field &field, const char *at, size_t len)
+            {
+                size_t off = at - m_chunk->m_data;
+
+                if (0 == field.m_len)
+                {
+                    field.m_off = off;
+                }
+                else if (field.m_off + field.m_len != off)
+                {
+                    memmove(m_chunk->m_data + field.m_off + field.m_len, at, len);
+                }
+
+                field.m_len += len;
+            }
+
+            boost::string_view view(const http_field &field) const
+            {
+                return field.m_len ? boost::string_view(m_chunk->m_data + field.m_off, field.m_len) : boost::string_view();
+            }
+
+            //server side: init idle timer of accepted connection
+            void init_idle_timer(uv_loop_t *loop)
+            {
+                uv_timer_init(loop, &m_idle_timer);
+                m_idle_timer.data = this;
+                restart_idle_timer();
+            }
+
+            void restart_idle_timer()
+            {
+                if (m_closing || 0 == m_idle_timeout)
+                {
+                    return;
+                }
+
+                uv_timer_start(&m_idle_timer, [](uv_timer_t *timer)
+                {
+                    http_context * context = static_cast<http_context *>(timer->data);
+
+                    //requests in process or body stream paused by server, wait for them
+                    if (context->m_rsp_seq != context->m_req_seq || context->m_read_paused)
+                    {
+                        context->restart_idle_timer();
+                        return;
+                    }
+
+                    context->close();
+                }, m_idle_timeout, 0);
+            }
+
+            //write response bytes of request seq, responses go out in request order
+            void write_response(uint64_t seq, http_write_req *write_req, bool end, bool close_after)
+            {
+                if (m_closing)
+                {
+                    http_write_req::abort(write_req);
+                    return;
+                }
+
+                if (seq != m_rsp_seq)
+                {
+                    http_pending_rsp &pending = m_pending_rsps[seq];
+                    pending.m_writes.push_back(write_req);
+                    pending.m_ended = end;
+                    pending.m_close = close_after;
+                    return;
+                }
+
+                close_after = close_after || is_last_rsp(seq);
+                do_write(write_req, end && close_after);
+                if (!end)
+                {
+                    return;
+                }
+
+                ++m_rsp_seq;
+                if (close_after)
+                {
+                    return;
+                }
+
+                //earlier response done, flush the following ones
+                auto it = m_pending_rsps.find(m_rsp_seq);
+                while (it != m_pending_rsps.end())
+                {
+                    http_pending_rsp pending = std::move(it->second);
+                    m_pending_rsps.erase(it);
+
+                    pending.m_close = pending.m_close || is_last_rsp(m_rsp_seq);
+
+                    for (size_t i = 0; i < pending.m_writes.size(); i++)
+                    {
+                        //earlier write failed and closed connection
+                        if (m_closing)
+                        {
+                            http_write_req::abort(pending.m_writes[i]);
+                            continue;
+                        }
+
+                        do_write(pending.m_writes[i], pending.m_ended && pending.m_close && i + 1 == pending.m_writes.size());
+                    }
+
+                    if (m_closing)
+                    {
+                        return;
+                    }
+
+                    if (!pending.m_ended)
+                    {
+                        return;
+                    }
+
+                    ++m_rsp_seq;
+                    if (pending.m_close)
+                    {
+                        return;
+                    }
+
+                    it = m_pending_rsps.find(m_rsp_seq);
+                }
+
+                if (m_rsp_seq == m_req_seq)
+                {
+                    restart_idle_timer();
+                }
+            }
+
+            //request dispatched to worker thread, context kept until its response ends
+            void add_ref() { ++m_refs; }
+
+            void release_ref()
+            {
+                if (0 == --m_refs && 2 == m_closed_handles)
+                {
+                    delete this;
+                }
+            }
+
+            //server side: close tcp handle and idle timer, free context when both closed and no request in worker
+            void close()
+            {
+                if (m_closing)
+                {
+                    return;
+                }
+
+                m_closing = true;
+
+                on_closing();
+
+                for (auto &it : m_pending_rsps)
+                {
+                    for (auto write_req : it.second.m_writes)
+                    {
+                        http_write_req::abort(write_req);
+                    }
+                }
+
+                m_pending_rsps.clear();
+
+                std::shared_ptr<http_body_stream> stream = detach_stream();
+                if (stream && stream->m_on_abort)
+                {
+                    stream->m_on_abort();
+                }
+
+                uv_timer_stop(&m_idle_timer);
+                uv_close((uv_handle_t*)&m_idle_timer, on_handle_closed);
+
+                if (!uv_is_closing((uv_handle_t*)&m_handle))
+                {
+                    uv_close((uv_handle_t*)&m_handle, on_handle_closed);
+                }
+            }
+
+        protected:
+
+            //connection starts closing, handles still valid
+            virtual void on_closing() {}
+
+            //no more request will come and this is the last response
+            bool is_last_rsp(uint64_t seq) const { return m_no_more_req && (seq + 1 == m_req_seq); }
+
+            //move partial message to chunk front, to a new chunk if shared by requests or too small
+            int32_t rebase_chunk()
+            {
+                size_t partial = m_len - m_msg_start;
+                size_t needed = partial + HTTP_MIN_READ_SIZE;
+
+                if (needed > DEFAULT_HTTP_MAX_REQUEST_SIZE)
+                {
+                    return ERR_FAILED;
+                }
+
+                if (1 == m_chunk.use_count() && m_chunk->m_capacity >= needed)
+                {
+                    memmove(m_chunk->m_data, m_chunk->m_data + m_msg_start, partial);
+                }
+                else
+                {
+                    size_t capacity = HTTP_READ_CHUNK_SIZE;
+                    while (capacity < needed)
+                    {
+                        capacity <<= 1;
+                    }
+
+                    http_chunk::ptr_type chunk = http_chunk::acquire(capacity);
+                    memcpy(chunk->m_data, m_chunk->m_data + m_msg_start, partial);
+                    m_chunk = chunk;
+                }
 
+                //fields of partial message start at or after message start
+                rebase_field(m_url);
+                rebase_field(m_body);
 
-namespace micro
-{
-    namespace core
-    {
+                for (size_t i = 0; i < m_header_count; i++)
+                {
+                    rebase_field(m_header_fields[i].m_name);
+                    rebase_field(m_header_fields[i].m_value);
+                }
 
-        template <class Type>
-        extern void attachEvents(Type* instance, http_parser_settings& settings);
+                m_len = partial;
+                m_parsed -= m_msg_start;
+                m_msg_start = 0;
 
-        template <class T>
-        class http_buffer : public std::stringbuf 
-        {
+                return ERR_SUCCESS;
+            }
 
-            friend class http_req;
-            friend class http_rsp;
+            void rebase_field(http_field &field) { field.m_off = field.m_len ? field.m_off - m_msg_start : 0; }
 
-            T * m_stream;
+            void do_write(http_write_req *write_req, bool close_after)
+            {
+                if (write_req->m_data.empty() && write_req->m_body.empty() && !close_after)
+                {
+                    http_write_req::release(write_req);
+                    return;
+                }
 
-            http_buffer<T>(std::ostream& str) {}
+                write_req->m_close = close_after;
+                write_req->m_req.data = write_req;
 
-            ~http_buffer() = default;
+                uv_buf_t bufs[2];
+                bufs[0] = uv_buf_init((char *)write_req->m_data.data(), (unsigned int)write_req->m_data.size());
+                bufs[1] = uv_buf_init((char *)write_req->m_body.data(), (unsigned int)write_req->m_body.size());
 
-            virtual int sync()
-            {
-                std::string out = str();
-                std::ostringstream buf;
+                int status = uv_write(&write_req->m_req, (uv_stream_t*)&m_handle, bufs, write_req->m_body.empty() ? 1 : 2, [](uv_write_t* req, int status)
+                {
+                    http_write_req *write_req = static_cast<http_write_req *>(req->data);
+                    http_context * context = static_cast<http_context *>(req->handle->data);
 
-                buf << out;
-                out = buf.str();
-                m_stream->write_or_end(out, true);
-                buf.flush();
-                str("");
+                    if (write_req->m_close || status < 0)
+                    {
+                        context->close();
+                    }
 
-                return 0;
+                    if (status < 0)
+                    {
+                        http_write_req::abort(write_req);
+                        return;
+                    }
+
+                    http_write_req::release(write_req);
+                });
+
+                if (0 != status)
+                {
+                    http_write_req::abort(write_req);
+                    close();
+                }
             }
-        };
 
-        template <class Type>
-        class http_stream : virtual public std::ostream
-        {
+            static void on_handle_closed(uv_handle_t *handle)
+            {
+                http_context * context = static_cast<http_context *>(handle->data);
+                if (++context->m_closed_handles == 2 && 0 == context->m_refs)
+                {
+                    delete context;
+                }
+            }
 
         public:
 
-            http_stream() : std::ostream(std::cout.rdbuf()) {}
+            uv_tcp_t m_handle;
 
-            //std::stringstream m_stream;
+            uv_connect_t m_connect_req;
+
+            uv_write_t m_write_req;
+
+            uv_timer_t m_idle_timer;
+
+            http_parser m_parser;
+
+            uint64_t m_req_seq;                     //seq of next completed request
+
+            uint64_t m_rsp_seq;                     //seq of response allowed to write
 
+            uint32_t m_req_count;                   //requests served on connection
+
+            uint64_t m_idle_timeout;                //ms, 0: no idle timeout
+
+            uint32_t m_max_requests;
+
+            bool m_keep_alive;
+
+            bool m_no_more_req;                     //connection to close after last response
+
+            bool m_closing;
+
+            uint32_t m_closed_handles;
+
+            pending_rsps_type m_pending_rsps;
+
+            void * m_owner;                         //server or client the connection belongs to
+
+            const http_parser_settings * m_settings;    //parser settings of the loop running connection
+
+            http_chunk::ptr_type m_chunk;           //receive buffer of current message
+
+            size_t m_len;                           //bytes received in chunk
+
+            size_t m_msg_start;                     //offset of current message in chunk
+
+            bool m_msg_done;                        //parser paused at message end
+
+            http_field m_url;
+
+            http_field m_body;
+
+            http_header_field m_header_fields[MAX_HTTP_HEADER_COUNT];
+
+            size_t m_header_count;
+
+            bool m_in_header_value;                 //last header piece was value
+
+            uint32_t m_refs;                        //requests in worker threads, loop thread only
+
+            http_completion_queue * m_completions;  //set when handlers run off loop
+
+            size_t m_parsed;                        //bytes of chunk given to parser
+
+            bool m_read_paused;                     //reads stopped by body stream
+
+            resume_func_type m_resume;              //owner restarts reads and parses rest of chunk
+
+            bool m_in_parse;
+
+            std::shared_ptr<http_body_stream> m_stream;     //body stream of current request
         };
 
-        class http_req
+        inline void http_body_stream::pause()
+        {
+            if (m_context)
+            {
+                m_context->pause_read();
+            }
+        }
+
+        inline void http_body_stream::resume()
+        {
+            if (m_context)
+            {
+                m_context->resume_read();
+            }
+        }
+
+        inline bool http_body_stream::paused() const { return m_context && m_context->m_read_paused; }
+
+        //response bytes produced by worker thread, written by loop thread in request order
+        class http_completion
         {
         public:
 
-            std::string m_url;
+            http_context * m_context;
 
-            std::string m_method;
+            uint64_t m_seq;
 
-            std::string m_status_code;
+            http_write_req * m_write;
 
-            std::stringstream m_body;
+            bool m_end;
 
-            std::map<std::string, std::string> m_headers;
+            bool m_close;
         };
 
-        class http_context : public http_req
+        //completions posted by worker threads, drained in batch on loop thread by uv async
+        class http_completion_queue
         {
-
         public:
 
-            std::map<int, uv_write_t> m_writes;
+            typedef std::vector<http_completion> completions_type;
 
-            uv_tcp_t m_handle;
+            http_completion_queue() = default;
 
-            uv_connect_t m_connect_req;
+            int32_t init(uv_loop_t *loop)
+            {
+                m_async.data = this;
 
-            uv_write_t m_write_req;
+                return uv_async_init(loop, &m_async, [](uv_async_t *async)
+                {
+                    static_cast<http_completion_queue *>(async->data)->drain();
+                });
+            }
 
-            http_parser m_parser;
-        };
+            void post(const http_completion &completion)
+            {
+                bool notify = false;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    notify = m_completions.empty();
+                    m_completions.push_back(completion);
+                }
+
+                //loop not yet notified of this batch
+                if (notify)
+                {
+                    uv_async_send(&m_async);
+                }
+            }
+
+            //loop thread: queued responses dropped with their closing connections, nothing posted after
+            void close()
+            {
+                drain();
+                uv_close((uv_handle_t *)&m_async, nullptr);
+            }
+
+        protected:
+
+            void drain()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_draining.swap(m_completions);
+                }
+
+                for (auto &completion : m_draining)
+                {
+                    http_context *context = completion.m_context;
+                    context->write_response(completion.m_seq, completion.m_write, completion.m_end, completion.m_close);
+
+                    if (completion.m_end)
+                    {
+                        context->release_ref();
+                    }
+                }
+
+                m_draining.clear();
+            }
+
+        protected:
+
+            std::mutex m_mutex;
+
+            completions_type m_completions;
+
+            completions_type m_draining;
 
+            uv_async_t m_async;
+        };
 
         class http_rsp : public http_stream<http_rsp>
         {
@@ -109,73 +1226,86 @@ namespace micro
 
             ~http_rsp() {}
 
-            void write_or_end(std::string str, bool end)
+            void write_or_end(const std::string &str, bool end)
             {
                 if (m_ended) throw std::runtime_error("Can not write after end");
 
-                std::stringstream ss;
+                //formatted straight into pooled write buffer owned until write callback
+                http_write_req *write_req = http_write_req::acquire();
+                std::string &out = write_req->m_data;
+
+                bool isChunked = is_chunked();
 
                 if (!m_written_or_ended)
                 {
-
-                    ss << "HTTP/1.1 " << m_status_code << " " << m_status_adjective << CRLF;
+                    out.append("HTTP/1.1 ").append(std::to_string(m_status_code)).append(" ").append(m_status_adjective).append(CRLF);
 
                     for (auto & header : m_headers) 
                     {
-                        ss << header.first << ": " << header.second << CRLF;
+                        out.append(header.first).append(": ").append(header.second).append(CRLF);
+                    }
+
+                    //keep alive needs framed body, otherwise body ends with connection close
+                    if (!m_content_length_set && !isChunked)
+                    {
+                        if (end)
+                        {
+                            out.append("Content-Length: ").append(std::to_string(str.size())).append(CRLF);
+                        }
+                        else
+                        {
+                            m_keep_alive = false;
+                        }
+                    }
+
+                    const std::string *connection = find_header("Connection");
+                    if (nullptr == connection)
+                    {
+                        out.append("Connection: ").append(m_keep_alive ? "keep-alive" : "close").append(CRLF);
+                    }
+                    else if (http_has_token(*connection, "close"))
+                    {
+                        m_keep_alive = false;
                     }
 
-                    ss << CRLF;
+                    out.append(CRLF);
                     m_written_or_ended = true;
                 }
 
-                bool isChunked = m_headers.count("Transfer-Encoding") && m_headers["Transfer-Encoding"] == "chunked";
-
                 if (isChunked) 
                 {
-                    ss << std::hex << str.size()
-                      << std::dec << CRLF << str << CRLF;
+                    //empty chunk would end body
+                    if (!str.empty())
+                    {
+                        char size[32];
+                        snprintf(size, sizeof(size), "%zx", str.size());
+                        out.append(size).append(CRLF).append(str).append(CRLF);
+                    }
                 }
                 else 
                 {
-                    ss << str;
+                    out.append(str);
                 }
 
                 if (isChunked && end) 
                 {
-                    ss << "0" << CRLF << CRLF;
+                    out.append("0").append(CRLF).append(CRLF);
                 }
 
-                str = ss.str();
-
-                //response buffer
-                uv_buf_t res_buf;
-                res_buf.base = (char*)str.c_str();
-                res_buf.len = (unsigned long)str.size();
-
-                http_context * context = static_cast<http_context *>(this->m_parser.data);
-
-                auto id = m_write_count++;
-
-                uv_write_t write_req;
-                context->m_writes.insert({ id, write_req });
+                http_context * context = m_context ? m_context : static_cast<http_context *>(this->m_parser.data);
 
                 if (end)
                 {
                     m_ended = true;
-                    uv_write(&context->m_writes.at(id), (uv_stream_t*)&context->m_handle, &res_buf, 1,
-                        [] (uv_write_t* req, int status)
-                        {
-                            if (!uv_is_closing((uv_handle_t*)req->handle)) 
-                            {
-                                uv_close((uv_handle_t*)req->handle, free_context);
-                            }
-                        }
-                    );
                 }
-                else 
+
+                if (m_completions)
+                {
+                    m_completions->post({ context, m_seq, write_req, end, !m_keep_alive });
+                }
+                else
                 {
-                    uv_write(&context->m_writes.at(id), (uv_stream_t*)&context->m_handle, &res_buf, 1, NULL);
+                    context->write_response(m_seq, write_req, end, !m_keep_alive);
                 }
             }
 
@@ -185,7 +1315,7 @@ namespace micro
 
                 if (m_written_or_ended) throw std::runtime_error("Can not set headers after write");
 
-                if (key == "Content-Length") 
+                if (http_iequals(key, "Content-Length")) 
                 {
                     m_content_length_set = true;
                 }
@@ -193,6 +1323,26 @@ namespace micro
                 m_headers.insert({ key, val });
             }
 
+            //header set by handler, name matched case insensitively, null if not set
+            const std::string * find_header(boost::string_view name) const
+            {
+                for (auto &header : m_headers)
+                {
+                    if (http_iequals(header.first, name))
+                    {
+                        return &header.second;
+                    }
+                }
+
+                return nullptr;
+            }
+
+            bool is_chunked() const
+            {
+                const std::string *encoding = find_header("Transfer-Encoding");
+                return nullptr != encoding && http_iequals(*encoding, "chunked");
+            }
+
             void set_status(int status_code)
             {
                 m_status_set = true;
@@ -227,6 +1377,14 @@ namespace micro
 
             http_parser m_parser;
 
+            http_context * m_context = nullptr;
+
+            http_completion_queue * m_completions = nullptr;    //set when written from worker thread
+
+            uint64_t m_seq = 0;                         //request seq on connection
+
+            bool m_keep_alive = false;
+
             int m_status_code = 200;
 
             std::string m_body = "";
@@ -252,6 +1410,157 @@ namespace micro
             http_buffer<http_rsp> m_buffer;
         };
 
+        //streaming response taken over from http_rsp, head written at once, body chunked unless Content-Length set
+        //write returns false once queued bytes exceed limit, write again after drain callback on loop thread
+        //without worker executor use it on loop thread only
+        class http_rsp_writer
+        {
+        public:
+
+            http_rsp_writer(http_rsp &rsp, size_t max_queued = DEFAULT_HTTP_MAX_QUEUED_WRITE)
+                : m_state(std::make_shared<http_writer_state>(max_queued))
+                , m_ended(false)
+            {
+                if (!rsp.m_content_length_set && nullptr == rsp.find_header("Transfer-Encoding"))
+                {
+                    rsp.set_header("Transfer-Encoding", "chunked");
+                }
+
+                m_chunked = rsp.is_chunked();
+
+                rsp.write_or_end("", false);
+
+                m_context = rsp.m_context ? rsp.m_context : static_cast<http_context *>(rsp.m_parser.data);
+                m_completions = rsp.m_completions;
+                m_seq = rsp.m_seq;
+                m_keep_alive = rsp.m_keep_alive;
+
+                //rsp not ended by server when handler returns
+                rsp.m_ended = true;
+
+                //on loop thread context may close before response ends
+                m_owns_ref = (nullptr == m_completions);
+                if (m_owns_ref)
+                {
+                    m_context->add_ref();
+                }
+            }
+
+            ~http_rsp_writer()
+            {
+                if (!m_ended)
+                {
+                    end();
+                }
+            }
+
+            http_rsp_writer(const http_rsp_writer &) = delete;
+
+            http_rsp_writer & operator=(const http_rsp_writer &) = delete;
+
+            bool write(boost::string_view data)
+            {
+                if (m_ended) throw std::runtime_error("Can not write after end");
+
+                if (data.empty())
+                {
+                    return !m_state->m_blocked;
+                }
+
+                http_write_req *write_req = http_write_req::acquire();
+                append_body(write_req->m_data, data);
+
+                return post(write_req, false);
+            }
+
+            void end(boost::string_view data = boost::string_view())
+            {
+                if (m_ended) throw std::runtime_error("Can not write after end");
+
+                http_write_req *write_req = http_write_req::acquire();
+                append_body(write_req->m_data, data);
+
+                if (m_chunked)
+                {
+                    write_req->m_data.append("0").append(CRLF).append(CRLF);
+                }
+
+                m_ended = true;
+                post(write_req, true);
+            }
+
+            //set before first write
+            void set_on_drain(std::function<void()> on_drain) { m_state->m_on_drain = on_drain; }
+
+            //connection closed, further writes dropped
+            bool aborted() const { return m_state->m_aborted; }
+
+            size_t queued() const { return m_state->m_queued; }
+
+        protected:
+
+            void append_body(std::string &out, boost::string_view data)
+            {
+                if (data.empty())
+                {
+                    return;
+                }
+
+                if (m_chunked)
+                {
+                    char size[32];
+                    snprintf(size, sizeof(size), "%zx", data.size());
+                    out.append(size).append(CRLF).append(data.data(), data.size()).append(CRLF);
+                }
+                else
+                {
+                    out.append(data.data(), data.size());
+                }
+            }
+
+            bool post(http_write_req *write_req, bool end)
+            {
+                write_req->m_writer = m_state;
+                write_req->m_counted = write_req->m_data.size();
+
+                bool ready = m_state->on_queued(write_req->m_counted);
+
+                if (m_completions)
+                {
+                    m_completions->post({ m_context, m_seq, write_req, end, !m_keep_alive });
+                }
+                else
+                {
+                    m_context->write_response(m_seq, write_req, end, !m_keep_alive);
+
+                    if (end && m_owns_ref)
+                    {
+                        m_context->release_ref();
+                    }
+                }
+
+                return ready;
+            }
+
+        protected:
+
+            std::shared_ptr<http_writer_state> m_state;
+
+            http_context * m_context;
+
+            http_completion_queue * m_completions;
+
+            uint64_t m_seq;
+
+            bool m_keep_alive;
+
+            bool m_chunked;
+
+            bool m_ended;
+
+            bool m_owns_ref;
+        };
+
     }
 
 }
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <message/message_pool.hpp>
+
+
+#define HTTP_READ_CHUNK_SIZE                65536
+#define HTTP_MIN_READ_SIZE                  4096                    //grow or compact chunk below this free space
+#define HTTP_POOL_MAX_FREE_CHUNKS           64                      //per thread
+#define HTTP_POOL_MAX_FREE_WRITES           1024                    //per thread
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //per thread free list of objects, objects are returned to the pool of the acquiring thread
+        //objects live behind a pool_block header, remote release and thread exit handled by pool_home
+        template<typename T, size_t max_free>
+        class http_object_pool
+        {
+        public:
+
+            ~http_object_pool()
+            {
+                for (auto obj : m_free)
+                {
+                    destroy(obj);
+                }
+
+                m_free.clear();
+
+                m_home.close([](pool_block *block) { destroy(static_cast<T *>(block->body())); });
+            }
+
+            static T * acquire()
+            {
+                http_object_pool *local = thread_local_pool<http_object_pool>::get();
+                return local ? local->take() : create(nullptr);
+            }
+
+            static void release(T *obj)
+            {
+                pool_block *block = pool_block::of(obj);
+                if (nullptr == block->m_owner)
+                {
+                    destroy(obj);
+                    return;
+                }
+
+                http_object_pool *local = thread_local_pool<http_object_pool>::get();
+                if (nullptr == local || block->m_owner != local->m_home.owner())
+                {
+                    pool_home::release_remote(block, [](pool_block *block) { destroy(static_cast<T *>(block->body())); });
+                    return;
+                }
+
+                local->m_home.returned();
+                local->put_local(obj);
+            }
+
+        protected:
+
+            T * take()
+            {
+                if (m_free.empty())
+                {
+                    m_home.drain([this](pool_block *block) { put_local(static_cast<T *>(block->body())); });
+                }
+
+                m_home.taken();
+                if (m_free.empty())
+                {
+                    return create(m_home.owner());
+                }
+
+                T *obj = m_free.back();
+                m_free.pop_back();
+
+                return obj;
+            }
+
+            void put_local(T *obj)
+            {
+                if (m_free.size() >= max_free)
+                {
+                    destroy(obj);
+                    return;
+                }
+
+                m_free.push_back(obj);
+            }
+
+            static T * create(pool_owner *owner)
+            {
+                pool_block *block = static_cast<pool_block *>(::operator new(MSG_POOL_HEADER_SIZE + sizeof(T)));
+                block->m_next = nullptr;
+                block->m_owner = owner;
+
+                try
+                {
+                    return new (block->body()) T();
+                }
+                catch (...)
+                {
+                    ::operator delete(block);
+                    throw;
+                }
+            }
+
+            static void destroy(T *obj)
+            {
+                pool_block *block = pool_block::of(obj);
+
+                obj->~T();
+                ::operator delete(block);
+            }
+
+        protected:
+
+            pool_home m_home;
+
+            std::vector<T *> m_free;
+
+        };
+
+        //ref counted receive buffer, request views point into it
+        class http_chunk
+        {
+        public:
+
+            typedef std::shared_ptr<http_chunk> ptr_type;
+
+            typedef http_object_pool<http_chunk, HTTP_POOL_MAX_FREE_CHUNKS> pool_type;
+
+            http_chunk(size_t capacity = HTTP_READ_CHUNK_SIZE) : m_data(new char[capacity]), m_capacity(capacity) {}
+
+            ~http_chunk() { delete[] m_data; }
+
+            http_chunk(const http_chunk &) = delete;
+
+            http_chunk & operator=(const http_chunk &) = delete;
+
+            //default size chunks are pooled, larger ones for big requests go back to heap
+            static ptr_type acquire(size_t capacity = HTTP_READ_CHUNK_SIZE)
+            {
+                http_chunk *chunk = (HTTP_READ_CHUNK_SIZE == capacity) ? pool_type::acquire() : new http_chunk(capacity);
+
+                return ptr_type(chunk, [](http_chunk *chunk)
+                {
+                    if (HTTP_READ_CHUNK_SIZE == chunk->m_capacity)
+                    {
+                        pool_type::release(chunk);
+                    }
+                    else
+                    {
+                        delete chunk;
+                    }
+                }, pool_allocator<http_chunk>());
+            }
+
+        public:
+
+            char *m_data;
+
+            size_t m_capacity;
+        };
+
+    }
+
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <io/http_macro.hpp>
+#include <common/error.hpp>
+#include <logger/logger.hpp>
+
+
+#define HTTP_ROUTE_ANY_METHOD           "*"
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //radix tree of (method, path pattern) --> handler
+        //pattern segments: static text, ":name" one path segment, "*name" rest of path
+        //':' and '*' are special only at segment start, "/time/12:30" or "/a*b" are static text
+        class http_router
+        {
+        public:
+
+            typedef std::function<void(http_req&, http_rsp&)> handler_type;
+
+            http_router() : m_root(new route_node())
+            {
+                m_not_found = [](http_req &req, http_rsp &rsp)
+                {
+                    rsp.set_status(404, "Not Found");
+                    rsp.end();
+                };
+            }
+
+            ~http_router() = default;
+
+            //method HTTP_ROUTE_ANY_METHOD matches all methods, register all routes before serving
+            int32_t add(const std::string &method, const std::string &pattern, handler_type handler)
+            {
+                if (pattern.empty() || '/' != pattern[0])
+                {
+                    LOG_ERROR << "http route pattern should start with /: " << pattern;
+                    return ERR_FAILED;
+                }
+
+                route_node *node = insert(m_root.get(), pattern, 0);
+                if (nullptr == node)
+                {
+                    LOG_ERROR << "http route pattern conflict: " << pattern;
+                    return ERR_FAILED;
+                }
+
+                for (auto &it : node->m_handlers)
+                {
+                    if (it.first == method)
+                    {
+                        it.second = handler;
+                        return ERR_SUCCESS;
+                    }
+                }
+
+                node->m_handlers.push_back({ method, handler });
+                return ERR_SUCCESS;
+            }
+
+            int32_t get(const std::string &pattern, handler_type handler) { return add("GET", pattern, handler); }
+
+            int32_t post(const std::string &pattern, handler_type handler) { return add("POST", pattern, handler); }
+
+            int32_t put(const std::string &pattern, handler_type handler) { return add("PUT", pattern, handler); }
+
+            int32_t del(const std::string &pattern, handler_type handler) { return add("DELETE", pattern, handler); }
+
+            void set_not_found(handler_type handler) { m_not_found = handler; }
+
+            //match request path, fill req.m_params, nullptr if no route
+            const handler_type * match(http_req &req) const
+            {
+                boost::string_view path = req.m_url.substr(0, req.m_url.find('?'));
+
+                req.m_params.clear();
+                return match(m_root.get(), path, req.m_method, req.m_params);
+            }
+
+            void route(http_req &req, http_rsp &rsp) const
+            {
+                const handler_type *handler = match(req);
+                (handler ? *handler : m_not_found)(req, rsp);
+            }
+
+            //svc functor of http server, router should outlive server
+            std::function<void(http_req&, http_rsp&)> functor() const
+            {
+                return [this](http_req &req, http_rsp &rsp) { route(req, rsp); };
+            }
+
+        protected:
+
+            class route_node
+            {
+            public:
+
+                typedef std::unique_ptr<route_node> ptr_type;
+
+                std::string m_prefix;                                           //static label of edge into node
+
+                std::vector<ptr_type> m_children;                               //static children, distinct first char
+
+                ptr_type m_param;                                               //":name" child
+
+                std::string m_param_name;
+
+                ptr_type m_wildcard;                                            //"*name" child, always leaf
+
+                std::string m_wildcard_name;
+
+                std::vector<std::pair<std::string, handler_type>> m_handlers;   //by method
+            };
+
+            //return node of pattern from pos, nullptr on conflicting param names
+            route_node * insert(route_node *node, const std::string &pattern, size_t pos)
+            {
+                if (pos >= pattern.size())
+                {
+                    return node;
+                }
+
+                if (':' == pattern[pos] && segment_start(pattern, pos))
+                {
+                    size_t end = pattern.find('/', pos);
+                    std::string name = pattern.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+
+                    if (!node->m_param)
+                    {
+                        node->m_param.reset(new route_node());
+                        node->m_param_name = name;
+                    }
+                    else if (node->m_param_name != name)
+                    {
+                        return nullptr;
+                    }
+
+                    return insert(node->m_param.get(), pattern, end == std::string::npos ? pattern.size() : end);
+                }
+
+                if ('*' == pattern[pos] && segment_start(pattern, pos))
+                {
+                    std::string name = pattern.substr(pos + 1);
+
+                    if (!node->m_wildcard)
+                    {
+                        node->m_wildcard.reset(new route_node());
+                        node->m_wildcard_name = name;
+                    }
+                    else if (node->m_wildcard_name != name)
+                    {
+                        return nullptr;
+                    }
+
+                    return node->m_wildcard.get();
+                }
+
+                //static text up to next param or wildcard segment
+                size_t end = pos + 1;
+                while (end < pattern.size() && !(('*' == pattern[end] || ':' == pattern[end]) && segment_start(pattern, end)))
+                {
+                    end++;
+                }
+
+                std::string label = pattern.substr(pos, end - pos);
+
+                for (auto &child : node->m_children)
+                {
+                    if (child->m_prefix[0] != label[0])
+                    {
+                        continue;
+                    }
+
+                    size_t common = 0;
+                    while (common < child->m_prefix.size() && common < label.size() && child->m_prefix[common] == label[common])
+                    {
+                        common++;
+                    }
+
+                    //split edge at common prefix
+                    if (common < child->m_prefix.size())
+                    {
+                        route_node::ptr_type mid(new route_node());
+                        mid->m_prefix = child->m_prefix.substr(0, common);
+                        child->m_prefix = child->m_prefix.substr(common);
+                        mid->m_children.push_back(std::move(child));
+                        child = std::move(mid);
+                    }
+
+                    return insert(child.get(), pattern, pos + common);
+                }
+
+                route_node::ptr_type child(new route_node());
+                child->m_prefix = label;
+                node->m_children.push_back(std::move(child));
+
+                return insert(node->m_children.back().get(), pattern, end);
+            }
+
+            static bool segment_start(const std::string &pattern, size_t pos) { return pos > 0 && '/' == pattern[pos - 1]; }
+
+            //static edges first, then param, then wildcard, backtrack on dead end
+            const handler_type * match(const route_node *node, boost::string_view path, boost::string_view method, http_params &params) const
+            {
+                if (path.empty())
+                {
+                    const handler_type *handler = find_handler(node, method);
+                    if (handler)
+                    {
+                        return handler;
+                    }
+                }
+
+                for (auto &child : node->m_children)
+                {
+                    if (path.size() >= child->m_prefix.size() && 0 == path.compare(0, child->m_prefix.size(), child->m_prefix))
+                    {
+                        const handler_type *handler = match(child.get(), path.substr(child->m_prefix.size()), method, params);
+                        if (handler)
+                        {
+                            return handler;
+                        }
+
+                        break;
+                    }
+                }
+
+                size_t count = params.size();
+
+                if (node->m_param && !path.empty())
+                {
+                    size_t end = path.find('/');
+                    boost::string_view segment = path.substr(0, end);
+
+                    if (!segment.empty() && params.add(node->m_param_name, segment))
+                    {
+                        const handler_type *handler = match(node->m_param.get(), path.substr(segment.size()), method, params);
+                        if (handler)
+                        {
+                            return handler;
+                        }
+
+                        params.resize(count);
+                    }
+                }
+
+                if (node->m_wildcard)
+                {
+                    const handler_type *handler = find_handler(node->m_wildcard.get(), method);
+                    if (handler && params.add(node->m_wildcard_name, path))
+                    {
+                        return handler;
+                    }
+                }
+
+                return nullptr;
+            }
+
+            static const handler_type * find_handler(const route_node *node, boost::string_view method)
+            {
+                const handler_type *any = nullptr;
+
+                for (auto &it : node->m_handlers)
+                {
+                    if (method == it.first)
+                    {
+                        return &it.second;
+                    }
+
+                    if (HTTP_ROUTE_ANY_METHOD == it.first)
+                    {
+                        any = &it.second;
+                    }
+                }
+
+                return any;
+            }
+
+        protected:
+
+            route_node::ptr_type m_root;
+
+            handler_type m_not_found;
+        };
+
+    }
+
+}
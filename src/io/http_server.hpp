@@ -1,193 +1,619 @@
 #pragma once
 
+#include <memory>
+#include <vector>
 #include <functional>
+#include <algorithm>
 #include <io/http_macro.hpp>
+#include <logger/logger.hpp>
 #include <thread/uv_thread_pool.hpp>
+#include <message/message.hpp>
+#include <message/msg_type_registry.hpp>
+#include <module/multi_thread_module.hpp>
 
 #ifndef _WIN32
+#include <cerrno>
 #include <unistd.h>
+#include <sys/socket.h>
 #endif
 
 #define MAX_WRITE_HANDLES           1000
+#define DEFAULT_HTTP_LOOP_COUNT     1
+#define HTTP_TASK_MSG               "http_task"
 
 namespace micro
 {
     namespace core
     {
 
+        class http_server;
+
+        //one listening loop: own uv loop thread, listen socket and parser settings
+        class http_server_loop
+        {
+        public:
+
+            http_server_loop(http_server *server) : m_server(server), m_settings() {}
+
+            http_server * m_server;
+
+            uv_thread_pool m_pool;
+
+            uv_tcp_t m_socket;
+
+            http_parser_settings m_settings;
+
+            http_completion_queue m_completions;            //responses from worker threads
+
+            uv_async_t m_stop;
+
+            bool m_initialized = false;                     //uv loop created, handles to close before it is deleted
+
+            bool m_running = false;                         //listening and loop thread started
+        };
+
+        //request and response handed to worker thread
+        class http_task
+        {
+        public:
+
+            http_req m_req;
+
+            http_rsp m_rsp;
+        };
+
+        //runs http handler task in worker thread
+        class http_task_body : public base_body
+        {
+        public:
+
+            std::function<void()> m_task;
+        };
+
         class http_server
         {
         public:
 
             typedef std::function<void(http_req&, http_rsp&)> svc_functor;
 
+            typedef std::shared_ptr<http_server_loop> loop_ptr_type;
+
+            typedef std::function<void(std::function<void()>)> executor_type;
+
+            typedef std::function<bool(std::shared_ptr<http_body_stream>)> stream_functor;
+
             template<typename Type>
             friend void attachEvents(Type* instance, http_parser_settings& settings);
 
-            http_server(svc_functor functor) : m_functor(functor)
+            http_server(svc_functor functor)
+                : m_functor(functor)
+                , m_keep_alive(true)
+                , m_idle_timeout(DEFAULT_HTTP_IDLE_TIMEOUT)
+                , m_max_requests(DEFAULT_HTTP_MAX_REQUESTS)
             {
-                m_pool.init();
-                m_pool.start();
             }
 
-            ~http_server() = default;
-
-            int32_t listen(const std::string &ip, uint16_t port)
+            ~http_server()
             {
-                static http_parser_settings settings;
-                attachEvents(this, settings);
+                stop();
+            }
 
-                int status = 0;
+            //loop_count 0: one loop per core, more than one loop listens with SO_REUSEPORT
+            int32_t listen(const std::string &ip, uint16_t port, uint32_t loop_count = DEFAULT_HTTP_LOOP_COUNT)
+            {
+                if (!m_loops.empty())
+                {
+                    LOG_ERROR << "http server already listening";
+                    return ERR_FAILED;
+                }
 
+                if (0 == loop_count)
+                {
 #ifdef _WIN32
-                SYSTEM_INFO sysinfo;
-                GetSystemInfo(&sysinfo);
-                int cores = sysinfo.dwNumberOfProcessors;
+                    SYSTEM_INFO sysinfo;
+                    GetSystemInfo(&sysinfo);
+                    loop_count = sysinfo.dwNumberOfProcessors;
 #else
-                int cores = sysconf(_SC_NPROCESSORS_ONLN);
+                    loop_count = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
 #endif
+                }
 
-                std::stringstream cores_string;
-                cores_string << cores;
-                std::string str;
-
-#ifdef _WIN32
-                SetEnvironmentVariableA("UV_THREADPOOL_SIZE", cores_string.str().c_str());
-#else
-                setenv("UV_THREADPOOL_SIZE", cores_string.str().c_str(), 1);
+#ifndef SO_REUSEPORT
+                //no kernel load balance between listen sockets
+                loop_count = 1;
 #endif
 
-                struct sockaddr_in address;
+                int status = 0;
+                struct sockaddr_storage address;
+                memset(&address, 0, sizeof(address));
+
+                //ipv6 literal has ':', "::" listens dual stack
+                if (std::string::npos != ip.find(':'))
+                {
+                    status = uv_ip6_addr(ip.c_str(), port, (struct sockaddr_in6 *)&address);
+                }
+                else
+                {
+                    status = uv_ip4_addr(ip.c_str(), port, (struct sockaddr_in *)&address);
+                }
+
+                if (0 != status)
+                {
+                    LOG_ERROR << "http server resolve address error: " << uv_strerror(status) << " ip: " << ip;
+                    return ERR_FAILED;
+                }
 
-                static std::function<void(uv_stream_t* socket, int status)> on_connect;
-                static std::function<void(uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf)> read;
+                for (uint32_t i = 0; i < std::max(loop_count, (uint32_t)1); i++)
+                {
+                    loop_ptr_type loop = std::make_shared<http_server_loop>(this);
+                    m_loops.push_back(loop);
+
+                    attachEvents(this, loop->m_settings);
 
-                //m_loop = uv_default_loop();
-                m_loop = m_pool.get_loop();
-                uv_tcp_init(m_loop, &m_socket);
+                    if (ERR_SUCCESS != loop->m_pool.init())
+                    {
+                        LOG_ERROR << "http server init loop failed";
+                        stop();
+                        return ERR_FAILED;
+                    }
 
-                //
-                // @TODO - Not sure exactly how to use this,
-                // after the initial timeout, it just
-                // seems to kill the server.
-                //
-                //uv_tcp_keepalive(&socket_,1,60);
+                    loop->m_initialized = true;
 
-                status = uv_ip4_addr(ip.c_str(), port, &address);
-                ASSERT_STATUS(status, "Resolve Address");
+                    status = loop->m_completions.init(loop->m_pool.get_loop());
+                    if (0 != status)
+                    {
+                        return listen_failed("init async", status);
+                    }
 
-                status = uv_tcp_bind(&m_socket, (const struct sockaddr*) &address, 0);
-                ASSERT_STATUS(status, "Bind");
+                    loop->m_stop.data = loop.get();
+                    status = uv_async_init(loop->m_pool.get_loop(), &loop->m_stop, [](uv_async_t *async)
+                    {
+                        http_server_loop *loop = static_cast<http_server_loop *>(async->data);
 
-                // called once a connection is made.
-                on_connect = [&](uv_stream_t* handle, int status)
+                        close_handles(loop);
+                        uv_stop(loop->m_pool.get_loop());
+                    });
+
+                    if (0 != status)
+                    {
+                        return listen_failed("init async", status);
+                    }
+
+                    uv_tcp_init(loop->m_pool.get_loop(), &loop->m_socket);
+                    loop->m_socket.data = loop.get();
+
+                    if (loop_count > 1)
+                    {
+                        status = open_reuse_port(&loop->m_socket, address.ss_family);
+                        if (0 != status)
+                        {
+                            return listen_failed("reuse port", status);
+                        }
+                    }
+
+                    status = uv_tcp_bind(&loop->m_socket, (const struct sockaddr*) &address, 0);
+                    if (0 != status)
+                    {
+                        return listen_failed("bind", status);
+                    }
+
+                    status = uv_listen((uv_stream_t*)&loop->m_socket, MAX_WRITE_HANDLES,
+                        // listener
+                        [](uv_stream_t* socket, int status)
+                        {
+                            http_server_loop * loop = static_cast<http_server_loop *>(socket->data);
+                            loop->m_server->on_connect(loop, socket, status);
+                        });
+
+                    if (0 != status)
+                    {
+                        return listen_failed("listen", status);
+                    }
+
+                    // loop set up before its thread runs
+                    loop->m_pool.start();
+                    loop->m_running = true;
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            //close listen sockets and connections on their loops and join loop threads, listen may be called again after
+            //with executor set, stop workers first: requests still in a worker are dropped with their connection
+            void stop()
+            {
+                for (auto &loop : m_loops)
+                {
+                    if (loop->m_running)
+                    {
+                        uv_async_send(&loop->m_stop);
+                        loop->m_pool.stop();
+                    }
+                    else if (loop->m_initialized)
+                    {
+                        //loop thread never ran, handles closed here
+                        close_handles(loop.get());
+                    }
+
+                    if (loop->m_initialized)
+                    {
+                        loop->m_pool.exit();
+                    }
+
+                    loop->m_running = false;
+                    loop->m_initialized = false;
+                }
+
+                m_loops.clear();
+            }
+
+            // called once a connection is made.
+            void on_connect(http_server_loop *loop, uv_stream_t* handle, int status)
+            {
+                if (status < 0)
                 {
-                    http_context * context = new http_context();
+                    return;
+                }
 
-                    // init tcp handle
-                    uv_tcp_init(m_loop, &context->m_handle);
+                http_context * context = new http_context();
 
-                    // init http parser
-                    http_parser_init(&context->m_parser, HTTP_REQUEST);
+                // init tcp handle
+                uv_tcp_init(loop->m_pool.get_loop(), &context->m_handle);
 
-                    // client reference for parser routines
-                    context->m_parser.data = context;
+                // init http parser
+                http_parser_init(&context->m_parser, HTTP_REQUEST);
 
-                    // client reference for handle data on requests
-                    context->m_handle.data = context;
+                // client reference for parser routines
+                context->m_parser.data = context;
 
-                    // accept connection passing in refernce to the client handle
-                    uv_accept(handle, (uv_stream_t*)&context->m_handle);
+                // client reference for handle data on requests
+                context->m_handle.data = context;
 
-                    // called for every read
-                    read = [&](uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf) 
+                // owner and parser settings of the accepting loop
+                context->m_owner = this;
+                context->m_settings = &loop->m_settings;
+                context->m_completions = &loop->m_completions;
+                context->m_resume = resume_read;
+
+                // persistent connection settings
+                context->m_keep_alive = m_keep_alive;
+                context->m_idle_timeout = m_idle_timeout;
+                context->m_max_requests = m_max_requests;
+                context->init_idle_timer(loop->m_pool.get_loop());
+
+                // accept connection passing in refernce to the client handle
+                if (0 != uv_accept(handle, (uv_stream_t*)&context->m_handle))
+                {
+                    context->close();
+                    return;
+                }
+
+                uv_tcp_nodelay(&context->m_handle, 1);
+                http_no_sigpipe(&context->m_handle);
+
+                start_read(context);
+            }
+
+            // allocate memory and attempt to read.
+            static void start_read(http_context *context)
+            {
+                uv_read_start((uv_stream_t*)&context->m_handle,
+                    // allocator: free space of pooled receive chunk
+                    [](uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
+                    {
+                        static_cast<http_context *>(handle->data)->alloc_read(buf);
+                    },
+
+                    // reader
+                    [](uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf)
                     {
-                        ssize_t parsed;
                         http_context * context = static_cast<http_context *>(tcp->data);
+                        static_cast<http_server *>(context->m_owner)->read(tcp, nread, buf);
+                    });
+            }
 
-                        if (nread >= 0) 
-                        {
-                            parsed = (ssize_t)http_parser_execute(&context->m_parser,
-                                &settings,
-                                buf->base,
-                                nread);
+            // called for every read, buf is in receive chunk of connection
+            void read(uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf)
+            {
+                http_context * context = static_cast<http_context *>(tcp->data);
 
-                            // close handle
-                            if (parsed < nread) 
-                            {
-                                uv_close((uv_handle_t*)&context->m_handle, free_context);
-                            }
+                if (nread >= 0)
+                {
+                    if (0 == nread || context->m_no_more_req || context->m_closing)
+                    {
+                        return;
+                    }
+
+                    context->restart_idle_timer();
+                    parse(context, (size_t)nread);
+                }
+                else
+                {
+                    if (nread != UV_EOF)
+                    {
+                        // @TODO - debug error
+                    }
+
+                    // peer done sending: close now or after pending responses written
+                    context->m_no_more_req = true;
+                    if (nread != UV_EOF || context->m_rsp_seq == context->m_req_seq)
+                    {
+                        context->close();
+                    }
+                }
+            }
+
+            // parse bytes newly read or left by paused body stream
+            void parse(http_context *context, size_t nread)
+            {
+                if (ERR_SUCCESS != context->parse(nread, [this, context]() { complete(&context->m_parser, m_functor); }))
+                {
+                    // close handle
+                    context->close();
+                }
+                else if (context->m_no_more_req || context->m_read_paused)
+                {
+                    // last request on connection parsed, ignore the rest; or body stream paused
+                    uv_read_stop((uv_stream_t*)&context->m_handle);
+                }
+            }
+
+            // body stream resumed: parse rest of chunk then read again
+            static void resume_read(http_context *context)
+            {
+                static_cast<http_server *>(context->m_owner)->parse(context, 0);
+
+                if (!context->m_closing && !context->m_no_more_req && !context->m_read_paused)
+                {
+                    start_read(context);
+                }
+            }
+
+            // headers parsed: stream functor may take the body in pieces
+            int headers_complete(http_parser* parser)
+            {
+                if (!m_stream_functor)
+                {
+                    return 0;
+                }
+
+                http_context * context = reinterpret_cast<http_context *>(parser->data);
+
+                std::shared_ptr<http_body_stream> stream = std::make_shared<http_body_stream>();
+                stream->m_req.m_url = context->view(context->m_url);
+                stream->m_req.m_method = http_method_str((enum http_method) parser->method);
+                context->fill_headers(stream->m_req.m_headers);
+                stream->m_req.m_chunk = context->m_chunk;
+
+                if (!m_stream_functor(stream))
+                {
+                    return 0;
+                }
+
+                // url and headers held by stream request, body bytes dropped once delivered
+                stream->m_context = context;
+                context->m_stream = stream;
+                context->reset_req();
+
+                return 0;
+            }
+
+            // request views point into receive chunk, valid while request holds it
+            int complete(http_parser* parser, svc_functor &functor)
+            {
+                http_context * context = reinterpret_cast<http_context *>(parser->data);
+
+                // streamed request ends in body stream end functor
+                std::shared_ptr<http_body_stream> stream = context->detach_stream();
+                svc_functor &handler = (stream && stream->m_on_end) ? stream->m_on_end : functor;
+
+                if (m_executor)
+                {
+                    // loop thread only parses, handler and response formatting in worker
+                    std::shared_ptr<http_task> task = std::make_shared<http_task>();
+                    prepare(parser, task->m_req, task->m_rsp, stream.get());
+                    task->m_rsp.m_completions = context->m_completions;
+
+                    context->add_ref();
+
+                    m_executor([task, stream, &handler]()
+                    {
+                        try
+                        {
+                            handler(task->m_req, task->m_rsp);
                         }
-                        else 
+                        catch (...)
                         {
-                            if (nread != UV_EOF)
+                            LOG_ERROR << "http handler exception: " << task->m_req.m_url;
+
+                            if (!task->m_rsp.m_written_or_ended)
                             {
-                                // @TODO - debug error
+                                task->m_rsp.set_status(500, "Internal Server Error");
                             }
+                        }
 
-                            // close handle
-                            uv_close((uv_handle_t*)&context->m_handle, free_context);
+                        // response object goes out of scope, context released by loop thread
+                        if (!task->m_rsp.m_ended)
+                        {
+                            task->m_rsp.end();
                         }
+                    });
 
-                        // free request buffer data
-                        free(buf->base);
-                    };
+                    return 0;
+                }
 
-                    // allocate memory and attempt to read.
-                    uv_read_start((uv_stream_t*)&context->m_handle,
-                        // allocator
-                        [](uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) 
-                        {
-                            *buf = uv_buf_init((char*)malloc(suggested_size), (unsigned int)suggested_size);
-                        },
+                http_req req;
+                http_rsp rsp;
 
-                        // reader
-                        [](uv_stream_t* tcp, ssize_t nread, const uv_buf_t* buf) 
-                        {
-                            read(tcp, nread, buf);
-                        });
-                };
+                prepare(parser, req, rsp, stream.get());
 
-                status = uv_listen((uv_stream_t*)&m_socket, MAX_WRITE_HANDLES,
-                    // listener
-                    [](uv_stream_t* socket, int status) 
-                    {
-                        on_connect(socket, status);
-                    });
+                handler(req, rsp);
 
-                ASSERT_STATUS(status, "Listen");
+                // response object goes out of scope
+                if (!rsp.m_ended)
+                {
+                    rsp.end();
+                }
 
-                // init loop
-                //uv_run(m_loop, UV_RUN_DEFAULT);
                 return 0;
             }
 
-            int complete(http_parser* parser, svc_functor functor)
+            // called on loop thread when request headers parsed, return true to take body in pieces
+            // through stream data functor, stream end functor then handles request; set before listen
+            void set_stream_functor(stream_functor functor) { m_stream_functor = functor; }
+
+            // run handlers in worker pool, loop threads only do io and parsing; set before listen
+            void set_executor(executor_type executor) { m_executor = executor; }
+
+            // run handlers in threads of initialized multi thread module, module should outlive server
+            void set_workers(multi_thread_module &workers)
+            {
+                workers.register_msg_functor(HTTP_TASK_MSG, [](std::shared_ptr<message> msg) -> int32_t
+                {
+                    std::static_pointer_cast<http_task_body>(msg->m_body)->m_task();
+                    return ERR_SUCCESS;
+                });
+
+                set_executor([&workers](std::function<void()> task)
+                {
+                    std::shared_ptr<http_task_body> body = std::make_shared<http_task_body>();
+                    body->m_task = std::move(task);
+
+                    std::shared_ptr<message> msg = make_message();
+                    msg->set_msg_id(MSG_TYPE_ID(HTTP_TASK_MSG));
+                    msg->m_body = body;
+
+                    workers.round_robin_send(msg);
+                });
+            }
+
+            // keep alive connections, default on
+            void set_keep_alive(bool keep_alive) { m_keep_alive = keep_alive; }
+
+            // idle timeout of connection in ms, 0 to disable
+            void set_idle_timeout(uint64_t idle_timeout) { m_idle_timeout = idle_timeout; }
+
+            // max requests served on one connection
+            void set_max_requests(uint32_t max_requests) { m_max_requests = std::max(max_requests, (uint32_t)1); }
+
+            size_t loop_count() const { return m_loops.size(); }
+
+        protected:
+
+            int32_t listen_failed(const char *what, int status)
+            {
+                LOG_ERROR << "http server " << what << " error: " << uv_strerror(status);
+
+                stop();
+                return ERR_FAILED;
+            }
+
+            //connections first, they close own idle timers and drop responses queued for them,
+            //then listen socket and asyncs; flush check is closed by pool exit
+            static void close_handles(http_server_loop *loop)
+            {
+                uv_walk(loop->m_pool.get_loop(), [](uv_handle_t *handle, void *arg)
+                {
+                    if (UV_TCP == handle->type && arg != handle->data && !uv_is_closing(handle))
+                    {
+                        static_cast<http_context *>(handle->data)->close();
+                    }
+                }, loop);
+
+                uv_walk(loop->m_pool.get_loop(), [](uv_handle_t *handle, void *arg)
+                {
+                    http_server_loop *loop = static_cast<http_server_loop *>(arg);
+                    if (uv_is_closing(handle) || UV_CHECK == handle->type)
+                    {
+                        return;
+                    }
+
+                    if (handle->data == &loop->m_completions)
+                    {
+                        loop->m_completions.close();
+                        return;
+                    }
+
+                    uv_close(handle, nullptr);
+                }, loop);
+            }
+
+            void prepare(http_parser* parser, http_req &req, http_rsp &rsp, http_body_stream *stream)
             {
                 http_context * context = reinterpret_cast<http_context *>(parser->data);
-                http_req req;
-                http_rsp rsp;
 
-                req.m_url = context->m_url;
-                req.m_method = context->m_method;
-                req.m_headers = context->m_headers;
-                req.m_body.swap(context->m_body);                
+                if (stream)
+                {
+                    req = std::move(stream->m_req);
+                }
+                else
+                {
+                    req.m_url = context->view(context->m_url);
+                    req.m_method = http_method_str((enum http_method) parser->method);
+                    req.m_body = context->view(context->m_body);
+                    context->fill_headers(req.m_headers);
+                    req.m_chunk = context->m_chunk;
+                }
+
+                // last request on connection: not keep alive or reach max requests
+                ++context->m_req_count;
+                bool keep_alive = context->m_keep_alive && http_should_keep_alive(parser) && (context->m_req_count < context->m_max_requests);
+                if (!keep_alive)
+                {
+                    context->m_no_more_req = true;
+                }
 
                 rsp.m_parser = *parser;
+                rsp.m_context = context;
+                rsp.m_seq = context->m_req_seq++;
+                rsp.m_keep_alive = keep_alive;
+            }
 
-                functor(req, rsp);
-                return 0;
+            //listen socket shared with other loops, kernel balances connections between them
+            int open_reuse_port(uv_tcp_t *socket, int family)
+            {
+#ifdef SO_REUSEPORT
+                int fd = ::socket(family, SOCK_STREAM, 0);
+                if (fd < 0)
+                {
+                    return uv_translate_sys_error(errno);
+                }
+
+                int on = 1;
+                if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+                {
+                    int err = uv_translate_sys_error(errno);
+                    ::close(fd);
+                    return err;
+                }
+
+                int status = uv_tcp_open(socket, fd);
+                if (0 != status)
+                {
+                    ::close(fd);
+                }
+
+                return status;
+#else
+                return UV_ENOTSUP;
+#endif
             }
 
         protected:
 
-            uv_thread_pool m_pool;
+            std::vector<loop_ptr_type> m_loops;
 
-            uv_loop_t* m_loop;
+            svc_functor m_functor;
 
-            uv_tcp_t m_socket;
+            executor_type m_executor;
 
-            svc_functor m_functor;
+            stream_functor m_stream_functor;
+
+            bool m_keep_alive;
+
+            uint64_t m_idle_timeout;
+
+            uint32_t m_max_requests;
 
         };
 
@@ -171,6 +171,25 @@ namespace micro
                 }
             }
 
+            virtual void fire_channel_batch_read_complete()
+            {
+                context_ptr_type next = find_next_context(MASK_CHANNEL_BATCH_READ_COMPLETE);
+                if (next)
+                {
+                    next->invoke_channel_batch_read_complete();
+                }
+            }
+
+            virtual void invoke_channel_batch_read_complete()
+            {
+                if (m_handler)
+                {
+                    auto handler = DYN_CAST(channel_inbound_handler, m_handler);
+                    assert(handler != nullptr);
+                    handler->channel_batch_read_complete(*this);
+                }
+            }
+
             virtual void fire_channel_write()
             {
                 context_ptr_type next = find_next_context(MASK_CHANNEL_WRITE);
@@ -70,6 +70,9 @@ namespace micro
 
             virtual void channel_read_complete(context_type &ctx) { ctx.fire_channel_read_complete(); }
 
+            //several datagrams received in one wakeup, udp channel batch mode
+            virtual void channel_batch_read_complete(context_type &ctx) { ctx.fire_channel_batch_read_complete(); }
+
             //virtual void channel_writablity_changed(context_type &ctx) { ctx.fire_channel_writablity_changed(); }
             
         };
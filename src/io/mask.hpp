@@ -24,8 +24,9 @@
 #define MASK_FLUSH  (1 << 20)
 #define MASK_CHANNEL_BATCH_WRITE  (1 << 21)
 #define MASK_CHANNEL_BATCH_WRITE_COMPLETE  (1 << 22)
+#define MASK_CHANNEL_BATCH_READ_COMPLETE  (1 << 23)
 
-#define MASK_ALL_INBOUND (MASK_EXCEPTION_CAUGHT | MASK_CHANNEL_ACTIVE | MASK_CHANNEL_INACTIVE | MASK_CHANNEL_READ | MASK_CHANNEL_READ_COMPLETE)
+#define MASK_ALL_INBOUND (MASK_EXCEPTION_CAUGHT | MASK_CHANNEL_ACTIVE | MASK_CHANNEL_INACTIVE | MASK_CHANNEL_READ | MASK_CHANNEL_READ_COMPLETE | MASK_CHANNEL_BATCH_READ_COMPLETE)
 #define MASK_ALL_OUTBOUND (MASK_EXCEPTION_CAUGHT | MASK_CHANNEL_WRITE | MASK_CHANNEL_WRITE_COMPLETE | MASK_CHANNEL_BATCH_WRITE | MASK_CHANNEL_BATCH_WRITE_COMPLETE)
 #define MASK_ALL_ACCEPTOR (MASK_EXCEPTION_CAUGHT | MASK_ACCEPTED)
 #define MASK_ALL_CONNECTOR (MASK_EXCEPTION_CAUGHT | MASK_BIND | MASK_CONNECT | MASK_CONNECTED)
@@ -1,6 +1,8 @@
 #pragma once
 
 
+#include <string>
+#include <cstring>
 #include <boost/asio.hpp>
 
 
@@ -23,10 +25,11 @@ namespace micro
         
             socket_address(const std::string &ip, uint16_t port) : m_ip(ip), m_port(port),m_ep(boost::asio::ip::address::from_string(ip), port) {}
 
-            socket_address(const ep_type &ep) : m_ip(ep.address().to_string()), m_port(ep.port()) {}
+            socket_address(const ep_type &ep) : m_ep(ep), m_ip(ep.address().to_string()), m_port(ep.port()) {}
 
             socket_address& operator=(const ep_type &ep)
             {
+                m_ep = ep;
                 m_ip = ep.address().to_string();
                 m_port = ep.port();
                 return *this;
@@ -40,6 +43,22 @@ namespace micro
             uint16_t get_port() const { return m_port; }
             std::string get_ip() const {return m_ip;}
 
+            bool is_v6() const { return m_ep.address().is_v6(); }
+
+            //ipv4 "ip:port", ipv6 "[ip]:port"
+            std::string to_string() const
+            {
+                return is_v6() ? "[" + m_ip + "]:" + std::to_string(m_port) : m_ip + ":" + std::to_string(m_port);
+            }
+
+            //sockaddr_in or sockaddr_in6 for libuv / socket calls, length returned
+            socklen_t get_sockaddr(struct sockaddr_storage &addr) const
+            {
+                memset(&addr, 0, sizeof(addr));
+                memcpy(&addr, m_ep.data(), m_ep.size());
+                return (socklen_t)m_ep.size();
+            }
+
         protected:
 
             ep_type m_ep;
@@ -12,6 +12,7 @@
 #include <io/io_handler_initializer.hpp>
 #include <io/io_streambuf.hpp>
 #include <io/channel.hpp>
+#include <common/metrics.hpp>
 
 
 #define MAX_RECV_BUF_LEN       (10 * 1024 * 1024)
@@ -33,6 +34,61 @@ namespace micro
     namespace core
     {
 
+        //counters of all tcp channels, open channels and queued messages derived as in - out
+        class tcp_channel_metrics
+        {
+        public:
+
+            static tcp_channel_metrics & instance()
+            {
+                static tcp_channel_metrics metrics;
+                return metrics;
+            }
+
+        protected:
+
+            tcp_channel_metrics()
+                : m_opened(METRICS_COUNTER("micro_tcp_channels_opened_total", "TCP channels initialized."))
+                , m_closed(METRICS_COUNTER("micro_tcp_channels_closed_total", "TCP channels closed."))
+                , m_bytes_in(METRICS_COUNTER("micro_tcp_channel_bytes_total", "Bytes transferred by tcp channels.", "direction=\"in\""))
+                , m_bytes_out(METRICS_COUNTER("micro_tcp_channel_bytes_total", "Bytes transferred by tcp channels.", "direction=\"out\""))
+                , m_reads(METRICS_COUNTER("micro_tcp_channel_reads_total", "Completed socket reads of tcp channels."))
+                , m_msgs_queued(METRICS_COUNTER("micro_tcp_channel_messages_queued_total", "Messages queued for write by tcp channels."))
+                , m_msgs_out(METRICS_COUNTER("micro_tcp_channel_messages_total", "Messages handled by tcp channels.", "direction=\"out\""))
+                , m_msgs_dropped(METRICS_COUNTER("micro_tcp_channel_messages_dropped_total", "Queued messages dropped on tcp channel close."))
+            {
+                metrics_counter *opened = &m_opened, *closed = &m_closed;
+                METRICS_GAUGE("micro_tcp_channels", "Open tcp channels.", "", [opened, closed]()
+                {
+                    return (double)opened->value() - (double)closed->value();
+                });
+
+                metrics_counter *queued = &m_msgs_queued, *out = &m_msgs_out, *dropped = &m_msgs_dropped;
+                METRICS_GAUGE("micro_tcp_channel_send_queue", "Messages waiting in tcp channel send queues.", "", [queued, out, dropped]()
+                {
+                    return (double)queued->value() - (double)out->value() - (double)dropped->value();
+                });
+            }
+
+        public:
+
+            metrics_counter &m_opened;
+
+            metrics_counter &m_closed;
+
+            metrics_counter &m_bytes_in;
+
+            metrics_counter &m_bytes_out;
+
+            metrics_counter &m_reads;
+
+            metrics_counter &m_msgs_queued;
+
+            metrics_counter &m_msgs_out;
+
+            metrics_counter &m_msgs_dropped;
+        };
+
         class tcp_channel : public channel, public std::enable_shared_from_this<tcp_channel>, public boost::noncopyable
         {
         public:
@@ -58,6 +114,8 @@ namespace micro
                 , m_ios(ios)
                 , m_socket(*ios)
                 , m_addr_info("addr info: UNKNOWN")
+                , m_metrics(tcp_channel_metrics::instance())
+                , m_metrics_open(false)
             {
                 set(LOGIN_STATUS, LOGIN_UNKNOWN);
             }
@@ -169,6 +227,12 @@ namespace micro
                 init_buf();
 
                 m_queue.clear();
+
+                if (!m_metrics_open)
+                {
+                    m_metrics_open = true;
+                    m_metrics.m_opened.add();
+                }
                 
                 m_inbound_chain.fire_channel_active();
 
@@ -204,8 +268,15 @@ namespace micro
                     LOG_ERROR << "tcp channel close error: " << error << m_str_channel_id;
                 }
 
+                m_metrics.m_msgs_dropped.add(m_queue.size());
                 m_queue.clear();
 
+                if (m_metrics_open)
+                {
+                    m_metrics_open = false;
+                    m_metrics.m_closed.add();
+                }
+
                 if (m_recv_buf != nullptr)
                 {
                     m_recv_buf->reset();
@@ -275,6 +346,8 @@ namespace micro
                             return ERR_FAILED;
                         }
 
+                        m_metrics.m_msgs_queued.add();
+
                         if (m_queue.size())
                         {
                             LOG_DEBUG << "tcp channel send msg: " << msg->get_name() << " " << m_str_channel_id;
@@ -396,6 +469,9 @@ namespace micro
                         return;
                     }
 
+                    m_metrics.m_reads.add();
+                    m_metrics.m_bytes_in.add(bytes_transferred);
+
                     LOG_DEBUG << m_str_channel_id << " recv buf: " << m_recv_buf->to_string() << addr_info();
 
                     //handler chain
@@ -450,6 +526,8 @@ namespace micro
                     return;
                 }
 
+                m_metrics.m_bytes_out.add(bytes_transferred);
+
                 try
                 {
                     if (0 == bytes_transferred)
@@ -475,6 +553,7 @@ namespace micro
                         msg = nullptr;
 
                         m_queue.pop_front();
+                        m_metrics.m_msgs_out.add();
 
                         //send next message
                         if (0 != m_queue.size())
@@ -566,6 +645,10 @@ namespace micro
 
             any_map m_vars;
 
+            tcp_channel_metrics &m_metrics;
+
+            bool m_metrics_open;                    //counted in open channels
+
         };
 
     }
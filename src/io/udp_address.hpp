@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <boost/asio.hpp>
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //raw ipv4 / ipv6 socket address, copied as is from recv and handed as is to send
+        //layout is sockaddr_storage so (sockaddr *)&addr and (sockaddr_in *)&addr casts keep working
+        class udp_address
+        {
+        public:
+
+            typedef boost::asio::ip::udp::endpoint endpoint_type;
+
+            udp_address() { memset(&m_storage, 0, sizeof(m_storage)); }
+
+            udp_address(const struct sockaddr *addr) { set(addr); }
+
+            udp_address(const endpoint_type &ep) { set(ep.data()); }
+
+            void set(const struct sockaddr *addr)
+            {
+                memset(&m_storage, 0, sizeof(m_storage));
+                if (addr)
+                {
+                    memcpy(&m_storage, addr, length(addr->sa_family));
+                }
+            }
+
+            struct sockaddr * data() { return (struct sockaddr *)&m_storage; }
+
+            const struct sockaddr * data() const { return (const struct sockaddr *)&m_storage; }
+
+            int family() const { return m_storage.ss_family; }
+
+            socklen_t length() const { return (socklen_t)length(m_storage.ss_family); }
+
+            uint16_t port() const
+            {
+                if (AF_INET6 == m_storage.ss_family)
+                {
+                    return ntohs(((const struct sockaddr_in6 *)&m_storage)->sin6_port);
+                }
+
+                return ntohs(((const struct sockaddr_in *)&m_storage)->sin_port);
+            }
+
+            //converted only when asked, no string round trip
+            endpoint_type to_endpoint() const
+            {
+                endpoint_type ep;
+                if (AF_INET != m_storage.ss_family && AF_INET6 != m_storage.ss_family)
+                {
+                    return ep;
+                }
+
+                memcpy(ep.data(), &m_storage, length());
+                ep.resize(length());
+
+                return ep;
+            }
+
+            bool is_v6() const { return AF_INET6 == m_storage.ss_family; }
+
+            //224.0.0.0/4, ff00::/8 or ipv4 group mapped into ipv6
+            bool is_multicast() const
+            {
+                if (AF_INET6 == m_storage.ss_family)
+                {
+                    const uint8_t *a = ((const struct sockaddr_in6 *)&m_storage)->sin6_addr.s6_addr;
+                    if (IN6_IS_ADDR_V4MAPPED((const struct in6_addr *)a))
+                    {
+                        return 0xe0 == (a[12] & 0xf0);
+                    }
+
+                    return 0xff == a[0];
+                }
+
+                return AF_INET == m_storage.ss_family && 0xe0 == (((const uint8_t *)&((const struct sockaddr_in *)&m_storage)->sin_addr)[0] & 0xf0);
+            }
+
+            //ipv4 address as ::ffff:a.b.c.d, so dual stack ipv6 socket can send to it
+            void map_v4()
+            {
+                if (AF_INET != m_storage.ss_family)
+                {
+                    return;
+                }
+
+                struct sockaddr_in v4 = *(const struct sockaddr_in *)&m_storage;
+                struct sockaddr_in6 *v6 = (struct sockaddr_in6 *)&m_storage;
+
+                memset(v6, 0, sizeof(*v6));
+                v6->sin6_family = AF_INET6;
+                v6->sin6_port = v4.sin_port;
+                v6->sin6_addr.s6_addr[10] = 0xff;
+                v6->sin6_addr.s6_addr[11] = 0xff;
+                memcpy(&v6->sin6_addr.s6_addr[12], &v4.sin_addr, sizeof(v4.sin_addr));
+            }
+
+            bool operator==(const udp_address &other) const
+            {
+                if (m_storage.ss_family != other.m_storage.ss_family)
+                {
+                    return false;
+                }
+
+                if (AF_INET6 == m_storage.ss_family)
+                {
+                    const struct sockaddr_in6 *a = (const struct sockaddr_in6 *)&m_storage;
+                    const struct sockaddr_in6 *b = (const struct sockaddr_in6 *)&other.m_storage;
+
+                    return a->sin6_port == b->sin6_port && a->sin6_scope_id == b->sin6_scope_id
+                        && 0 == memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr));
+                }
+
+                const struct sockaddr_in *a = (const struct sockaddr_in *)&m_storage;
+                const struct sockaddr_in *b = (const struct sockaddr_in *)&other.m_storage;
+
+                return a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr;
+            }
+
+            bool operator!=(const udp_address &other) const { return !(*this == other); }
+
+            //address and port folded for hash tables
+            uint64_t hash() const
+            {
+                if (AF_INET6 == m_storage.ss_family)
+                {
+                    const struct sockaddr_in6 *a = (const struct sockaddr_in6 *)&m_storage;
+
+                    uint64_t hi = 0, lo = 0;
+                    memcpy(&hi, (const char *)&a->sin6_addr, sizeof(hi));
+                    memcpy(&lo, (const char *)&a->sin6_addr + sizeof(hi), sizeof(lo));
+
+                    return std::hash<uint64_t>()(hi ^ (lo * 0x9e3779b97f4a7c15ULL)) ^ a->sin6_port;
+                }
+
+                const struct sockaddr_in *a = (const struct sockaddr_in *)&m_storage;
+                return ((uint64_t)a->sin_addr.s_addr << 16) | a->sin_port;
+            }
+
+            static size_t length(int family)
+            {
+                return AF_INET6 == family ? sizeof(struct sockaddr_in6) : (AF_INET == family ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_storage));
+            }
+
+        protected:
+
+            struct sockaddr_storage m_storage;
+        };
+
+        static_assert(sizeof(udp_address) == sizeof(struct sockaddr_storage), "udp_address must stay a plain sockaddr_storage");
+
+    }
+
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <io/udp_address.hpp>
+
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+//segmentation offload options, linux 4.18 / 5.0
+#ifndef SOL_UDP
+#define SOL_UDP                         17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT                     103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO                         104
+#endif
+#endif
+
+
+#define DEFAULT_UDP_BATCH_SIZE          1                   //1: one datagram per libuv callback
+#define MAX_UDP_BATCH_SIZE              256                 //datagrams per recvmmsg / sendmmsg
+#define UDP_MAX_RECV_ROUNDS             4                   //recvmmsg calls per readable event before yielding to loop
+
+#define UDP_MAX_GSO_SEGMENTS            64                  //kernel UDP_MAX_SEGMENTS
+#define UDP_MAX_GSO_LEN                 65507               //max udp payload of one super buffer
+#define UDP_GRO_BUF_LEN                 65535               //coalesced receive buffer per message
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //received datagram, data and address valid until batch read complete handlers return
+        class udp_datagram
+        {
+        public:
+
+            const char *m_data = nullptr;
+
+            size_t m_len = 0;
+
+            const udp_address *m_addr = nullptr;
+
+            const udp_address *m_dst = nullptr;             //destination ip, port 0; set when channel asks for pktinfo
+        };
+
+#ifdef __linux__
+
+        //receive slab and message headers set up once, every recvmmsg reuses them
+        //gro: socket has UDP_GRO on, coalesced messages are split back into datagrams
+        //pktinfo: socket has IP_PKTINFO / IPV6_RECVPKTINFO on, datagrams carry destination address, e.g. multicast group
+        class udp_recv_batch
+        {
+        public:
+
+            udp_recv_batch(size_t batch_size, size_t slot_len, bool gro = false, bool pktinfo = false)
+                : m_gro(gro)
+                , m_pktinfo(pktinfo)
+                , m_slot_len(gro ? UDP_GRO_BUF_LEN : slot_len)
+                , m_slab(batch_size * m_slot_len)
+                , m_hdrs(batch_size)
+                , m_iovs(batch_size)
+                , m_addrs(batch_size)
+                , m_dsts(pktinfo ? batch_size : 0)
+                , m_ctrl_len((gro ? CMSG_SPACE(sizeof(int)) : 0) + (pktinfo ? CMSG_SPACE(sizeof(struct in6_pktinfo)) : 0))
+                , m_ctrl(batch_size * m_ctrl_len)
+            {
+                m_datagrams.reserve(batch_size);
+
+                for (size_t i = 0; i < batch_size; i++)
+                {
+                    m_iovs[i].iov_base = &m_slab[i * m_slot_len];
+                    m_iovs[i].iov_len = m_slot_len;
+                }
+            }
+
+            size_t batch_size() const { return m_hdrs.size(); }
+
+            //return datagrams received, -errno on error, truncated datagrams dropped
+            int recv(int fd)
+            {
+                m_datagrams.clear();
+
+                //kernel overwrites name and flags fields on each call
+                for (size_t i = 0; i < m_hdrs.size(); i++)
+                {
+                    struct msghdr &hdr = m_hdrs[i].msg_hdr;
+                    memset(&hdr, 0, sizeof(hdr));
+
+                    hdr.msg_name = m_addrs[i].data();
+                    hdr.msg_namelen = sizeof(struct sockaddr_storage);
+                    hdr.msg_iov = &m_iovs[i];
+                    hdr.msg_iovlen = 1;
+
+                    if (m_ctrl_len > 0)
+                    {
+                        hdr.msg_control = &m_ctrl[i * m_ctrl_len];
+                        hdr.msg_controllen = m_ctrl_len;
+                    }
+                }
+
+                int count = recvmmsg(fd, m_hdrs.data(), (unsigned int)m_hdrs.size(), MSG_DONTWAIT, nullptr);
+                if (count < 0)
+                {
+                    return -errno;
+                }
+
+                for (int i = 0; i < count; i++)
+                {
+                    if (m_hdrs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                    {
+                        m_truncated++;
+                        continue;
+                    }
+
+                    size_t len = m_hdrs[i].msg_len;
+                    size_t segment_len = m_gro ? gro_segment_len(m_hdrs[i].msg_hdr, len) : len;
+
+                    if (m_pktinfo)
+                    {
+                        pktinfo_dst(m_hdrs[i].msg_hdr, m_dsts[i]);
+                    }
+
+                    //one datagram per segment, last one may be shorter
+                    size_t offset = 0;
+                    do
+                    {
+                        udp_datagram datagram;
+                        datagram.m_data = &m_slab[i * m_slot_len + offset];
+                        datagram.m_len = std::min(segment_len, len - offset);
+                        datagram.m_addr = &m_addrs[i];
+                        datagram.m_dst = m_pktinfo ? &m_dsts[i] : nullptr;
+
+                        m_datagrams.push_back(datagram);
+                        offset += datagram.m_len;
+                    } while (offset < len);
+                }
+
+                return count;
+            }
+
+            const std::vector<udp_datagram> & datagrams() const { return m_datagrams; }
+
+            //drop received datagrams in place, order of the rest kept
+            template<typename Pred>
+            size_t remove_if(Pred pred)
+            {
+                size_t count = m_datagrams.size();
+                m_datagrams.erase(std::remove_if(m_datagrams.begin(), m_datagrams.end(), pred), m_datagrams.end());
+
+                return count - m_datagrams.size();
+            }
+
+            uint64_t truncated() const { return m_truncated; }
+
+        protected:
+
+            //segment size reported by kernel, message not coalesced without cmsg
+            static size_t gro_segment_len(struct msghdr &hdr, size_t len)
+            {
+                for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+                {
+                    if (SOL_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type)
+                    {
+                        int segment_len = 0;
+                        memcpy(&segment_len, CMSG_DATA(cmsg), sizeof(segment_len));
+
+                        return segment_len > 0 ? (size_t)segment_len : len;
+                    }
+                }
+
+                return len;
+            }
+
+            //destination address from IP_PKTINFO / IPV6_PKTINFO cmsg, unset without one
+            static void pktinfo_dst(struct msghdr &hdr, udp_address &dst)
+            {
+                dst = udp_address();
+
+                for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+                {
+                    if (IPPROTO_IP == cmsg->cmsg_level && IP_PKTINFO == cmsg->cmsg_type)
+                    {
+                        struct in_pktinfo info;
+                        memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+
+                        struct sockaddr_in *addr = (struct sockaddr_in *)dst.data();
+                        addr->sin_family = AF_INET;
+                        addr->sin_addr = info.ipi_addr;
+                        return;
+                    }
+
+                    if (IPPROTO_IPV6 == cmsg->cmsg_level && IPV6_PKTINFO == cmsg->cmsg_type)
+                    {
+                        struct in6_pktinfo info;
+                        memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+
+                        struct sockaddr_in6 *addr = (struct sockaddr_in6 *)dst.data();
+                        addr->sin6_family = AF_INET6;
+                        addr->sin6_addr = info.ipi6_addr;
+                        return;
+                    }
+                }
+            }
+
+            bool m_gro;
+
+            bool m_pktinfo;
+
+            size_t m_slot_len;
+
+            std::vector<char> m_slab;
+
+            std::vector<struct mmsghdr> m_hdrs;
+
+            std::vector<struct iovec> m_iovs;
+
+            std::vector<udp_address> m_addrs;
+
+            std::vector<udp_address> m_dsts;
+
+            size_t m_ctrl_len;                              //control buffer per message
+
+            std::vector<char> m_ctrl;
+
+            std::vector<udp_datagram> m_datagrams;
+
+            uint64_t m_truncated = 0;
+        };
+
+#endif
+
+    }
+
+}
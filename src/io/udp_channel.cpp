@@ -3,6 +3,18 @@
 
 using namespace micro::core;
 
+
+void micro::core::free_send_data(send_data *snd_data)
+{
+    for (size_t i = 0; i < snd_data->m_uv_buf_count; i++)
+    {
+        free((snd_data->m_uv_buf + i)->base);
+    }
+
+    free(snd_data->m_uv_buf);
+    free(snd_data);
+}
+
 //callback function
 void on_read_callback(uv_udp_t* handle, ssize_t nread, const uv_buf_t* rcvbuf, const struct sockaddr* addr, unsigned flags)
 {
@@ -32,15 +44,7 @@ void on_write_callback(uv_udp_send_t* req, int status)
 
     ch->on_write(status);
     
-    //send buffer base
-    for (int i = 0; i < snd_data->m_uv_buf_count; i++)
-    {
-        free((snd_data->m_uv_buf + i)->base);
-    }
-
-    free(snd_data->m_uv_buf);
-    free(snd_data);
-    free(req);
+    ch->release_send_data(snd_data, req);
 
     END_TIME_COST
 }
@@ -50,6 +54,26 @@ void on_close_callback(uv_handle_t* handle)
     uv_is_closing(handle);
 }
 
+void on_poll_callback(uv_poll_t* handle, int status, int events)
+{
+#ifdef __linux__
+    udp_channel * ch = (udp_channel *)uv_handle_get_data((uv_handle_t*)handle);
+    ch->on_poll(status, events);
+#endif
+}
+
+void on_pace_timer_callback(uv_timer_t* handle)
+{
+    udp_channel * ch = (udp_channel *)uv_handle_get_data((uv_handle_t*)handle);
+    ch->on_pace_timer();
+}
+
+void on_tick_timer_callback(uv_timer_t* handle)
+{
+    udp_channel * ch = (udp_channel *)uv_handle_get_data((uv_handle_t*)handle);
+    ch->on_tick();
+}
+
 void on_async_callback(uv_async_t* handle)
 {
     udp_channel * ch = (udp_channel *)uv_handle_get_data((uv_handle_t*)handle);
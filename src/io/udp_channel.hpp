@@ -12,11 +12,14 @@
 #include <thread/uv_thread_pool.hpp>
 #include <random>
 #include <common/core_macro.h>
+#include <io/udp_batch.hpp>
+#include <io/udp_pacer.hpp>
+#include <io/udp_send_pool.hpp>
+#include <io/udp_multicast.hpp>
+#include <common/mpsc_queue.hpp>
 #include "channel_id_allocator.h"
 
 using std::cout; using std::endl;
-using std::default_random_engine;
-using std::uniform_int_distribution;
 
 
 __BEGIN_DECLS__
@@ -39,6 +42,9 @@ extern void on_read_callback(uv_udp_t* handle, ssize_t nread, const uv_buf_t* rc
 extern void on_write_callback(uv_udp_send_t* req, int status);
 extern void on_close_callback(uv_handle_t* handle);
 extern void on_async_callback(uv_async_t* handle);
+extern void on_poll_callback(uv_poll_t* handle, int status, int events);
+extern void on_pace_timer_callback(uv_timer_t* handle);
+extern void on_tick_timer_callback(uv_timer_t* handle);
 __END_DECLS__
 
 
@@ -48,19 +54,6 @@ namespace micro
     namespace core
     {
 
-        class send_data
-        {
-        public:
-
-            uv_buf_t * m_uv_buf = nullptr;
-
-            size_t m_uv_buf_count = 0;
-
-            sockaddr_in m_send_addr;
-
-            void * m_extra_info = nullptr;
-        };
-
         class batch_send_message
         {
         public:
@@ -87,13 +80,26 @@ namespace micro
 
 
             udp_channel(uv_thread_pool * pool, endpoint_type endpoint)
-                : m_pool(pool)
-                , m_sending_bufs_count(0)
-                , m_congested(false)
-                , m_urd(1, 3)
+                : m_closing(false)
+                , m_pool(pool)
+				, m_channel_id(get_new_channel_id())
                 , m_local_endpoint(endpoint)
+                , m_congested(false)
+                , m_paced_deferred_count(0)
+                , m_paced_head(nullptr)
+                , m_tick_interval(0)
+                , m_send_queue_depth(0)
+                , m_sending_bufs_count(0)
                 , m_recv_buf(std::make_shared<io_streambuf>())
-				, m_channel_id(get_new_channel_id())
+                , m_batch_size(DEFAULT_UDP_BATCH_SIZE)
+                , m_fd(-1)
+                , m_poll_writable(false)
+                , m_gso(false)
+                , m_gro(false)
+                , m_reuse_port(false)
+                , m_ipv6_only(false)
+                , m_group_filter(false)
+                , m_group_filtered(0)
             {
                 m_self = this;
                 udp_channel * ch = LIB_UV_GET_CHANNEL_POINTER(&m_socket);
@@ -106,9 +112,113 @@ namespace micro
 
             buf_ptr_type recv_buf() { return m_recv_buf; }
 
+            //batch mode: datagrams of last recvmmsg, valid in channel_batch_read_complete
+            const std::vector<udp_datagram> & recv_datagrams() const
+            {
+                static const std::vector<udp_datagram> empty;
+#ifdef __linux__
+                return m_recv_batch ? m_recv_batch->datagrams() : empty;
+#else
+                return empty;
+#endif
+            }
+
+            //batch mode: drop datagrams a handler consumed before passing batch on, order of the rest kept
+            template<typename Pred>
+            size_t remove_datagrams(Pred pred)
+            {
+#ifdef __linux__
+                return m_recv_batch ? m_recv_batch->remove_if(pred) : 0;
+#else
+                return 0;
+#endif
+            }
+
+            //set before init, more than 1: recvmmsg / sendmmsg up to size datagrams per call, linux only
+            void set_batch_size(uint32_t batch_size) { m_batch_size = std::min(std::max(batch_size, (uint32_t)1), (uint32_t)MAX_UDP_BATCH_SIZE); }
+
+            bool batch_mode() const { return m_fd >= 0; }
+
+            //set before init, batch mode only: same destination send data of equal length go out as one super buffer segmented by kernel
+            void set_gso(bool gso) { m_gso = gso; }
+
+            //set before init, batch mode only: kernel coalesces received datagrams, split again into recv_datagrams
+            void set_gro(bool gro) { m_gro = gro; }
+
+            bool gso() const { return m_gso; }
+
+            bool gro() const { return m_gro; }
+
+            //set before init: functor runs on loop thread every interval, timers of protocol handlers, one per channel
+            void set_tick(std::function<void()> functor, uint64_t interval_ms)
+            {
+                m_tick_functor = functor;
+                m_tick_interval = interval_ms;
+            }
+
+            //set before init, several channels bind same port and kernel hashes flows between them
+            void set_reuse_port(bool reuse_port) { m_reuse_port = reuse_port; }
+
+            //set before init, ipv6 endpoint only: refuse ipv4 peers; default dual stack, "::" serves both
+            void set_ipv6_only(bool ipv6_only) { m_ipv6_only = ipv6_only; }
+
+            //set before init, hops of multicast datagrams sent, kernel default 1
+            void set_multicast_ttl(int ttl) { m_multicast.set_ttl(ttl); }
+
+            //set before init, this host receives own multicast datagrams too, kernel default on
+            void set_multicast_loop(bool loop) { m_multicast.set_loop(loop); }
+
+            //set before init, outgoing interface of multicast datagrams: ipv4 interface address, ipv6 interface name
+            void set_multicast_interface(const std::string &interface) { m_multicast.set_interface(interface); }
+
+            //set before init, batch mode only: datagrams carry destination in m_dst, datagrams to groups not joined here dropped
+            void set_group_filter(bool group_filter) { m_group_filter = group_filter; }
+
+            //after init, any thread: receive datagrams sent to group on channel port; send to group like any address
+            //interface as in set_multicast_interface, empty: route decides
+            int32_t join_group(const std::string &group, const std::string &interface = "") { return set_membership(group, interface, true); }
+
+            int32_t leave_group(const std::string &group, const std::string &interface = "") { return set_membership(group, interface, false); }
+
+            //datagrams dropped by group filter
+            uint64_t get_group_filtered_count() const { return m_group_filtered; }
+
+            //set before init, bytes per second over whole channel, 0: off; burst 0: default
+            void set_pacing_rate(uint64_t bytes_per_sec, uint64_t burst = 0) { m_pacer.set_rate(bytes_per_sec, burst, uv_hrtime()); }
+
+            //set before init, bytes per second to each destination, queue stays fifo so a slow destination holds up later sends
+            void set_destination_pacing_rate(uint64_t bytes_per_sec, uint64_t burst = 0) { m_pacer.set_destination_rate(bytes_per_sec, burst); }
+
+            //send data queued in channel, not yet handed to socket
+            size_t get_send_queue_depth() const { return m_send_queue_depth; }
+
+            //pooled send data with one buffer of len bytes, fill buffer and address then push_and_notify_async
+            //released by channel after send, nullptr over 64KB
+            send_data * alloc_send_data(size_t len) { return m_send_pool.alloc(len); }
+
+            //pooled send data back to slab, encoder allocated send data and request freed
+            void release_send_data(send_data *snd_data, uv_udp_send_t *send_req = nullptr)
+            {
+                if (m_send_pool.release(snd_data))
+                {
+                    return;
+                }
+
+                free_send_data(snd_data);
+                free(send_req);
+            }
+
+            udp_send_pool & get_send_pool() { return m_send_pool; }
+
+            //send data held back waiting for pacing tokens
+            uint64_t get_paced_deferred_count() const { return m_paced_deferred_count; }
+
 			uint64_t channel_id() { return m_channel_id; }
 
-            boost::asio::ip::udp::endpoint get_remote_endpoint() { return m_remote_endpoint; }
+            //sender of datagram in channel_read_complete, endpoint built on demand
+            boost::asio::ip::udp::endpoint get_remote_endpoint() { return m_remote_addr.to_endpoint(); }
+
+            const udp_address & get_remote_address() const { return m_remote_addr; }
 
             boost::asio::ip::udp::endpoint get_local_endpoint() { return m_local_endpoint; }
 
@@ -147,18 +257,18 @@ namespace micro
                 return nullptr;
             }
 
+            //send bufs accessors below are loop thread only, other threads use push_and_notify_async
             void push_send_data(send_data *snd_data)
             {
-                //std::unique_lock<std::mutex> lock(m_mutex);
-
+                map_send_addr(snd_data);
                 m_send_bufs.push_back(snd_data);
+                m_send_queue_depth++;
             }
 
             void pop_send_data()
             {
-                //std::unique_lock<std::mutex> lock(m_mutex);
-
                 m_send_bufs.pop_front();
+                m_send_queue_depth--;
             }
 
             send_data *front_send_data()
@@ -175,24 +285,58 @@ namespace micro
 
             void pop_front_batch_message() { m_batch_msg_queue.pop_front(); }
 
-            //send bufs
-            send_buf_queue_type & get_send_bufs() { return m_send_bufs; }
-
-            size_t get_uv_udp_send_queue_size() { return uv_udp_get_send_queue_size(&m_socket); }
+            size_t get_uv_udp_send_queue_size() { return batch_mode() ? 0 : uv_udp_get_send_queue_size(&m_socket); }
 
-            size_t get_uv_udp_send_queue_count() { return uv_udp_get_send_queue_count(&m_socket); }
+            size_t get_uv_udp_send_queue_count() { return batch_mode() ? 0 : uv_udp_get_send_queue_count(&m_socket); }
 
             virtual int32_t init()
             {
-                //loop init and async callback
-                uv_udp_init(m_pool->get_loop(), &m_socket);
-
                 uv_async_init(m_pool->get_loop(), &m_async, on_async_callback);
                 uv_handle_set_data((uv_handle_t*)&m_async, (void*)this);
 
-                //bind addr
-                uv_ip4_addr(GET_IP(m_local_endpoint), m_local_endpoint.port(), &m_addr);
-                uv_udp_bind(&m_socket, (const struct sockaddr*) &m_addr, UV_UDP_REUSEADDR);
+                uv_timer_init(m_pool->get_loop(), &m_pace_timer);
+                uv_handle_set_data((uv_handle_t*)&m_pace_timer, (void*)this);
+
+                uv_timer_init(m_pool->get_loop(), &m_tick_timer);
+                uv_handle_set_data((uv_handle_t*)&m_tick_timer, (void*)this);
+
+                if (m_tick_functor)
+                {
+                    uv_timer_start(&m_tick_timer, on_tick_timer_callback, m_tick_interval, m_tick_interval);
+                }
+
+                //ipv4 or ipv6 by endpoint, copied without string round trip
+                m_addr = udp_address(m_local_endpoint);
+
+#ifdef __linux__
+                if (m_batch_size > 1)
+                {
+                    return init_batch();
+                }
+#endif
+
+                //loop init and bind addr
+                uv_udp_init(m_pool->get_loop(), &m_socket);
+
+                if (m_reuse_port && ERR_SUCCESS != open_reuse_port())
+                {
+                    return ERR_FAILED;
+                }
+
+                int r = uv_udp_bind(&m_socket, m_addr.data(), UV_UDP_REUSEADDR | (m_ipv6_only && m_addr.is_v6() ? UV_UDP_IPV6ONLY : 0));
+                if (0 != r)
+                {
+                    LOG_ERROR << "udp channel bind error: " << std::to_string(r) << " port: " << m_local_endpoint.port();
+                    return ERR_FAILED;
+                }
+
+                if (m_group_filter)
+                {
+                    LOG_ERROR << "udp channel group filter needs batch mode, kernel filter only";
+                    m_group_filter = false;
+                }
+
+                m_multicast.apply(socket_fd(), m_addr.family());
 
                 //buffer size
                 int send_buffer_size = 10 * 1024 * 1024;
@@ -222,8 +366,34 @@ namespace micro
                 return this->read(); 
             }
 
+            //any thread: handles closed on loop thread, async handle included so loop can end; no sends after
+            void close_async()
+            {
+                m_closing = true;
+                uv_async_send(&m_async);
+            }
+
             virtual int32_t close()
             {
+                uv_timer_stop(&m_pace_timer);
+                uv_close((uv_handle_t*)&m_pace_timer, on_close_callback);
+
+                uv_timer_stop(&m_tick_timer);
+                uv_close((uv_handle_t*)&m_tick_timer, on_close_callback);
+
+#ifdef __linux__
+                if (batch_mode())
+                {
+                    uv_poll_stop(&m_poll);
+                    uv_close((uv_handle_t*)&m_poll, on_close_callback);
+
+                    ::close(m_fd);
+                    m_fd = -1;
+
+                    return ERR_SUCCESS;
+                }
+#endif
+
                 //close
                 uv_close((uv_handle_t*)&m_socket, on_close_callback);
 
@@ -252,13 +422,12 @@ namespace micro
                 return ERR_SUCCESS;
             }
 
+            //any thread, lock free; only push into empty queue wakes loop, later pushes ride on same async
             void push_and_notify_async(send_data *snd_data)
             {
-                std::unique_lock<std::mutex> lock(m_bufs_mutex);
+                m_send_queue_depth++;
 
-                m_send_bufs.push_back(snd_data);
-
-                if ((m_send_bufs.size()) <= 1 && (0 == m_sending_bufs_count))                                             //first time needs notify start to do write
+                if (m_send_inbox.push(snd_data))
                 {
                     //async notify
                     int r = uv_async_send(&m_async);
@@ -293,10 +462,15 @@ namespace micro
 
             void on_async()
             {
-                try
+                if (m_closing)
                 {
-                    std::unique_lock<std::mutex> lock(m_bufs_mutex);
+                    close();
+                    uv_close((uv_handle_t*)&m_async, on_close_callback);
+                    return;
+                }
 
+                try
+                {
                     do_write();
                 }
                 catch (const std::exception & e)
@@ -317,8 +491,8 @@ namespace micro
             {
                 if (status)
                 {
-                    //libuv congested error
-                    if (-4060 == status)
+                    //libuv congested error, -4060 on windows
+                    if (UV_ENOBUFS == status)
                     {
                         m_congested = true;
                     }
@@ -328,19 +502,7 @@ namespace micro
                     //handler chain
                     m_outbound_chain.fire_exception_caught(std::runtime_error("udp channel on write error"));
                 }
-                else
-                {
-                    //continous status zero, clear congest flag
-                    static int CONGEST_CLEAR_COUNT = 0;
-                    if (CONGEST_CLEAR_COUNT++ > 10)
-                    {
-                        m_congested = false;
-                        CONGEST_CLEAR_COUNT = 0;
-                    }
-                }
 
-                std::unique_lock<std::mutex> lock(m_bufs_mutex);
-                
                 //pop_send_data();                        //pop
 
                 m_sending_bufs_count--;
@@ -357,6 +519,12 @@ namespace micro
 
             virtual int32_t read()
             {
+                //batch mode reads on poll readable
+                if (batch_mode())
+                {
+                    return ERR_SUCCESS;
+                }
+
                 //int sock_buf_len = (int)(m_recv_buf->get_valid_read_len());
                 //uv_recv_buffer_size((uv_handle_t*)&m_socket, &sock_buf_len);
 
@@ -393,13 +561,10 @@ namespace micro
 
                     //LOG_DEBUG << "udp recv buf: " << m_recv_buf->to_string();
 
-                    struct sockaddr_in *sock = (struct sockaddr_in*)addr;
-                    char *saddr = inet_ntoa(sock->sin_addr);
-                    int port = ntohs(sock->sin_port);
-                    endpoint_type remote_endpoint(boost::asio::ip::address::from_string(saddr), port);
-                    m_remote_endpoint = remote_endpoint;
+                    //raw address kept, no per datagram string conversion
+                    m_remote_addr.set(addr);
 
-                    //LOG_DEBUG << "remote ip: " << m_remote_endpoint.address().to_string() << " port: " << std::to_string(m_remote_endpoint.port());
+                    //LOG_DEBUG << "remote ip: " << get_remote_endpoint().address().to_string() << " port: " << std::to_string(get_remote_endpoint().port());
 
                     //handler chain
                     m_inbound_chain.fire_channel_read_complete();
@@ -420,8 +585,573 @@ namespace micro
                 }
             }
 
+            void on_pace_timer()
+            {
+                do_write();
+            }
+
+            void on_tick()
+            {
+                try
+                {
+                    m_tick_functor();
+                }
+                catch (const std::exception & e)
+                {
+                    LOG_ERROR << "udp channel on tick std exception: " << e.what();
+                    m_inbound_chain.fire_exception_caught(e);
+                }
+                catch (...)
+                {
+                    LOG_ERROR << "udp channel on tick exception";
+                    m_inbound_chain.fire_exception_caught(std::runtime_error("udp channel on tick exception"));
+                }
+            }
+
+#ifdef __linux__
+            void on_poll(int status, int events)
+            {
+                if (status < 0)
+                {
+                    LOG_ERROR << "udp channel poll error: " << status;
+                    m_inbound_chain.fire_exception_caught(std::runtime_error("udp channel poll error"));
+                    return;
+                }
+
+                if (events & UV_READABLE)
+                {
+                    read_batch();
+                }
+
+                if (events & UV_WRITABLE)
+                {
+                    do_write();
+                }
+            }
+#endif
+
         protected:
 
+            //batch socket or socket of udp handle, -1 before init
+            int socket_fd()
+            {
+                if (m_fd >= 0)
+                {
+                    return m_fd;
+                }
+
+                //local address set by init
+                if (0 == m_addr.family())
+                {
+                    return -1;
+                }
+
+#ifdef __linux__
+                //batch mode has no udp handle
+                if (m_batch_size > 1)
+                {
+                    return -1;
+                }
+#endif
+
+                //int on unix, HANDLE holding the socket on windows
+                uv_os_fd_t fd;
+                if (0 != uv_fileno((const uv_handle_t *)&m_socket, &fd))
+                {
+                    return -1;
+                }
+
+                return (int)(intptr_t)fd;
+            }
+
+            int32_t set_membership(const std::string &group, const std::string &interface, bool join)
+            {
+                int fd = socket_fd();
+                if (fd < 0)
+                {
+                    LOG_ERROR << "udp channel " << (join ? "join" : "leave") << " group before init: " << group;
+                    return ERR_FAILED;
+                }
+
+                return m_multicast.set_membership(fd, m_addr.family(), group, interface, join);
+            }
+
+            //libuv 1.34 only sets SO_REUSEADDR, open socket with SO_REUSEPORT and hand it to udp handle
+            int32_t open_reuse_port()
+            {
+#ifdef SO_REUSEPORT
+                int fd = ::socket(m_addr.family(), SOCK_DGRAM, 0);
+                if (fd < 0)
+                {
+                    LOG_ERROR << "udp channel create socket error: " << errno;
+                    return ERR_FAILED;
+                }
+
+                int on = 1;
+                if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+                {
+                    LOG_ERROR << "udp channel set reuse port error: " << errno;
+
+                    ::close(fd);
+                    return ERR_FAILED;
+                }
+
+                int r = uv_udp_open(&m_socket, fd);
+                if (0 != r)
+                {
+                    LOG_ERROR << "udp channel open socket error: " << std::to_string(r);
+
+                    ::close(fd);
+                    return ERR_FAILED;
+                }
+
+                return ERR_SUCCESS;
+#else
+                LOG_ERROR << "udp channel reuse port not supported";
+                return ERR_FAILED;
+#endif
+            }
+
+#ifdef __linux__
+            //own non-blocking socket polled by loop, libuv 1.34 udp handle has no recvmmsg
+            int32_t init_batch()
+            {
+                m_fd = socket(m_addr.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+                if (m_fd < 0)
+                {
+                    LOG_ERROR << "udp channel create socket error: " << errno;
+                    return ERR_FAILED;
+                }
+
+                int on = 1;
+                setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+                if (m_reuse_port && 0 != setsockopt(m_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+                {
+                    LOG_ERROR << "udp channel set reuse port error: " << errno;
+
+                    ::close(m_fd);
+                    m_fd = -1;
+                    return ERR_FAILED;
+                }
+
+                if (m_addr.is_v6())
+                {
+                    int v6_only = m_ipv6_only ? 1 : 0;
+                    setsockopt(m_fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only));
+                }
+
+                if (0 != bind(m_fd, m_addr.data(), m_addr.length()))
+                {
+                    LOG_ERROR << "udp channel bind error: " << errno << " port: " << m_local_endpoint.port();
+
+                    ::close(m_fd);
+                    m_fd = -1;
+                    return ERR_FAILED;
+                }
+
+                int buffer_size = 10 * 1024 * 1024;
+                if (0 != setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)))
+                {
+                    LOG_ERROR << "udp channel set send buffer size error: " << errno;
+                }
+
+                if (0 != setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)))
+                {
+                    LOG_ERROR << "udp channel set recv buffer size error: " << errno;
+                }
+
+                init_offload();
+
+                m_multicast.apply(m_fd, m_addr.family());
+
+                if (m_group_filter)
+                {
+                    int on = 1;
+                    if (0 != (m_addr.is_v6() ? setsockopt(m_fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) : setsockopt(m_fd, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on))))
+                    {
+                        LOG_ERROR << "udp channel set pktinfo error: " << errno;
+                        m_group_filter = false;
+                    }
+                }
+
+                m_recv_batch.reset(new udp_recv_batch(m_batch_size, MAX_UDP_RECV_BUF_LEN, m_gro, m_group_filter));
+                m_send_hdrs.resize(m_batch_size);
+                m_send_counts.resize(m_batch_size);
+                m_send_iov_offsets.resize(m_batch_size);
+                m_send_ctrl.resize(m_batch_size * CMSG_SPACE(sizeof(uint16_t)));
+
+                uv_poll_init_socket(m_pool->get_loop(), &m_poll, m_fd);
+                uv_handle_set_data((uv_handle_t*)&m_poll, (void*)this);
+
+                return ERR_SUCCESS == update_poll(false) ? this->read() : ERR_FAILED;
+            }
+
+            //offload off when kernel lacks it
+            void init_offload()
+            {
+                if (m_gso)
+                {
+                    int segment_len = 0;
+                    socklen_t len = sizeof(segment_len);
+
+                    if (0 != getsockopt(m_fd, SOL_UDP, UDP_SEGMENT, &segment_len, &len))
+                    {
+                        LOG_ERROR << "udp channel gso not supported: " << errno;
+                        m_gso = false;
+                    }
+                }
+
+                if (m_gro)
+                {
+                    int on = 1;
+                    if (0 != setsockopt(m_fd, SOL_UDP, UDP_GRO, &on, sizeof(on)))
+                    {
+                        LOG_ERROR << "udp channel gro not supported: " << errno;
+                        m_gro = false;
+                    }
+                }
+            }
+
+            int32_t update_poll(bool writable)
+            {
+                m_poll_writable = writable;
+
+                int r = uv_poll_start(&m_poll, UV_READABLE | (writable ? UV_WRITABLE : 0), on_poll_callback);
+                if (0 != r)
+                {
+                    LOG_ERROR << "udp channel poll start error: " << std::to_string(r);
+                    return ERR_FAILED;
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            //drain socket in rounds of recvmmsg, one batch event per round
+            void read_batch()
+            {
+                for (uint32_t round = 0; round < UDP_MAX_RECV_ROUNDS; round++)
+                {
+                    int count = m_recv_batch->recv(m_fd);
+                    if (count < 0)
+                    {
+                        if (-EAGAIN != count && -EWOULDBLOCK != count && -EINTR != count)
+                        {
+                            LOG_ERROR << "udp channel recvmmsg error: " << -count;
+                            m_inbound_chain.fire_exception_caught(std::runtime_error("udp channel on read error"));
+                        }
+
+                        return;
+                    }
+
+                    if (m_group_filter)
+                    {
+                        filter_groups();
+                    }
+
+                    if (!m_recv_batch->datagrams().empty())
+                    {
+                        try
+                        {
+                            //handler chain
+                            m_inbound_chain.fire_channel_batch_read_complete();
+                        }
+                        catch (const std::exception & e)
+                        {
+                            LOG_ERROR << "udp channel on batch read std exception: " << e.what();
+                            m_inbound_chain.fire_exception_caught(e);
+                        }
+                        catch (...)
+                        {
+                            LOG_ERROR << "udp channel on batch read exception";
+                            m_inbound_chain.fire_exception_caught(std::runtime_error("udp channel on batch read exception"));
+                        }
+                    }
+
+                    //socket drained
+                    if ((size_t)count < m_recv_batch->batch_size())
+                    {
+                        return;
+                    }
+                }
+            }
+
+            //multicast datagrams to groups this channel did not join, kernel may still deliver them to wildcard bound socket
+            void filter_groups()
+            {
+                std::unique_lock<std::mutex> lock(m_multicast.groups_mutex());
+
+                m_group_filtered += m_recv_batch->remove_if([this](const udp_datagram &datagram)
+                {
+                    return nullptr != datagram.m_dst && datagram.m_dst->is_multicast() && !m_multicast.joined(*datagram.m_dst);
+                });
+            }
+
+            //flush queued send data with sendmmsg, wait for writable when socket buffer full
+            void do_write_batch()
+            {
+                bool wait_writable = false;
+
+                while (!m_send_bufs.empty())
+                {
+                    size_t count = build_send_batch();
+
+                    //queue head waits for pacing timer
+                    if (0 == count)
+                    {
+                        break;
+                    }
+
+                    int sent = sendmmsg(m_fd, m_send_hdrs.data(), (unsigned int)count, 0);
+                    if (sent < 0)
+                    {
+                        int err = errno;
+
+                        //pacer tokens were taken when batch was built, nothing went out
+                        unpace_batch(0, count);
+
+                        if (EAGAIN == err || EWOULDBLOCK == err)
+                        {
+                            wait_writable = true;
+                            break;
+                        }
+
+                        //no writable event follows, retry on timer
+                        if (ENOBUFS == err)
+                        {
+                            start_pace_timer(UDP_CONGEST_BACKOFF_MS);
+                            break;
+                        }
+
+                        if (EINTR == err)
+                        {
+                            continue;
+                        }
+
+                        //device without checksum offload rejects gso, send datagrams one by one
+                        if (m_gso && EIO == err)
+                        {
+                            LOG_ERROR << "udp channel gso rejected by device, gso off";
+                            m_gso = false;
+                            continue;
+                        }
+
+                        //first message rejected, drop its send data and go on with the rest
+                        LOG_ERROR << "udp channel sendmmsg error: " << err;
+
+                        pop_sent_data(m_send_counts[0]);
+
+                        m_outbound_chain.fire_exception_caught(std::runtime_error("udp channel on write error"));
+                        continue;
+                    }
+
+                    for (int i = 0; i < sent; i++)
+                    {
+                        pop_sent_data(m_send_counts[i]);
+                    }
+
+                    //socket buffer full
+                    if ((size_t)sent < count)
+                    {
+                        unpace_batch(sent, count);
+
+                        wait_writable = true;
+                        break;
+                    }
+                }
+
+                if (wait_writable != m_poll_writable)
+                {
+                    update_poll(wait_writable);
+                }
+            }
+
+            //fill send headers from queue head, with gso one header carries a run of send data
+            //to same destination, all as long as first one except a shorter last one
+            size_t build_send_batch()
+            {
+                m_send_iovs.clear();
+
+                size_t count = 0;
+                bool paced = false;
+                auto it = m_send_bufs.begin();
+
+                while (!paced && it != m_send_bufs.end() && count < m_send_hdrs.size())
+                {
+                    if (!pace(*it))
+                    {
+                        break;
+                    }
+
+                    send_data *first = *it;
+                    size_t segment_len = send_data_len(first);
+                    size_t total_len = 0;
+                    size_t segments = 0;
+
+                    m_send_iov_offsets[count] = m_send_iovs.size();
+
+                    while (true)
+                    {
+                        send_data *snd_data = *it;
+                        assert(snd_data->m_uv_buf_count > 0 && snd_data->m_uv_buf != nullptr);
+
+                        for (size_t i = 0; i < snd_data->m_uv_buf_count; i++)
+                        {
+                            struct iovec iov;
+                            iov.iov_base = snd_data->m_uv_buf[i].base;
+                            iov.iov_len = snd_data->m_uv_buf[i].len;
+
+                            m_send_iovs.push_back(iov);
+                        }
+
+                        size_t len = send_data_len(snd_data);
+                        total_len += len;
+                        segments++;
+                        ++it;
+
+                        //shorter segment ends super buffer
+                        if (!m_gso || 0 == segment_len || len < segment_len || it == m_send_bufs.end() || segments >= UDP_MAX_GSO_SEGMENTS)
+                        {
+                            break;
+                        }
+
+                        size_t next_len = send_data_len(*it);
+                        if (next_len > segment_len || total_len + next_len > UDP_MAX_GSO_LEN || !same_dst(first, *it))
+                        {
+                            break;
+                        }
+
+                        if (!pace(*it))
+                        {
+                            paced = true;
+                            break;
+                        }
+                    }
+
+                    struct msghdr &hdr = m_send_hdrs[count].msg_hdr;
+                    memset(&hdr, 0, sizeof(hdr));
+
+                    hdr.msg_name = first->m_send_addr.data();
+                    hdr.msg_namelen = first->m_send_addr.length();
+                    hdr.msg_iovlen = m_send_iovs.size() - m_send_iov_offsets[count];
+
+                    if (segments > 1)
+                    {
+                        hdr.msg_control = &m_send_ctrl[count * CMSG_SPACE(sizeof(uint16_t))];
+                        hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+                        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                        cmsg->cmsg_level = SOL_UDP;
+                        cmsg->cmsg_type = UDP_SEGMENT;
+                        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+                        uint16_t gso_size = (uint16_t)segment_len;
+                        memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+                    }
+
+                    m_send_counts[count++] = segments;
+                }
+
+                //iov vector may grow while filling
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_send_hdrs[i].msg_hdr.msg_iov = &m_send_iovs[m_send_iov_offsets[i]];
+                }
+
+                return count;
+            }
+
+            //give back pacer tokens of headers first..count, their send data still at queue head
+            void unpace_batch(size_t first, size_t count)
+            {
+                if (!m_pacer.enabled())
+                {
+                    return;
+                }
+
+                size_t datagrams = 0;
+                for (size_t i = first; i < count; i++)
+                {
+                    datagrams += m_send_counts[i];
+                }
+
+                auto it = m_send_bufs.begin();
+                for (size_t i = 0; i < datagrams && it != m_send_bufs.end(); i++, ++it)
+                {
+                    unpace(*it);
+                }
+            }
+
+            void pop_sent_data(size_t count)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    release_send_data(m_send_bufs.front());
+                    m_send_bufs.pop_front();
+                }
+
+                m_send_queue_depth -= count;
+            }
+
+            static bool same_dst(const send_data *a, const send_data *b)
+            {
+                return a->m_send_addr == b->m_send_addr;
+            }
+#endif
+
+            static size_t send_data_len(const send_data *snd_data)
+            {
+                size_t len = 0;
+                for (size_t i = 0; i < snd_data->m_uv_buf_count; i++)
+                {
+                    len += snd_data->m_uv_buf[i].len;
+                }
+
+                return len;
+            }
+
+            //true: send now, false: tokens short and pacing timer started
+            bool pace(const send_data *snd_data)
+            {
+                if (!m_pacer.enabled())
+                {
+                    return true;
+                }
+
+                uint64_t wait_ns = 0;
+                if (m_pacer.admit(snd_data->m_send_addr.hash(), send_data_len(snd_data), uv_hrtime(), wait_ns))
+                {
+                    return true;
+                }
+
+                //count each send data once however often it retries
+                if (snd_data != m_paced_head)
+                {
+                    m_paced_head = snd_data;
+                    m_paced_deferred_count++;
+                }
+
+                //timer granularity is 1 ms
+                start_pace_timer((wait_ns + 999999) / 1000000);
+                return false;
+            }
+
+            void unpace(const send_data *snd_data)
+            {
+                if (m_pacer.enabled())
+                {
+                    m_pacer.refund(snd_data->m_send_addr.hash(), send_data_len(snd_data));
+                }
+            }
+
+            void start_pace_timer(uint64_t timeout_ms)
+            {
+                if (!uv_is_active((uv_handle_t*)&m_pace_timer))
+                {
+                    uv_timer_start(&m_pace_timer, on_pace_timer_callback, timeout_ms, 0);
+                }
+            }
+
             /*void do_write()
             {
 
@@ -537,42 +1267,94 @@ namespace micro
                 }
             }*/
 
+            //loop thread: take producer queue over to send bufs
+            //dual stack socket takes ipv4 destinations only as mapped ipv6, ipv4 socket pays one compare
+            void map_send_addr(send_data *snd_data)
+            {
+                if (m_addr.is_v6() && AF_INET == snd_data->m_send_addr.family())
+                {
+                    snd_data->m_send_addr.map_v4();
+                }
+            }
+
+            void drain_send_inbox()
+            {
+                send_data *snd_data = m_send_inbox.pop_all();
+                while (snd_data)
+                {
+                    send_data *next = snd_data->m_next;
+
+                    map_send_addr(snd_data);
+                    m_send_bufs.push_back(snd_data);
+                    snd_data = next;
+                }
+            }
+
             void do_write()
             {
 
                 try
                 {
+                    drain_send_inbox();
+
+#ifdef __linux__
+                    if (batch_mode())
+                    {
+                        do_write_batch();
+                        return;
+                    }
+#endif
+
+                    //congested, pause queue on timer instead of blocking loop
+                    if (true == m_congested)
+                    {
+                        m_congested = false;
+
+                        BEGIN_COUNT_TO_DO(CONGEST, 1000)
+                            LOG_ERROR << "udp channel congested and pause " << std::to_string(UDP_CONGEST_BACKOFF_MS) << " ms";
+                        END_COUNT_TO_DO
+
+                        start_pace_timer(UDP_CONGEST_BACKOFF_MS);
+                        return;
+                    }
+
                     while (!m_send_bufs.empty() && m_sending_bufs_count < POP_SEND_BUF_ONE_TIME)
                     {
                         send_data *snd_data = m_send_bufs.front();
                         assert(nullptr != snd_data);
 
-                        //register data
-                        uv_udp_send_t *send_req = (uv_udp_send_t *)malloc(sizeof(uv_udp_send_t));
-                        uv_handle_set_data((uv_handle_t*)send_req, (void*)snd_data);
-
                         assert(snd_data->m_uv_buf_count > 0 && snd_data->m_uv_buf != nullptr);
 
-                        //congested
-                        if (true == m_congested)
+                        if (!pace(snd_data))
                         {
-                            uint32_t sleep_time = m_urd(m_random_engine);
-
-                            BEGIN_COUNT_TO_DO(CONGEST, 1000)
-                                LOG_ERROR << "udp channel congested and sleep " << std::to_string(sleep_time) << " us";
-                            END_COUNT_TO_DO
+                            break;
+                        }
 
-                            std::this_thread::sleep_for(std::chrono::microseconds(sleep_time));
+                        //register data, pooled send data carries its own request
+                        uv_udp_send_t *send_req = m_send_pool.request(snd_data);
+                        if (nullptr == send_req)
+                        {
+                            send_req = (uv_udp_send_t *)malloc(sizeof(uv_udp_send_t));
                         }
 
+                        uv_handle_set_data((uv_handle_t*)send_req, (void*)snd_data);
+
                         //uv send
-                        int r = uv_udp_send(send_req, &m_socket, snd_data->m_uv_buf, (unsigned int)snd_data->m_uv_buf_count, (const struct sockaddr*) &snd_data->m_send_addr, on_write_callback);
+                        int r = uv_udp_send(send_req, &m_socket, snd_data->m_uv_buf, (unsigned int)snd_data->m_uv_buf_count, snd_data->m_send_addr.data(), on_write_callback);
+
+                        m_send_bufs.pop_front();
+                        m_send_queue_depth--;
+
+                        //failed send gets no write callback: free it here, not counted in flight
                         if (r)
                         {
                             LOG_ERROR << "uv_udp_send error: " << std::to_string(r);
+
+                            unpace(snd_data);
+                            release_send_data(snd_data, send_req);
+                            continue;
                         }
 
-                        m_send_bufs.pop_front();
                         m_sending_bufs_count++;
                     }
                 }
@@ -598,7 +1380,9 @@ namespace micro
 
             uv_async_t m_async;
 
-            struct sockaddr_in m_addr;
+            std::atomic<bool> m_closing;                    //close_async called, loop thread closes handles
+
+            udp_address m_addr;                 //local address, family of socket
 
             uv_thread_pool * m_pool;
 
@@ -612,21 +1396,36 @@ namespace micro
 
             volatile bool m_congested;
 
-            default_random_engine m_random_engine;
+            udp_pacer m_pacer;
+
+            uv_timer_t m_pace_timer;
+
+            std::atomic<uint64_t> m_paced_deferred_count;
+
+            const send_data * m_paced_head;                 //last send data counted as deferred
+
+            udp_send_pool m_send_pool;
 
-            uniform_int_distribution<unsigned> m_urd;
+            uv_timer_t m_tick_timer;
 
-            send_buf_queue_type m_send_bufs;
+            std::function<void()> m_tick_functor;
+
+            uint64_t m_tick_interval;
+
+            send_buf_queue_type m_send_bufs;                //loop thread only
+
+            mpsc_queue<send_data> m_send_inbox;             //producers --> loop
+
+            std::atomic<size_t> m_send_queue_depth;
 
             uint32_t m_sending_bufs_count;
 
             mutex_type m_queue_mutex;
 
-            mutex_type m_bufs_mutex;
 
             buf_ptr_type m_recv_buf;
 
-            endpoint_type m_remote_endpoint;
+            udp_address m_remote_addr;
 
             chain_type m_inbound_chain;
 
@@ -636,6 +1435,42 @@ namespace micro
 
             initializer_ptr_type m_outbound_initializer;
 
+            uint32_t m_batch_size;
+
+            int m_fd;                                       //batch mode socket, -1 in libuv udp mode
+
+            uv_poll_t m_poll;
+
+            bool m_poll_writable;
+
+            bool m_gso;
+
+            bool m_gro;
+
+            bool m_reuse_port;
+
+            bool m_ipv6_only;
+
+            udp_multicast m_multicast;
+
+            bool m_group_filter;
+
+            std::atomic<uint64_t> m_group_filtered;         //loop thread adds, any thread reads
+
+#ifdef __linux__
+            std::unique_ptr<udp_recv_batch> m_recv_batch;
+
+            std::vector<struct mmsghdr> m_send_hdrs;
+
+            std::vector<struct iovec> m_send_iovs;
+
+            std::vector<size_t> m_send_iov_offsets;
+
+            std::vector<size_t> m_send_counts;                  //send data per header
+
+            std::vector<char> m_send_ctrl;                      //UDP_SEGMENT cmsg per header
+#endif
+
         };
 
     }
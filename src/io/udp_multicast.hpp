@@ -0,0 +1,209 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <common/error.hpp>
+#include <logger/logger.hpp>
+#include <io/udp_address.hpp>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#endif
+
+//receive only groups joined on this socket, not every group joined on host; linux 2.6.31 / 4.20
+#if defined(__linux__) && !defined(IP_MULTICAST_ALL)
+#define IP_MULTICAST_ALL                49
+#endif
+
+#if defined(__linux__) && !defined(IPV6_MULTICAST_ALL)
+#define IPV6_MULTICAST_ALL              29
+#endif
+
+#define UDP_MULTICAST_DEFAULT           -1                  //ttl / loop left to kernel: ttl 1, loop on
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //multicast socket options of one udp socket, ipv4 or ipv6; ipv4 groups also work on dual stack ipv6 socket
+        //interface: ipv4 local interface address, ipv6 interface name; empty: route decides
+        class udp_multicast
+        {
+        public:
+
+            void set_ttl(int ttl) { m_ttl = ttl; }
+
+            void set_loop(bool loop) { m_loop = loop ? 1 : 0; }
+
+            void set_interface(const std::string &interface) { m_interface = interface; }
+
+            //send side options, after bind; family is socket family
+            int32_t apply(int fd, int family)
+            {
+                bool v6 = AF_INET6 == family;
+                int32_t ret = ERR_SUCCESS;
+
+                if (UDP_MULTICAST_DEFAULT != m_ttl)
+                {
+                    //dual stack socket sends ipv4 groups with ip level ttl
+                    if (v6 && 0 != setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &m_ttl, sizeof(m_ttl)))
+                    {
+                        ret = log_error("set multicast hops", errno);
+                    }
+
+                    if (0 != setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &m_ttl, sizeof(m_ttl)) && !v6)
+                    {
+                        ret = log_error("set multicast ttl", errno);
+                    }
+                }
+
+                if (UDP_MULTICAST_DEFAULT != m_loop)
+                {
+                    unsigned int loop = (unsigned int)m_loop;
+                    if (v6 && 0 != setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop)))
+                    {
+                        ret = log_error("set multicast loop", errno);
+                    }
+
+                    if (0 != setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &m_loop, sizeof(m_loop)) && !v6)
+                    {
+                        ret = log_error("set multicast loop", errno);
+                    }
+                }
+
+                if (!m_interface.empty())
+                {
+                    int r = 0;
+                    if (v6)
+                    {
+                        unsigned int index = if_nametoindex(m_interface.c_str());
+                        r = setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &index, sizeof(index));
+                    }
+                    else
+                    {
+                        struct in_addr addr;
+                        r = 1 == inet_pton(AF_INET, m_interface.c_str(), &addr) ? setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof(addr)) : -1;
+                    }
+
+                    if (0 != r)
+                    {
+                        ret = log_error("set multicast interface " + m_interface, errno);
+                    }
+                }
+
+                return ret;
+            }
+
+            //join or leave group on fd, joined groups kept as addresses with port 0 for receive filter
+            int32_t set_membership(int fd, int family, const std::string &group, const std::string &interface, bool join)
+            {
+                boost::system::error_code ec;
+                boost::asio::ip::address ip = boost::asio::ip::address::from_string(group, ec);
+                if (ec || !ip.is_multicast())
+                {
+                    LOG_ERROR << "udp channel invalid multicast group: " << group;
+                    return ERR_FAILED;
+                }
+
+#ifdef __linux__
+                //kernel default hands socket every group joined by any socket on its port
+                int off = 0;
+                setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off));
+                if (AF_INET6 == family)
+                {
+                    setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &off, sizeof(off));
+                }
+#endif
+
+                int r = 0;
+                if (ip.is_v4())
+                {
+                    struct ip_mreq mreq;
+                    memset(&mreq, 0, sizeof(mreq));
+                    mreq.imr_multiaddr.s_addr = htonl(ip.to_v4().to_ulong());
+                    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+                    if (!interface.empty() && 1 != inet_pton(AF_INET, interface.c_str(), &mreq.imr_interface))
+                    {
+                        LOG_ERROR << "udp channel invalid multicast interface: " << interface;
+                        return ERR_FAILED;
+                    }
+
+                    r = setsockopt(fd, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+                }
+                else
+                {
+                    struct ipv6_mreq mreq;
+                    memset(&mreq, 0, sizeof(mreq));
+
+                    boost::asio::ip::address_v6::bytes_type bytes = ip.to_v6().to_bytes();
+                    memcpy(&mreq.ipv6mr_multiaddr, bytes.data(), bytes.size());
+                    mreq.ipv6mr_interface = interface.empty() ? 0 : if_nametoindex(interface.c_str());
+
+                    r = setsockopt(fd, IPPROTO_IPV6, join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP, &mreq, sizeof(mreq));
+                }
+
+                if (0 != r)
+                {
+                    return log_error(std::string(join ? "join" : "leave") + " group " + group, errno);
+                }
+
+                //pktinfo of dual stack socket reports ipv4 groups mapped
+                udp_address addr(boost::asio::ip::udp::endpoint(ip, 0));
+                if (AF_INET6 == family)
+                {
+                    addr.map_v4();
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                auto it = std::find(m_groups.begin(), m_groups.end(), addr);
+                if (join && it == m_groups.end())
+                {
+                    m_groups.push_back(addr);
+                }
+                else if (!join && it != m_groups.end())
+                {
+                    m_groups.erase(it);
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            //lock held by caller across one batch of joined() checks
+            std::mutex & groups_mutex() { return m_mutex; }
+
+            bool joined(const udp_address &group) const { return m_groups.end() != std::find(m_groups.begin(), m_groups.end(), group); }
+
+        protected:
+
+            static int32_t log_error(const std::string &what, int err)
+            {
+                LOG_ERROR << "udp channel " << what << " error: " << err;
+                return ERR_FAILED;
+            }
+
+            int m_ttl = UDP_MULTICAST_DEFAULT;
+
+            int m_loop = UDP_MULTICAST_DEFAULT;
+
+            std::string m_interface;
+
+            std::mutex m_mutex;
+
+            std::vector<udp_address> m_groups;              //joined on this socket, few per channel
+        };
+
+    }
+
+}
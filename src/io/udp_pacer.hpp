@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+
+#define UDP_PACER_DEFAULT_BURST_MS          5                   //default burst: bytes sent at rate in 5 ms
+#define UDP_PACER_MIN_BURST                 65536
+#define UDP_PACER_MAX_DESTINATIONS          4096                //idle destination buckets pruned beyond this
+#define UDP_CONGEST_BACKOFF_MS              1                   //send queue pause after socket reports no buffer
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //bytes per second with burst, tokens may go negative so datagram larger than burst still passes
+        class udp_token_bucket
+        {
+        public:
+
+            udp_token_bucket(uint64_t rate = 0, uint64_t burst = 0, uint64_t now_ns = 0)
+                : m_rate(rate)
+                , m_burst((int64_t)burst)
+                , m_tokens((int64_t)burst)
+                , m_last_ns(now_ns)
+            {}
+
+            bool enabled() const { return m_rate > 0; }
+
+            void refill(uint64_t now_ns)
+            {
+                if (now_ns <= m_last_ns)
+                {
+                    return;
+                }
+
+                //split to keep product in 64 bits after long idle
+                uint64_t elapsed = now_ns - m_last_ns;
+                int64_t add = (int64_t)(elapsed / 1000000000ULL * m_rate + elapsed % 1000000000ULL * m_rate / 1000000000ULL);
+                if (add > 0)
+                {
+                    m_tokens = std::min(m_burst, m_tokens + add);
+                    m_last_ns = now_ns;
+                }
+            }
+
+            bool ready() const { return m_tokens > 0; }
+
+            bool full() const { return m_tokens >= m_burst; }
+
+            void consume(size_t bytes) { m_tokens -= (int64_t)bytes; }
+
+            void refund(size_t bytes) { m_tokens = std::min(m_burst, m_tokens + (int64_t)bytes); }
+
+            //time until tokens positive again
+            uint64_t wait_ns() const
+            {
+                return m_tokens > 0 ? 0 : (uint64_t)(1 - m_tokens) * 1000000000ULL / m_rate + 1;
+            }
+
+        protected:
+
+            uint64_t m_rate;
+
+            int64_t m_burst;
+
+            int64_t m_tokens;
+
+            uint64_t m_last_ns;
+        };
+
+        //channel bucket and optional bucket per destination, both must have tokens to send
+        class udp_pacer
+        {
+        public:
+
+            //0 rate: pacing off
+            void set_rate(uint64_t bytes_per_sec, uint64_t burst, uint64_t now_ns)
+            {
+                m_channel = udp_token_bucket(bytes_per_sec, default_burst(bytes_per_sec, burst), now_ns);
+            }
+
+            void set_destination_rate(uint64_t bytes_per_sec, uint64_t burst)
+            {
+                m_dst_rate = bytes_per_sec;
+                m_dst_burst = default_burst(bytes_per_sec, burst);
+                m_destinations.clear();
+            }
+
+            bool enabled() const { return m_channel.enabled() || m_dst_rate > 0; }
+
+            //true: tokens taken, send now; false: wait_ns till retry
+            bool admit(uint64_t dst_key, size_t bytes, uint64_t now_ns, uint64_t &wait_ns)
+            {
+                udp_token_bucket *dst = nullptr;
+                if (m_dst_rate > 0)
+                {
+                    auto it = m_destinations.find(dst_key);
+                    if (it == m_destinations.end())
+                    {
+                        prune(now_ns);
+                        it = m_destinations.emplace(dst_key, udp_token_bucket(m_dst_rate, m_dst_burst, now_ns)).first;
+                    }
+
+                    dst = &it->second;
+                    dst->refill(now_ns);
+                }
+
+                m_channel.refill(now_ns);
+
+                wait_ns = 0;
+                if (m_channel.enabled() && !m_channel.ready())
+                {
+                    wait_ns = m_channel.wait_ns();
+                }
+
+                if (dst && !dst->ready())
+                {
+                    wait_ns = std::max(wait_ns, dst->wait_ns());
+                }
+
+                if (wait_ns > 0)
+                {
+                    return false;
+                }
+
+                if (m_channel.enabled())
+                {
+                    m_channel.consume(bytes);
+                }
+
+                if (dst)
+                {
+                    dst->consume(bytes);
+                }
+
+                return true;
+            }
+
+            //tokens of admitted datagram that was not sent after all
+            void refund(uint64_t dst_key, size_t bytes)
+            {
+                if (m_channel.enabled())
+                {
+                    m_channel.refund(bytes);
+                }
+
+                auto it = m_destinations.find(dst_key);
+                if (it != m_destinations.end())
+                {
+                    it->second.refund(bytes);
+                }
+            }
+
+        protected:
+
+            static uint64_t default_burst(uint64_t bytes_per_sec, uint64_t burst)
+            {
+                if (burst > 0)
+                {
+                    return burst;
+                }
+
+                return std::max((uint64_t)UDP_PACER_MIN_BURST, bytes_per_sec * UDP_PACER_DEFAULT_BURST_MS / 1000);
+            }
+
+            //full buckets carry no state, drop them
+            void prune(uint64_t now_ns)
+            {
+                if (m_destinations.size() < UDP_PACER_MAX_DESTINATIONS)
+                {
+                    return;
+                }
+
+                for (auto it = m_destinations.begin(); it != m_destinations.end();)
+                {
+                    it->second.refill(now_ns);
+                    it = it->second.full() ? m_destinations.erase(it) : std::next(it);
+                }
+            }
+
+            udp_token_bucket m_channel;
+
+            uint64_t m_dst_rate = 0;
+
+            uint64_t m_dst_burst = 0;
+
+            std::unordered_map<uint64_t, udp_token_bucket> m_destinations;
+        };
+
+    }
+
+}
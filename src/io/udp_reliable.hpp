@@ -0,0 +1,888 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <io/io_handler.hpp>
+#include <io/udp_channel.hpp>
+
+
+#define UDP_RELIABLE_MAGIC                  0x5255              //"RU"
+#define UDP_RELIABLE_DATA_HEADER_LEN        16                  //magic, type, mode, epoch, seq, order; forward is data header without payload
+#define UDP_RELIABLE_ACK_LEN                20                  //magic, type, mode, epoch acked, cumulative ack, sack bitmap
+#define UDP_RELIABLE_MAX_PAYLOAD            (MAX_UDP_RECV_BUF_LEN - UDP_RELIABLE_DATA_HEADER_LEN)       //no fragmentation
+
+#define UDP_RELIABLE_TICK_MS                5
+#define UDP_RELIABLE_INIT_RTO_MS            200
+#define UDP_RELIABLE_MIN_RTO_MS             20
+#define UDP_RELIABLE_MAX_RTO_MS             2000
+#define UDP_RELIABLE_MAX_RETRIES            10                  //data retries, then forward sent in its place with as many retries
+#define UDP_RELIABLE_INIT_CWND              4                   //packets
+#define UDP_RELIABLE_MAX_CWND               1024
+#define UDP_RELIABLE_DUP_THRESH             3                   //later packets acked before earlier one counts lost
+#define UDP_RELIABLE_RECV_WINDOW            4096                //seq beyond cumulative ack + window dropped
+#define UDP_RELIABLE_PEER_IDLE_MS           60000               //sender idle this long opens new session on next send
+#define UDP_RELIABLE_RECV_IDLE_MS           (2 * UDP_RELIABLE_PEER_IDLE_MS + 2 * UDP_RELIABLE_MAX_RETRIES * UDP_RELIABLE_MAX_RTO_MS)      //receive side outlives any sender session it may still see
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        enum udp_delivery
+        {
+            UDP_RELIABLE_ORDERED = 0,                               //acked, retransmitted, delivered in send order
+            UDP_RELIABLE_UNORDERED = 1,                             //acked, retransmitted, delivered on arrival
+            UDP_UNRELIABLE_SEQUENCED = 2                            //sent once, older than last delivered dropped
+        };
+
+        class udp_reliable_stats
+        {
+        public:
+
+            uint64_t m_sent = 0;
+
+            uint64_t m_retransmitted = 0;
+
+            uint64_t m_delivered = 0;
+
+            uint64_t m_duplicates = 0;
+
+            uint64_t m_failed = 0;                                  //gave up after max retries, receiver told to skip
+
+            uint64_t m_injected_losses = 0;
+        };
+
+        //serial number order, valid while peers stay within 2^31 of each other
+        class udp_seq_less
+        {
+        public:
+
+            bool operator()(uint32_t a, uint32_t b) const { return (int32_t)(a - b) < 0; }
+        };
+
+        class udp_address_hasher
+        {
+        public:
+
+            size_t operator()(const udp_address &addr) const { return (size_t)addr.hash(); }
+        };
+
+        //per peer sequence numbers, selective acks, retransmit timers, congestion window and ordered delivery over udp channel
+        //packet given up after max retries is replaced by a forward: receiver counts its seq received and skips its order
+        //each sender session has random epoch; receiver resets on new epoch, so restarted or idle sender starts over at seq 0
+        //every datagram on channel is framed; foreign datagrams go on to next handler
+        //send() from any thread, delivery / failure functors and timers on channel loop thread
+        class udp_reliable_handler : public channel_inbound_handler
+        {
+        public:
+
+            typedef std::function<void(udp_reliable_handler &, const udp_address &, const char *, size_t)> deliver_functor;
+
+            //call from initializer before channel init, handler takes channel tick
+            udp_reliable_handler(udp_channel *channel, deliver_functor deliver)
+                : m_channel(channel)
+                , m_deliver(deliver)
+                , m_loss_rate(0)
+                , m_random(std::random_device()())
+            {
+                m_channel->set_tick([this]() { on_tick(); }, UDP_RELIABLE_TICK_MS);
+            }
+
+            //payload of each packet given up after max retries, set before channel init
+            void set_failed(deliver_functor failed) { m_on_failed = failed; }
+
+            //simulated loss of outgoing datagrams, data and acks, for tests over loopback
+            void set_loss_rate(double loss_rate) { m_loss_rate = loss_rate; }
+
+            int32_t send(const udp_address &peer, const char *data, size_t len, udp_delivery mode = UDP_RELIABLE_ORDERED)
+            {
+                if (len > UDP_RELIABLE_MAX_PAYLOAD)
+                {
+                    LOG_ERROR << "udp reliable payload too large: " << len;
+                    return ERR_FAILED;
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                peer_state &p = get_peer(peer);
+                uint64_t now = now_ms();
+
+                //receiver may have dropped state of idle session
+                if (0 == p.m_send_epoch || (p.m_inflight.empty() && p.m_waiting.empty() && now > p.m_last_sent + UDP_RELIABLE_PEER_IDLE_MS))
+                {
+                    open_session(p);
+                }
+
+                if (UDP_UNRELIABLE_SEQUENCED == mode)
+                {
+                    transmit_data(p, mode, 0, p.m_next_sequenced++, data, len);
+                    return ERR_SUCCESS;
+                }
+
+                pending_packet pkt;
+                pkt.m_seq = p.m_next_seq++;
+                pkt.m_order = UDP_RELIABLE_ORDERED == mode ? p.m_next_order++ : 0;
+                pkt.m_mode = mode;
+                pkt.m_payload.assign(data, len);
+
+                p.m_waiting.push_back(std::move(pkt));
+                fill_window(p, now);
+
+                return ERR_SUCCESS;
+            }
+
+            udp_reliable_stats stats()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                return m_stats;
+            }
+
+            //packets sent but not acked yet, and queued behind congestion window
+            size_t pending(const udp_address &peer)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                auto it = m_peers.find(peer);
+                return it == m_peers.end() ? 0 : it->second.m_inflight.size() + it->second.m_waiting.size();
+            }
+
+            void channel_read_complete(context_type &ctx) override
+            {
+                buf_ptr_type buf = m_channel->recv_buf();
+                if (!on_datagram(m_channel->get_remote_address(), buf->get_read_ptr(), buf->get_valid_read_len()))
+                {
+                    ctx.fire_channel_read_complete();
+                }
+
+                flush_acks();
+            }
+
+            void channel_batch_read_complete(context_type &ctx) override
+            {
+                //next handler sees foreign datagrams only
+                m_channel->remove_datagrams([this](const udp_datagram &datagram)
+                {
+                    return on_datagram(*datagram.m_addr, datagram.m_data, datagram.m_len);
+                });
+
+                //one ack per peer for whole batch
+                flush_acks();
+
+                if (!m_channel->recv_datagrams().empty())
+                {
+                    ctx.fire_channel_batch_read_complete();
+                }
+            }
+
+        protected:
+
+            typedef udp_channel::buf_ptr_type buf_ptr_type;
+
+            class pending_packet
+            {
+            public:
+
+                uint32_t m_seq = 0;
+
+                uint32_t m_order = 0;
+
+                udp_delivery m_mode = UDP_RELIABLE_ORDERED;
+
+                std::string m_payload;
+
+                uint64_t m_sent_ms = 0;
+
+                uint32_t m_retries = 0;
+
+                bool m_fast_retransmitted = false;
+
+                bool m_abandoned = false;                           //retransmitted as forward, payload dropped
+            };
+
+            class failed_packet
+            {
+            public:
+
+                udp_address m_addr;
+
+                std::string m_payload;
+            };
+
+            class peer_state
+            {
+            public:
+
+                udp_address m_addr;
+
+                uint64_t m_last_sent = 0;                           //data or forward, retransmits included
+
+                uint64_t m_last_received = 0;
+
+                //sender
+                uint32_t m_send_epoch = 0;                          //0: no session open
+
+                uint32_t m_next_seq = 0;
+
+                uint32_t m_next_order = 0;
+
+                uint32_t m_next_sequenced = 0;
+
+                std::map<uint32_t, pending_packet, udp_seq_less> m_inflight;
+
+                std::deque<pending_packet> m_waiting;
+
+                double m_cwnd = UDP_RELIABLE_INIT_CWND;
+
+                double m_ssthresh = UDP_RELIABLE_MAX_CWND;
+
+                double m_srtt = 0;
+
+                double m_rttvar = 0;
+
+                uint64_t m_rto = UDP_RELIABLE_INIT_RTO_MS;
+
+                uint32_t m_recovery_seq = 0;                        //one window cut per loss round
+
+                bool m_in_recovery = false;
+
+                //receiver
+                uint32_t m_recv_epoch = 0;
+
+                uint32_t m_prev_recv_epoch = 0;                     //packets of replaced session dropped
+
+                uint32_t m_cum_ack = 0;                             //all seq before received
+
+                std::set<uint32_t, udp_seq_less> m_received;        //seq after cumulative ack
+
+                uint32_t m_next_deliver_order = 0;
+
+                std::map<uint32_t, std::string, udp_seq_less> m_reorder;
+
+                std::set<uint32_t, udp_seq_less> m_skipped;         //orders abandoned by sender, not reached yet
+
+                uint32_t m_last_sequenced = 0;
+
+                bool m_has_sequenced = false;
+
+                bool m_ack_due = false;
+            };
+
+            static uint64_t now_ms() { return uv_hrtime() / 1000000; }
+
+            peer_state & get_peer(const udp_address &addr)
+            {
+                peer_state &p = m_peers[addr];
+                if (0 == p.m_addr.family())
+                {
+                    p.m_addr = addr;
+                }
+
+                return p;
+            }
+
+            //new random epoch, sequence numbers and window start over
+            void open_session(peer_state &p)
+            {
+                uint32_t epoch = 0;
+                while (0 == epoch || p.m_send_epoch == epoch)
+                {
+                    epoch = (uint32_t)m_random();
+                }
+
+                p.m_send_epoch = epoch;
+                p.m_next_seq = 0;
+                p.m_next_order = 0;
+                p.m_next_sequenced = 0;
+                p.m_cwnd = UDP_RELIABLE_INIT_CWND;
+                p.m_ssthresh = UDP_RELIABLE_MAX_CWND;
+                p.m_in_recovery = false;
+            }
+
+            //false: packet of session already replaced
+            bool accept_epoch(peer_state &p, uint32_t epoch)
+            {
+                if (epoch == p.m_recv_epoch)
+                {
+                    return true;
+                }
+
+                if (0 != p.m_prev_recv_epoch && epoch == p.m_prev_recv_epoch)
+                {
+                    return false;
+                }
+
+                p.m_prev_recv_epoch = p.m_recv_epoch;
+                p.m_recv_epoch = epoch;
+
+                //sender restarted or reopened after idle, whatever is held belongs to old session
+                p.m_cum_ack = 0;
+                p.m_received.clear();
+                p.m_next_deliver_order = 0;
+                p.m_reorder.clear();
+                p.m_skipped.clear();
+                p.m_last_sequenced = 0;
+                p.m_has_sequenced = false;
+
+                return true;
+            }
+
+            //false: not a reliable datagram
+            bool on_datagram(const udp_address &from, const char *data, size_t len)
+            {
+                if (len < 4 || UDP_RELIABLE_MAGIC != get16(data))
+                {
+                    return false;
+                }
+
+                uint8_t type = (uint8_t)data[2];
+                uint8_t mode = (uint8_t)data[3];
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if (2 == type)
+                {
+                    //acks only for sessions opened here
+                    auto it = m_peers.find(from);
+                    if (len >= UDP_RELIABLE_ACK_LEN && it != m_peers.end() && get32(data + 4) == it->second.m_send_epoch)
+                    {
+                        on_ack(it->second, get32(data + 8), get64(data + 12));
+                    }
+
+                    return true;
+                }
+
+                bool is_data = 1 == type && len >= UDP_RELIABLE_DATA_HEADER_LEN && mode <= UDP_UNRELIABLE_SEQUENCED;
+                bool is_forward = 3 == type && len >= UDP_RELIABLE_DATA_HEADER_LEN && mode <= UDP_RELIABLE_UNORDERED;
+                if (!is_data && !is_forward)
+                {
+                    return true;
+                }
+
+                peer_state &p = get_peer(from);
+                p.m_last_received = now_ms();
+
+                if (!accept_epoch(p, get32(data + 4)))
+                {
+                    m_stats.m_duplicates++;
+                    return true;
+                }
+
+                if (is_data)
+                {
+                    on_data(p, (udp_delivery)mode, get32(data + 8), get32(data + 12), data + UDP_RELIABLE_DATA_HEADER_LEN, len - UDP_RELIABLE_DATA_HEADER_LEN);
+                }
+                else
+                {
+                    on_forward(p, (udp_delivery)mode, get32(data + 8), get32(data + 12));
+                }
+
+                return true;
+            }
+
+            void on_data(peer_state &p, udp_delivery mode, uint32_t seq, uint32_t order, const char *payload, size_t len)
+            {
+                if (UDP_UNRELIABLE_SEQUENCED == mode)
+                {
+                    if (p.m_has_sequenced && !udp_seq_less()(p.m_last_sequenced, order))
+                    {
+                        m_stats.m_duplicates++;
+                        return;
+                    }
+
+                    p.m_has_sequenced = true;
+                    p.m_last_sequenced = order;
+
+                    deliver(p, payload, len);
+                    return;
+                }
+
+                //ack whatever arrives, earlier ack may be lost
+                ack_due(p);
+
+                if (udp_seq_less()(seq, p.m_cum_ack) || p.m_received.count(seq))
+                {
+                    m_stats.m_duplicates++;
+                    return;
+                }
+
+                if (!udp_seq_less()(seq, p.m_cum_ack + UDP_RELIABLE_RECV_WINDOW))
+                {
+                    return;
+                }
+
+                mark_received(p, seq);
+
+                if (UDP_RELIABLE_UNORDERED == mode)
+                {
+                    deliver(p, payload, len);
+                    return;
+                }
+
+                if (order != p.m_next_deliver_order)
+                {
+                    p.m_reorder.emplace(order, std::string(payload, len));
+                    return;
+                }
+
+                deliver(p, payload, len);
+                p.m_next_deliver_order++;
+
+                release_ordered(p);
+            }
+
+            //sender gave up on seq; data that made it here earlier was delivered and stays so
+            void on_forward(peer_state &p, udp_delivery mode, uint32_t seq, uint32_t order)
+            {
+                ack_due(p);
+
+                if (udp_seq_less()(seq, p.m_cum_ack) || p.m_received.count(seq) || !udp_seq_less()(seq, p.m_cum_ack + UDP_RELIABLE_RECV_WINDOW))
+                {
+                    return;
+                }
+
+                mark_received(p, seq);
+
+                if (UDP_RELIABLE_ORDERED == mode)
+                {
+                    p.m_skipped.insert(order);
+                    release_ordered(p);
+                }
+            }
+
+            //by address, delivery may throw before flush and peer be pruned after
+            void ack_due(peer_state &p)
+            {
+                if (!p.m_ack_due)
+                {
+                    p.m_ack_due = true;
+                    m_ack_peers.push_back(p.m_addr);
+                }
+            }
+
+            void mark_received(peer_state &p, uint32_t seq)
+            {
+                p.m_received.insert(seq);
+                while (!p.m_received.empty() && *p.m_received.begin() == p.m_cum_ack)
+                {
+                    p.m_received.erase(p.m_received.begin());
+                    p.m_cum_ack++;
+                }
+            }
+
+            //gap filled or skipped, release held messages
+            void release_ordered(peer_state &p)
+            {
+                while (true)
+                {
+                    auto skipped = p.m_skipped.find(p.m_next_deliver_order);
+                    if (skipped != p.m_skipped.end())
+                    {
+                        p.m_skipped.erase(skipped);
+                        p.m_next_deliver_order++;
+                        continue;
+                    }
+
+                    auto it = p.m_reorder.begin();
+                    if (it == p.m_reorder.end() || it->first != p.m_next_deliver_order)
+                    {
+                        return;
+                    }
+
+                    std::string payload = std::move(it->second);
+                    p.m_reorder.erase(it);
+
+                    deliver(p, payload.data(), payload.size());
+                    p.m_next_deliver_order++;
+                }
+            }
+
+            void on_ack(peer_state &p, uint32_t cum_ack, uint64_t sack)
+            {
+                uint64_t now = now_ms();
+                uint32_t highest_acked = cum_ack;
+                bool acked = false;
+
+                for (auto it = p.m_inflight.begin(); it != p.m_inflight.end();)
+                {
+                    uint32_t seq = it->first;
+                    uint32_t offset = seq - cum_ack - 1;
+
+                    bool is_acked = udp_seq_less()(seq, cum_ack) || (seq != cum_ack && offset < 64 && (sack & (1ULL << offset)));
+                    if (!is_acked)
+                    {
+                        ++it;
+                        continue;
+                    }
+
+                    //rtt from packets sent once only
+                    if (0 == it->second.m_retries)
+                    {
+                        update_rtt(p, (double)(now - it->second.m_sent_ms));
+                    }
+
+                    if (udp_seq_less()(highest_acked, seq))
+                    {
+                        highest_acked = seq;
+                    }
+
+                    //slow start below ssthresh, then one packet per window
+                    p.m_cwnd += p.m_cwnd < p.m_ssthresh ? 1.0 : 1.0 / p.m_cwnd;
+                    p.m_cwnd = std::min(p.m_cwnd, (double)UDP_RELIABLE_MAX_CWND);
+
+                    acked = true;
+                    it = p.m_inflight.erase(it);
+                }
+
+                if (p.m_in_recovery && !udp_seq_less()(cum_ack, p.m_recovery_seq))
+                {
+                    p.m_in_recovery = false;
+                }
+
+                //fast retransmit: later packets selectively acked past threshold
+                for (auto &it : p.m_inflight)
+                {
+                    pending_packet &pkt = it.second;
+                    if (!udp_seq_less()(pkt.m_seq + UDP_RELIABLE_DUP_THRESH - 1, highest_acked))
+                    {
+                        break;
+                    }
+
+                    if (pkt.m_fast_retransmitted)
+                    {
+                        continue;
+                    }
+
+                    pkt.m_fast_retransmitted = true;
+                    on_loss(p, false);
+                    retransmit(p, pkt, now);
+                }
+
+                if (acked)
+                {
+                    fill_window(p, now);
+                }
+            }
+
+            void update_rtt(peer_state &p, double rtt)
+            {
+                //rfc 6298
+                if (0 == p.m_srtt)
+                {
+                    p.m_srtt = rtt;
+                    p.m_rttvar = rtt / 2;
+                }
+                else
+                {
+                    p.m_rttvar = 0.75 * p.m_rttvar + 0.25 * std::abs(p.m_srtt - rtt);
+                    p.m_srtt = 0.875 * p.m_srtt + 0.125 * rtt;
+                }
+
+                p.m_rto = std::min((uint64_t)UDP_RELIABLE_MAX_RTO_MS, std::max((uint64_t)UDP_RELIABLE_MIN_RTO_MS, (uint64_t)(p.m_srtt + 4 * p.m_rttvar)));
+            }
+
+            //window halves once per round of losses, timeout falls back to one packet
+            void on_loss(peer_state &p, bool timeout)
+            {
+                if (!p.m_in_recovery)
+                {
+                    p.m_ssthresh = std::max(p.m_cwnd / 2, 2.0);
+                    p.m_cwnd = p.m_ssthresh;
+                    p.m_in_recovery = true;
+                    p.m_recovery_seq = p.m_next_seq;
+                }
+
+                if (timeout)
+                {
+                    p.m_cwnd = 1;
+                }
+            }
+
+            void fill_window(peer_state &p, uint64_t now)
+            {
+                while (!p.m_waiting.empty() && p.m_inflight.size() < (size_t)p.m_cwnd)
+                {
+                    pending_packet &pkt = p.m_inflight.emplace(p.m_waiting.front().m_seq, std::move(p.m_waiting.front())).first->second;
+                    p.m_waiting.pop_front();
+
+                    pkt.m_sent_ms = now;
+                    transmit_data(p, pkt.m_mode, pkt.m_seq, pkt.m_order, pkt.m_payload.data(), pkt.m_payload.size());
+                }
+            }
+
+            void retransmit(peer_state &p, pending_packet &pkt, uint64_t now)
+            {
+                pkt.m_retries++;
+                pkt.m_sent_ms = now;
+
+                m_stats.m_retransmitted++;
+                transmit_data(p, pkt.m_mode, pkt.m_seq, pkt.m_order, pkt.m_payload.data(), pkt.m_payload.size(), pkt.m_abandoned ? 3 : 1);
+            }
+
+            //forward takes place of data in flight, acked like data
+            void abandon(peer_state &p, pending_packet &pkt, uint64_t now, std::vector<failed_packet> &failed)
+            {
+                LOG_ERROR << "udp reliable give up seq " << pkt.m_seq << " to port " << p.m_addr.port();
+
+                m_stats.m_failed++;
+
+                failed_packet f;
+                f.m_addr = p.m_addr;
+                f.m_payload.swap(pkt.m_payload);
+                failed.push_back(std::move(f));
+
+                pkt.m_abandoned = true;
+                pkt.m_retries = 0;
+                pkt.m_sent_ms = now;
+
+                transmit_data(p, pkt.m_mode, pkt.m_seq, pkt.m_order, nullptr, 0, 3);
+            }
+
+            void on_tick()
+            {
+                std::vector<failed_packet> failed;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                uint64_t now = now_ms();
+                for (auto it = m_peers.begin(); it != m_peers.end();)
+                {
+                    peer_state &p = it->second;
+
+                    bool timed_out = false;
+                    for (auto pkt = p.m_inflight.begin(); pkt != p.m_inflight.end();)
+                    {
+                        if (now < pkt->second.m_sent_ms + p.m_rto)
+                        {
+                            ++pkt;
+                            continue;
+                        }
+
+                        if (pkt->second.m_retries >= UDP_RELIABLE_MAX_RETRIES)
+                        {
+                            //forward unacked as well, peer unreachable: receiver state unknown, session dropped
+                            if (pkt->second.m_abandoned)
+                            {
+                                LOG_ERROR << "udp reliable forward of seq " << pkt->first << " unacked, port " << p.m_addr.port();
+                                close_session(p, failed);
+                                timed_out = false;
+                                break;
+                            }
+
+                            timed_out = true;
+                            abandon(p, pkt->second, now, failed);
+                            ++pkt;
+                            continue;
+                        }
+
+                        timed_out = true;
+                        retransmit(p, pkt->second, now);
+                        ++pkt;
+                    }
+
+                    if (timed_out)
+                    {
+                        on_loss(p, true);
+                        p.m_rto = std::min((uint64_t)UDP_RELIABLE_MAX_RTO_MS, p.m_rto * 2);
+                    }
+
+                    fill_window(p, now);
+
+                    //sender reopens after idle, receive side kept longer than sender may go on with same session
+                    bool idle = p.m_inflight.empty() && p.m_waiting.empty() && now > p.m_last_sent + UDP_RELIABLE_PEER_IDLE_MS && now > p.m_last_received + UDP_RELIABLE_RECV_IDLE_MS;
+                    it = idle ? m_peers.erase(it) : std::next(it);
+                }
+
+                lock.unlock();
+
+                //outside lock, functor may send
+                if (m_on_failed)
+                {
+                    for (auto &f : failed)
+                    {
+                        m_on_failed(*this, f.m_addr, f.m_payload.data(), f.m_payload.size());
+                    }
+                }
+            }
+
+            //packets not acked yet failed, next send opens new session
+            void close_session(peer_state &p, std::vector<failed_packet> &failed)
+            {
+                for (auto &it : p.m_inflight)
+                {
+                    if (!it.second.m_abandoned)
+                    {
+                        m_stats.m_failed++;
+
+                        failed_packet f;
+                        f.m_addr = p.m_addr;
+                        f.m_payload.swap(it.second.m_payload);
+                        failed.push_back(std::move(f));
+                    }
+                }
+
+                for (auto &pkt : p.m_waiting)
+                {
+                    m_stats.m_failed++;
+
+                    failed_packet f;
+                    f.m_addr = p.m_addr;
+                    f.m_payload.swap(pkt.m_payload);
+                    failed.push_back(std::move(f));
+                }
+
+                p.m_inflight.clear();
+                p.m_waiting.clear();
+                p.m_send_epoch = 0;
+            }
+
+            void flush_acks()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                for (auto &addr : m_ack_peers)
+                {
+                    auto it = m_peers.find(addr);
+                    if (it == m_peers.end() || !it->second.m_ack_due)
+                    {
+                        continue;
+                    }
+
+                    peer_state *p = &it->second;
+                    p->m_ack_due = false;
+
+                    //bit i: seq cum_ack + 1 + i received
+                    uint64_t sack = 0;
+                    for (uint32_t seq : p->m_received)
+                    {
+                        uint32_t offset = seq - p->m_cum_ack - 1;
+                        if (offset >= 64)
+                        {
+                            break;
+                        }
+
+                        sack |= 1ULL << offset;
+                    }
+
+                    char ack[UDP_RELIABLE_ACK_LEN];
+                    put16(ack, UDP_RELIABLE_MAGIC);
+                    ack[2] = 2;
+                    ack[3] = 0;
+                    put32(ack + 4, p->m_recv_epoch);
+                    put32(ack + 8, p->m_cum_ack);
+                    put64(ack + 12, sack);
+
+                    transmit(p->m_addr, ack, sizeof(ack), nullptr, 0);
+                }
+
+                m_ack_peers.clear();
+            }
+
+            //type 1: data, 3: forward
+            void transmit_data(peer_state &p, udp_delivery mode, uint32_t seq, uint32_t order, const char *payload, size_t len, uint8_t type = 1)
+            {
+                char header[UDP_RELIABLE_DATA_HEADER_LEN];
+                put16(header, UDP_RELIABLE_MAGIC);
+                header[2] = (char)type;
+                header[3] = (char)mode;
+                put32(header + 4, p.m_send_epoch);
+                put32(header + 8, seq);
+                put32(header + 12, order);
+
+                p.m_last_sent = now_ms();
+                m_stats.m_sent++;
+                transmit(p.m_addr, header, sizeof(header), payload, len);
+            }
+
+            void transmit(const udp_address &to, const char *header, size_t header_len, const char *payload, size_t len)
+            {
+                if (m_loss_rate > 0 && std::uniform_real_distribution<double>(0, 1)(m_random) < m_loss_rate)
+                {
+                    m_stats.m_injected_losses++;
+                    return;
+                }
+
+                send_data *snd_data = m_channel->alloc_send_data(header_len + len);
+                if (nullptr == snd_data)
+                {
+                    return;
+                }
+
+                memcpy(snd_data->m_uv_buf->base, header, header_len);
+                if (len > 0)
+                {
+                    memcpy(snd_data->m_uv_buf->base + header_len, payload, len);
+                }
+
+                snd_data->m_send_addr = to;
+                m_channel->push_and_notify_async(snd_data);
+            }
+
+            //deliver outside lock, functor may send
+            void deliver(peer_state &p, const char *data, size_t len)
+            {
+                m_stats.m_delivered++;
+
+                udp_address from = p.m_addr;
+                m_mutex.unlock();
+
+                try
+                {
+                    m_deliver(*this, from, data, len);
+                }
+                catch (...)
+                {
+                    m_mutex.lock();
+                    throw;
+                }
+
+                m_mutex.lock();
+            }
+
+            static uint16_t get16(const char *p) { return (uint16_t)((uint8_t)p[0] << 8 | (uint8_t)p[1]); }
+
+            static uint32_t get32(const char *p) { return (uint32_t)get16(p) << 16 | get16(p + 2); }
+
+            static uint64_t get64(const char *p) { return (uint64_t)get32(p) << 32 | get32(p + 4); }
+
+            static void put16(char *p, uint16_t v) { p[0] = (char)(v >> 8); p[1] = (char)v; }
+
+            static void put32(char *p, uint32_t v) { put16(p, (uint16_t)(v >> 16)); put16(p + 2, (uint16_t)v); }
+
+            static void put64(char *p, uint64_t v) { put32(p, (uint32_t)(v >> 32)); put32(p + 4, (uint32_t)v); }
+
+        protected:
+
+            udp_channel *m_channel;                                 //channel owns handler through its chain
+
+            deliver_functor m_deliver;
+
+            deliver_functor m_on_failed;
+
+            std::mutex m_mutex;
+
+            std::unordered_map<udp_address, peer_state, udp_address_hasher> m_peers;
+
+            std::vector<udp_address> m_ack_peers;                   //peers owed an ack after current read
+
+            udp_reliable_stats m_stats;
+
+            double m_loss_rate;
+
+            std::minstd_rand m_random;
+        };
+
+    }
+
+}
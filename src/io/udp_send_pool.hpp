@@ -0,0 +1,358 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <common/common.hpp>
+#include <io/udp_address.hpp>
+
+__BEGIN_DECLS__
+#include <uv.h>
+__END_DECLS__
+
+
+#define UDP_SEND_INLINE_LEN             1472                //ethernet mtu payload, fits in slot
+#define UDP_SEND_SLAB_SLOTS             256                 //slots per slab chunk
+#define UDP_SEND_MAX_CHUNKS             256                 //slab limit per channel, 65536 slots
+#define UDP_SEND_LARGE_CLASS_COUNT      3
+
+
+namespace micro
+{
+
+    namespace core
+    {
+
+        class send_data
+        {
+        public:
+
+            uv_buf_t * m_uv_buf = nullptr;
+
+            size_t m_uv_buf_count = 0;
+
+            udp_address m_send_addr;                        //ipv4 or ipv6, uv_ip4_addr(ip, port, (sockaddr_in *)&m_send_addr) still fills it
+
+            void * m_extra_info = nullptr;
+
+            send_data * m_next = nullptr;                   //producer queue link, set by channel
+        };
+
+        //release buffers and send data allocated by encoder
+        extern void free_send_data(send_data *snd_data);
+
+        //send request, send data, buffer and inline payload in one object
+        class udp_send_slot
+        {
+        public:
+
+            uv_udp_send_t m_req;
+
+            send_data m_data;
+
+            uv_buf_t m_buf;
+
+            int m_large_class;                              //-1: payload inline
+
+            uint32_t m_idx;                                 //position in slab
+
+            std::atomic<uint32_t> m_next_free;              //free list link, slab position + 1, 0: end
+
+            char m_payload[UDP_SEND_INLINE_LEN];
+        };
+
+        //per channel slot slab, larger payloads from size classed block cache
+        //encoder threads alloc and loop thread releases on one lock free stack of slab positions, tag in high half
+        //of head against aba; slab only grows, so a stale link read by a losing cas still points into the slab
+        //lock taken only to grow slab and for payloads over inline size
+        //send data not allocated here passes through untouched, owner() tells them apart by address
+        class udp_send_pool
+        {
+        public:
+
+            udp_send_pool() : m_free(0), m_chunk_count(0), m_in_use(0), m_heap_allocations(0) {}
+
+            udp_send_pool(const udp_send_pool &) = delete;
+
+            udp_send_pool & operator=(const udp_send_pool &) = delete;
+
+            ~udp_send_pool()
+            {
+                for (auto &blocks : m_large_blocks)
+                {
+                    for (auto block : blocks)
+                    {
+                        free(block);
+                    }
+                }
+            }
+
+            //send data with one buffer of len bytes, nullptr over 64KB
+            //m_uv_buf belongs to slot, do not free or replace it
+            send_data * alloc(size_t len)
+            {
+                int large_class = -1;
+                char *payload = nullptr;
+
+                if (len > UDP_SEND_INLINE_LEN)
+                {
+                    large_class = size_class(len);
+                    payload = large_class < 0 ? nullptr : alloc_large(large_class);
+
+                    if (nullptr == payload)
+                    {
+                        return nullptr;
+                    }
+                }
+
+                udp_send_slot *slot = pop_free();
+                if (nullptr == slot)
+                {
+                    if (payload)
+                    {
+                        release_large(large_class, payload);
+                    }
+
+                    //slab limit reached, plain heap send data freed by free_send_data
+                    return heap_send_data(len);
+                }
+
+                slot->m_large_class = large_class;
+                slot->m_buf.base = payload ? payload : slot->m_payload;
+                slot->m_buf.len = len;
+
+                slot->m_data = send_data();
+                slot->m_data.m_uv_buf = &slot->m_buf;
+                slot->m_data.m_uv_buf_count = 1;
+
+                m_in_use++;
+                return &slot->m_data;
+            }
+
+            //send request of pooled send data, nullptr for others
+            uv_udp_send_t * request(send_data *snd_data)
+            {
+                udp_send_slot *slot = owner(snd_data);
+                return slot ? &slot->m_req : nullptr;
+            }
+
+            //false: send data not from pool, caller frees it
+            bool release(send_data *snd_data)
+            {
+                udp_send_slot *slot = owner(snd_data);
+                if (nullptr == slot)
+                {
+                    return false;
+                }
+
+                if (slot->m_large_class >= 0)
+                {
+                    release_large(slot->m_large_class, slot->m_buf.base);
+                }
+
+                m_in_use--;
+                push_free(slot, slot);
+
+                return true;
+            }
+
+            size_t in_use() const { return m_in_use; }
+
+            //slab chunks and blocks taken from heap, flat once pool is warm
+            uint64_t heap_allocations() const { return m_heap_allocations; }
+
+        protected:
+
+            static size_t class_len(int large_class)
+            {
+                static const size_t lens[UDP_SEND_LARGE_CLASS_COUNT] = { 4096, 16384, 65536 };
+                return lens[large_class];
+            }
+
+            //about 16MB cached per class
+            static size_t class_cache_size(int large_class)
+            {
+                static const size_t sizes[UDP_SEND_LARGE_CLASS_COUNT] = { 4096, 1024, 256 };
+                return sizes[large_class];
+            }
+
+            static int size_class(size_t len)
+            {
+                for (int i = 0; i < UDP_SEND_LARGE_CLASS_COUNT; i++)
+                {
+                    if (len <= class_len(i))
+                    {
+                        return i;
+                    }
+                }
+
+                return -1;
+            }
+
+            udp_send_slot * slot_at(uint32_t idx) { return &m_chunks[idx / UDP_SEND_SLAB_SLOTS][idx % UDP_SEND_SLAB_SLOTS]; }
+
+            static uint64_t free_head(uint64_t head, uint32_t next) { return (((head >> 32) + 1) << 32) | next; }
+
+            udp_send_slot * pop_free()
+            {
+                uint64_t head = m_free.load(std::memory_order_acquire);
+                while (true)
+                {
+                    uint32_t top = (uint32_t)head;
+                    if (0 == top)
+                    {
+                        if (!grow())
+                        {
+                            return nullptr;
+                        }
+
+                        head = m_free.load(std::memory_order_acquire);
+                        continue;
+                    }
+
+                    udp_send_slot *slot = slot_at(top - 1);
+                    if (m_free.compare_exchange_weak(head, free_head(head, slot->m_next_free.load(std::memory_order_relaxed)), std::memory_order_acquire, std::memory_order_acquire))
+                    {
+                        return slot;
+                    }
+                }
+            }
+
+            //first..last already linked
+            void push_free(udp_send_slot *first, udp_send_slot *last)
+            {
+                uint64_t head = m_free.load(std::memory_order_relaxed);
+                do
+                {
+                    last->m_next_free.store((uint32_t)head, std::memory_order_relaxed);
+                } while (!m_free.compare_exchange_weak(head, free_head(head, first->m_idx + 1), std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            //false: slab limit reached; true also when another thread grew meanwhile
+            bool grow()
+            {
+                std::unique_lock<std::mutex> lock(m_grow_mutex);
+
+                if (0 != (uint32_t)m_free.load(std::memory_order_acquire))
+                {
+                    return true;
+                }
+
+                size_t count = m_chunk_count.load(std::memory_order_relaxed);
+                if (count >= UDP_SEND_MAX_CHUNKS)
+                {
+                    return false;
+                }
+
+                udp_send_slot *chunk = new udp_send_slot[UDP_SEND_SLAB_SLOTS];
+                m_heap_allocations++;
+
+                for (size_t i = 0; i < UDP_SEND_SLAB_SLOTS; i++)
+                {
+                    chunk[i].m_idx = (uint32_t)(count * UDP_SEND_SLAB_SLOTS + i);
+                    chunk[i].m_next_free.store(chunk[i].m_idx + 2, std::memory_order_relaxed);
+                }
+
+                m_chunks[count].reset(chunk);
+
+                //publish after chunk is in place, owner() reads without lock
+                m_chunk_count.store(count + 1, std::memory_order_release);
+
+                push_free(&chunk[0], &chunk[UDP_SEND_SLAB_SLOTS - 1]);
+                return true;
+            }
+
+            udp_send_slot * owner(send_data *snd_data)
+            {
+                uintptr_t addr = (uintptr_t)snd_data;
+
+                size_t count = m_chunk_count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; i++)
+                {
+                    uintptr_t begin = (uintptr_t)m_chunks[i].get();
+                    if (addr >= begin && addr < begin + sizeof(udp_send_slot) * UDP_SEND_SLAB_SLOTS)
+                    {
+                        return (udp_send_slot *)((char *)snd_data - offsetof(udp_send_slot, m_data));
+                    }
+                }
+
+                return nullptr;
+            }
+
+            send_data * heap_send_data(size_t len)
+            {
+                m_heap_allocations++;
+
+                send_data *snd_data = (send_data *)malloc(sizeof(send_data));
+                new (snd_data) send_data();
+
+                snd_data->m_uv_buf = (uv_buf_t *)malloc(sizeof(uv_buf_t));
+                snd_data->m_uv_buf->base = (char *)malloc(len);
+                snd_data->m_uv_buf->len = len;
+                snd_data->m_uv_buf_count = 1;
+
+                return snd_data;
+            }
+
+            char * alloc_large(int large_class)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_large_mutex);
+
+                    auto &blocks = m_large_blocks[large_class];
+                    if (!blocks.empty())
+                    {
+                        char *block = blocks.back();
+                        blocks.pop_back();
+
+                        return block;
+                    }
+                }
+
+                m_heap_allocations++;
+                return (char *)malloc(class_len(large_class));
+            }
+
+            void release_large(int large_class, char *block)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_large_mutex);
+
+                    auto &blocks = m_large_blocks[large_class];
+                    if (blocks.size() < class_cache_size(large_class))
+                    {
+                        blocks.push_back(block);
+                        return;
+                    }
+                }
+
+                free(block);
+            }
+
+        protected:
+
+            std::mutex m_grow_mutex;
+
+            std::mutex m_large_mutex;
+
+            std::atomic<uint64_t> m_free;                       //aba tag << 32 | top slab position + 1, 0: empty
+
+            std::unique_ptr<udp_send_slot[]> m_chunks[UDP_SEND_MAX_CHUNKS];
+
+            std::atomic<size_t> m_chunk_count;
+
+            std::atomic<size_t> m_in_use;
+
+            std::atomic<uint64_t> m_heap_allocations;
+
+            std::vector<char *> m_large_blocks[UDP_SEND_LARGE_CLASS_COUNT];
+        };
+
+    }
+
+}
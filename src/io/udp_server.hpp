@@ -0,0 +1,165 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <io/udp_channel.hpp>
+#include <logger/logger.hpp>
+#include <thread/uv_thread_pool.hpp>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define DEFAULT_UDP_LOOP_COUNT      1
+
+namespace micro
+{
+    namespace core
+    {
+
+        //one receiving loop: own uv loop thread and socket on shared port
+        class udp_server_loop
+        {
+        public:
+
+            uv_thread_pool m_pool;
+
+            std::shared_ptr<udp_channel> m_channel;
+
+            bool m_running = false;                         //channel initialized and loop thread started
+        };
+
+        //udp port served by several loops, each loop binds own SO_REUSEPORT socket and kernel hashes flows between them
+        //initializers run once per socket so every loop has its own handler chain; handlers reply through
+        //IO_CONTEXT channel, the socket that received the datagram
+        class udp_server
+        {
+        public:
+
+            typedef std::shared_ptr<udp_server_loop> loop_ptr_type;
+
+            typedef std::shared_ptr<io_handler_initializer> initializer_ptr_type;
+
+            typedef std::function<void(std::shared_ptr<udp_channel>)> channel_setup_type;
+
+            udp_server(initializer_ptr_type inbound_initializer, initializer_ptr_type outbound_initializer)
+                : m_inbound_initializer(inbound_initializer)
+                , m_outbound_initializer(outbound_initializer)
+            {
+            }
+
+            ~udp_server()
+            {
+                stop();
+            }
+
+            //channel options like batch size or pacing applied to each socket before init; set before listen
+            void set_channel_setup(channel_setup_type setup) { m_channel_setup = setup; }
+
+            //loop_count 0: one loop per core
+            int32_t listen(const std::string &ip, uint16_t port, uint32_t loop_count = DEFAULT_UDP_LOOP_COUNT)
+            {
+                if (!m_loops.empty())
+                {
+                    LOG_ERROR << "udp server already listening";
+                    return ERR_FAILED;
+                }
+
+                if (0 == loop_count)
+                {
+#ifdef _WIN32
+                    SYSTEM_INFO sysinfo;
+                    GetSystemInfo(&sysinfo);
+                    loop_count = sysinfo.dwNumberOfProcessors;
+#else
+                    loop_count = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+                }
+
+#ifndef SO_REUSEPORT
+                //no kernel load balance between sockets
+                loop_count = 1;
+#endif
+
+                udp_channel::endpoint_type endpoint(boost::asio::ip::address::from_string(ip), port);
+
+                for (uint32_t i = 0; i < std::max(loop_count, (uint32_t)1); i++)
+                {
+                    loop_ptr_type loop = std::make_shared<udp_server_loop>();
+                    m_loops.push_back(loop);
+
+                    if (ERR_SUCCESS != loop->m_pool.init())
+                    {
+                        LOG_ERROR << "udp server init loop failed";
+                        stop();
+                        return ERR_FAILED;
+                    }
+
+                    loop->m_channel = std::make_shared<udp_channel>(&loop->m_pool, endpoint);
+                    loop->m_channel->set_reuse_port(loop_count > 1);
+
+                    if (m_channel_setup)
+                    {
+                        m_channel_setup(loop->m_channel);
+                    }
+
+                    loop->m_channel->channel_initializer(m_inbound_initializer, m_outbound_initializer);
+
+                    if (ERR_SUCCESS != loop->m_channel->init())
+                    {
+                        LOG_ERROR << "udp server init channel failed, port: " << port;
+                        stop();
+                        return ERR_FAILED;
+                    }
+
+                    //loop set up before its thread runs
+                    loop->m_pool.start();
+                    loop->m_running = true;
+                }
+
+                return ERR_SUCCESS;
+            }
+
+            //close sockets on their loops and join loop threads, listen may be called again after
+            //loop of a channel that failed init never ran, its handles are left to process exit
+            void stop()
+            {
+                for (auto &loop : m_loops)
+                {
+                    if (!loop->m_running)
+                    {
+                        continue;
+                    }
+
+                    loop->m_channel->close_async();
+                    loop->m_pool.stop();
+                    loop->m_pool.exit();
+                    loop->m_running = false;
+                }
+
+                m_loops.clear();
+            }
+
+            size_t channel_count() const { return m_loops.size(); }
+
+            //channel of loop idx, to send from a given socket outside handlers
+            std::shared_ptr<udp_channel> get_channel(size_t idx) { return idx < m_loops.size() ? m_loops[idx]->m_channel : nullptr; }
+
+        protected:
+
+            std::vector<loop_ptr_type> m_loops;
+
+            initializer_ptr_type m_inbound_initializer;
+
+            initializer_ptr_type m_outbound_initializer;
+
+            channel_setup_type m_channel_setup;
+
+        };
+
+    }
+
+}
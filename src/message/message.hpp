@@ -4,6 +4,8 @@
 #include <string>
 #include <memory>
 #include <common/common.hpp>
+#include <message/message_pool.hpp>
+#include <message/msg_type_registry.hpp>
 #include <boost/asio.hpp>
 
 
@@ -62,9 +64,9 @@ namespace micro
 
             typedef channel_source channel_type;
 
-            base_header() : m_name(""), m_priority(LOW_PRIORITY) {}
+            base_header() : m_msg_id(INVALID_MSG_ID), m_priority(LOW_PRIORITY) {}
 
-            std::string m_name;
+            uint32_t    m_msg_id;
             uint32_t    m_priority;
 
             channel_type m_src;
@@ -81,23 +83,45 @@ namespace micro
         {
         public:
 
-            typedef std::shared_ptr<base_header> header_ptr_type;
+            //header kept inline with message, pointer style access kept for msg->m_header->xxx
+            class inline_header : public base_header
+            {
+            public:
+
+                base_header * operator->() { return this; }
+
+                const base_header * operator->() const { return this; }
+            };
+
+            typedef inline_header header_type;
             typedef std::shared_ptr<base_body>    body_ptr_type;
 
-            message() : m_header(std::make_shared<base_header>()) {}
+            message() = default;
 
-            virtual std::string get_name() const { return m_header->m_name; }
-            virtual void set_name(const std::string &name) { m_header->m_name = name; }
+            virtual ~message() = default;
+
+            //name resolved from message type registry, for logging
+            virtual const std::string & get_name() const { return MSG_TYPE_REGISTRY.name(m_header->m_msg_id); }
+            virtual void set_name(const std::string &name) { m_header->m_msg_id = MSG_TYPE_REGISTRY.cached_intern(name); }
+
+            virtual uint32_t get_msg_id() const { return m_header->m_msg_id; }
+            virtual void set_msg_id(uint32_t msg_id) { m_header->m_msg_id = msg_id; }
 
             virtual uint32_t get_priority() const { return m_header->m_priority; }
             virtual void set_priority(uint32_t priority) { m_header->m_priority = priority; }
 
             virtual boost::asio::ip::udp::endpoint get_dst_endpoint() {return m_header->m_dst.m_endpoint; }
 
-            header_ptr_type m_header;
+            header_type m_header;
             body_ptr_type     m_body;
         };
 
+        //message and its ref count allocated in one block from calling thread free list
+        inline std::shared_ptr<message> make_message()
+        {
+            return make_pooled<message>();
+        }
+
     }
 
 }
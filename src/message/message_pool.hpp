@@ -0,0 +1,369 @@
+#pragma once
+
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+
+#define MSG_POOL_CLASS_GRANULARITY             64                                   //size class step
+#define MSG_POOL_SIZE_CLASS_COUNT              8                                    //64, 128 ... 512 bytes, header included
+#define MSG_POOL_MAX_FREE_BLOCKS               4096                                 //per size class per thread
+#define MSG_POOL_HEADER_SIZE                   16                                   //keeps max_align_t alignment of block body
+#define MSG_POOL_ABANDONED                     ((uintptr_t)1)                       //remote list tag: owner thread exited
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        class pool_owner;
+
+        //header in front of every pooled block, owner null: plain heap block
+        class pool_block
+        {
+        public:
+
+            pool_block *m_next;
+
+            pool_owner *m_owner;
+
+            static pool_block * of(void *p) { return reinterpret_cast<pool_block *>(static_cast<char *>(p) - MSG_POOL_HEADER_SIZE); }
+
+            void * body() { return reinterpret_cast<char *>(this) + MSG_POOL_HEADER_SIZE; }
+        };
+
+        static_assert(sizeof(pool_block) <= MSG_POOL_HEADER_SIZE, "pool block header too large");
+
+        //free list state of one owning thread shared with releasing threads
+        //blocks released on other threads are pushed to m_remote (mpsc) and drained by owner on allocate
+        //owner exit tags m_remote abandoned, later releases go to heap and the last one frees the owner
+        class pool_owner
+        {
+        public:
+
+            pool_owner() : m_remote(0), m_pending(0) {}
+
+            //releasing thread, false: owner exited, caller frees block and calls settle(owner, -1)
+            bool push(pool_block *block)
+            {
+                uintptr_t head = m_remote.load(std::memory_order_relaxed);
+                do
+                {
+                    if (head & MSG_POOL_ABANDONED)
+                    {
+                        return false;
+                    }
+
+                    block->m_next = reinterpret_cast<pool_block *>(head);
+                } while (!m_remote.compare_exchange_weak(head, reinterpret_cast<uintptr_t>(block), std::memory_order_release, std::memory_order_relaxed));
+
+                return true;
+            }
+
+            //owner thread
+            pool_block * drain()
+            {
+                if (0 == m_remote.load(std::memory_order_relaxed))
+                {
+                    return nullptr;
+                }
+
+                return reinterpret_cast<pool_block *>(m_remote.exchange(0, std::memory_order_acquire));
+            }
+
+            //owner thread exit, returns blocks released before; no push succeeds after
+            pool_block * abandon()
+            {
+                return reinterpret_cast<pool_block *>(m_remote.exchange(MSG_POOL_ABANDONED, std::memory_order_acquire));
+            }
+
+            //owner adds blocks still held elsewhere at exit, releasing threads subtract one per abandoned block
+            static void settle(pool_owner *owner, int64_t count)
+            {
+                if (owner->m_pending.fetch_add(count, std::memory_order_acq_rel) + count == 0)
+                {
+                    delete owner;
+                }
+            }
+
+        protected:
+
+            std::atomic<uintptr_t> m_remote;
+
+            std::atomic<int64_t> m_pending;
+        };
+
+        //owner side of a per thread pool: remote list owner and blocks handed out, shared by thread_freelist and http_object_pool
+        //releasing thread: own block back to local free list, others through release_remote
+        class pool_home
+        {
+        public:
+
+            pool_home() : m_owner(new pool_owner()), m_outstanding(0) {}
+
+            pool_home(const pool_home &) = delete;
+
+            pool_home & operator=(const pool_home &) = delete;
+
+            pool_owner * owner() const { return m_owner; }
+
+            void taken() { m_outstanding++; }
+
+            void returned() { m_outstanding--; }
+
+            //blocks released by other threads since last drain
+            template<typename put_type>
+            void drain(put_type put)
+            {
+                for (pool_block *block = m_owner->drain(); nullptr != block; )
+                {
+                    pool_block *next = block->m_next;
+
+                    m_outstanding--;
+                    put(block);
+
+                    block = next;
+                }
+            }
+
+            //owner thread exit: blocks released meanwhile disposed, owner freed by last release of blocks still out
+            template<typename dispose_type>
+            void close(dispose_type dispose)
+            {
+                for (pool_block *block = m_owner->abandon(); nullptr != block; )
+                {
+                    pool_block *next = block->m_next;
+
+                    m_outstanding--;
+                    dispose(block);
+
+                    block = next;
+                }
+
+                pool_owner::settle(m_owner, m_outstanding);
+            }
+
+            //block of another thread, or any block once pool of releasing thread is gone
+            template<typename dispose_type>
+            static void release_remote(pool_block *block, dispose_type dispose)
+            {
+                pool_owner *owner = block->m_owner;
+                if (!owner->push(block))
+                {
+                    dispose(block);
+                    pool_owner::settle(owner, -1);
+                }
+            }
+
+        protected:
+
+            pool_owner *m_owner;
+
+            int64_t m_outstanding;                          //blocks of this thread held by callers or waiting in remote list
+        };
+
+        //pool P of calling thread, nullptr once destroyed at thread exit
+        //gone flag is a trivially destructible thread local, still readable from destructors of thread locals that outlive the pool
+        template<typename P>
+        class thread_local_pool
+        {
+        public:
+
+            static P * get()
+            {
+                if (gone())
+                {
+                    return nullptr;
+                }
+
+                static thread_local holder pool_holder;
+                return &pool_holder.m_pool;
+            }
+
+        protected:
+
+            class holder
+            {
+            public:
+
+                //releases while pool is torn down already take the remote path
+                ~holder() { gone() = true; }
+
+                P m_pool;
+            };
+
+            static bool & gone()
+            {
+                static thread_local bool flag = false;
+                return flag;
+            }
+        };
+
+        //per thread free lists of fixed size blocks, blocks are returned to the list of the allocating thread
+        class thread_freelist
+        {
+        public:
+
+            thread_freelist()
+            {
+                for (uint32_t i = 0; i < MSG_POOL_SIZE_CLASS_COUNT; i++)
+                {
+                    m_heads[i] = nullptr;
+                    m_counts[i] = 0;
+                }
+            }
+
+            ~thread_freelist()
+            {
+                for (uint32_t i = 0; i < MSG_POOL_SIZE_CLASS_COUNT; i++)
+                {
+                    while (nullptr != m_heads[i])
+                    {
+                        pool_block *block = m_heads[i];
+                        m_heads[i] = block->m_next;
+                        ::operator delete(block);
+                    }
+
+                    m_counts[i] = 0;
+                }
+
+                m_home.close([](pool_block *block) { ::operator delete(block); });
+            }
+
+            static void * allocate(size_t size)
+            {
+                uint32_t idx = size_class(size);
+                thread_freelist *local = idx < MSG_POOL_SIZE_CLASS_COUNT ? thread_local_pool<thread_freelist>::get() : nullptr;
+                if (nullptr == local)
+                {
+                    return heap_block(size + MSG_POOL_HEADER_SIZE, nullptr)->body();
+                }
+
+                return local->take(idx);
+            }
+
+            static void deallocate(void *p, size_t size)
+            {
+                pool_block *block = pool_block::of(p);
+                if (nullptr == block->m_owner)
+                {
+                    ::operator delete(block);
+                    return;
+                }
+
+                uint32_t idx = size_class(size);
+                thread_freelist *local = thread_local_pool<thread_freelist>::get();
+                if (nullptr == local || block->m_owner != local->m_home.owner())
+                {
+                    //size class travels in freed body, owner drains blocks of all classes from one list
+                    *static_cast<uint32_t *>(p) = idx;
+                    pool_home::release_remote(block, [](pool_block *block) { ::operator delete(block); });
+                    return;
+                }
+
+                local->m_home.returned();
+                local->put_local(block, idx);
+            }
+
+        protected:
+
+            void * take(uint32_t idx)
+            {
+                if (nullptr == m_heads[idx])
+                {
+                    m_home.drain([this](pool_block *block) { put_local(block, *static_cast<uint32_t *>(block->body())); });
+                }
+
+                m_home.taken();
+
+                pool_block *block = m_heads[idx];
+                if (nullptr == block)
+                {
+                    return heap_block(class_size(idx), m_home.owner())->body();
+                }
+
+                m_heads[idx] = block->m_next;
+                m_counts[idx]--;
+
+                return block->body();
+            }
+
+            void put_local(pool_block *block, uint32_t idx)
+            {
+                if (m_counts[idx] >= MSG_POOL_MAX_FREE_BLOCKS)
+                {
+                    ::operator delete(block);
+                    return;
+                }
+
+                block->m_next = m_heads[idx];
+                m_heads[idx] = block;
+                m_counts[idx]++;
+            }
+
+            static pool_block * heap_block(size_t size, pool_owner *owner)
+            {
+                pool_block *block = static_cast<pool_block *>(::operator new(size));
+                block->m_next = nullptr;
+                block->m_owner = owner;
+
+                return block;
+            }
+
+            static uint32_t size_class(size_t size) { return (uint32_t)((size + MSG_POOL_HEADER_SIZE - 1) / MSG_POOL_CLASS_GRANULARITY); }
+
+            static size_t class_size(uint32_t idx) { return (size_t)(idx + 1) * MSG_POOL_CLASS_GRANULARITY; }
+
+        protected:
+
+            pool_home m_home;
+
+            pool_block * m_heads[MSG_POOL_SIZE_CLASS_COUNT];
+
+            size_t m_counts[MSG_POOL_SIZE_CLASS_COUNT];
+
+        };
+
+        //allocator for allocate_shared: object and its ref count share one block from thread free list
+        template<typename T>
+        class pool_allocator
+        {
+        public:
+
+            typedef T value_type;
+
+            pool_allocator() = default;
+
+            template<typename U>
+            pool_allocator(const pool_allocator<U> &) {}
+
+            T * allocate(size_t n)
+            {
+                return static_cast<T *>(thread_freelist::allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T *p, size_t n)
+            {
+                thread_freelist::deallocate(p, n * sizeof(T));
+            }
+
+            template<typename U>
+            bool operator==(const pool_allocator<U> &) const { return true; }
+
+            template<typename U>
+            bool operator!=(const pool_allocator<U> &) const { return false; }
+        };
+
+        template<typename T, typename... args_type>
+        std::shared_ptr<T> make_pooled(args_type&&... args)
+        {
+            return std::allocate_shared<T>(pool_allocator<T>(), std::forward<args_type>(args)...);
+        }
+
+    }
+
+}
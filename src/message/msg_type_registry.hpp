@@ -0,0 +1,117 @@
+#pragma once
+
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/serialization/singleton.hpp>
+#include <thread/lock.hpp>
+#include <logger/logger.hpp>
+
+
+#define MSG_TYPE_REGISTRY boost::serialization::singleton<micro::core::msg_type_registry>::get_mutable_instance()
+
+//interned once per call site, MSG_NAME should be a constant
+#define MSG_TYPE_ID(MSG_NAME) ([]() -> uint32_t { static const uint32_t msg_id = MSG_TYPE_REGISTRY.intern(MSG_NAME); return msg_id; }())
+
+#define INVALID_MSG_ID                          0
+#define MAX_MSG_TYPE_COUNT                      4096
+
+
+namespace micro
+{
+    namespace core
+    {
+
+        //message name <--> dense integer id, names are kept for logging only
+        class msg_type_registry
+        {
+        public:
+
+            typedef std::unordered_map<std::string, uint32_t> ids_type;
+
+            msg_type_registry() : m_names(MAX_MSG_TYPE_COUNT), m_count(INVALID_MSG_ID + 1) {}
+
+            uint32_t intern(const std::string &name)
+            {
+                {
+                    r_lock_guard lock_guard(m_mutex);
+                    auto it = m_ids.find(name);
+                    if (it != m_ids.end())
+                    {
+                        return it->second;
+                    }
+                }
+
+                w_lock_guard lock_guard(m_mutex);
+
+                auto it = m_ids.find(name);
+                if (it != m_ids.end())
+                {
+                    return it->second;
+                }
+
+                //id 0 would alias every unset message, raise MAX_MSG_TYPE_COUNT instead
+                uint32_t msg_id = m_count.load(std::memory_order_relaxed);
+                if (msg_id >= MAX_MSG_TYPE_COUNT)
+                {
+                    LOG_ERROR << "message type registry full, could not intern: " << name;
+                    throw std::runtime_error("message type registry full: " + name);
+                }
+
+                //names never move, published to lock free readers by count
+                m_names[msg_id] = name;
+                m_ids.insert({ name, msg_id });
+                m_count.store(msg_id + 1, std::memory_order_release);
+
+                return msg_id;
+            }
+
+            //runtime names, e.g. set_name: per thread cache in front of intern, no shared lock after first use
+            uint32_t cached_intern(const std::string &name)
+            {
+                static thread_local ids_type cache;
+
+                auto it = cache.find(name);
+                if (it != cache.end())
+                {
+                    return it->second;
+                }
+
+                uint32_t msg_id = intern(name);
+                cache.insert({ name, msg_id });
+
+                return msg_id;
+            }
+
+            uint32_t find(const std::string &name)
+            {
+                r_lock_guard lock_guard(m_mutex);
+                auto it = m_ids.find(name);
+                return it == m_ids.end() ? INVALID_MSG_ID : it->second;
+            }
+
+            const std::string & name(uint32_t msg_id) const
+            {
+                return msg_id < m_count.load(std::memory_order_acquire) ? m_names[msg_id] : m_names[INVALID_MSG_ID];
+            }
+
+            uint32_t size() const { return m_count.load(std::memory_order_acquire); }
+
+        protected:
+
+            rw_mutex m_mutex;
+
+            ids_type m_ids;
+
+            std::vector<std::string> m_names;
+
+            std::atomic<uint32_t> m_count;
+
+        };
+
+    }
+
+}
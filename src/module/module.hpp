@@ -4,6 +4,8 @@
 #include <mutex>
 #include <queue>
 #include <memory>
+#include <vector>
+#include <iterator>
 #include <unordered_map>
 #include <module/base_module.hpp>
 #include <message/message.hpp>
@@ -17,10 +19,12 @@
 #include <bus/message_bus.hpp>
 #include <module/multi_priority_queue.hpp>
 #include <common/core_macro.h>
+#include <common/metrics.hpp>
 
 
 #define MAX_MSG_COUNT                   5000000
 #define MAX_TRIGGER_TIMES               0xFFFFFFFFFFFFFFFF
+#define MODULE_POP_MSG_COUNT            64
 
 
 #define INIT_TIMER(TIMER_ID, TIMER_NAME, PERIOD, REPEAT_TIMES, SESSION_ID, FUNC_PTR) \
@@ -30,7 +34,8 @@
 
 #define INIT_INVOKER(MSG_NAME, FUNC_PTR) \
     MSG_BUS_SUB(MSG_NAME, [this](std::shared_ptr<message> &msg) { return send(msg);  }); \
-    m_msg_invokers[MSG_NAME] = std::bind(FUNC_PTR, this, std::placeholders::_1);
+    MSG_BUS_SUB(MSG_NAME, [this](const std::vector<std::shared_ptr<message>> &msgs) { return send(msgs);  }); \
+    this->register_msg_invoker(MSG_NAME, std::bind(FUNC_PTR, this, std::placeholders::_1));
 
 namespace micro
 {
@@ -64,6 +69,7 @@ namespace micro
                 timer_ptr_type timer = std::make_shared<micro::core::timer>(name, period, trigger_times, session_id);
                 timer->set_timer_id(++m_timer_idx);
                 m_timers.push_back(timer);
+                timer_metrics::instance().m_added.add();
 
                 return timer->get_timer_id();
             }
@@ -75,6 +81,7 @@ namespace micro
                     if (timer_id == (*it)->get_timer_id())
                     {
                         m_timers.erase(it);
+                        timer_metrics::instance().m_removed.add();
                         return;
                     }
                 }
@@ -93,6 +100,7 @@ namespace micro
                     {
                         //callback timer function
                         timer_func(m_mdl, timer);
+                        timer_metrics::instance().m_fired.add();
 
                         timer->minus_trigger_times();
                         if (0 == timer->get_trigger_times())
@@ -116,7 +124,11 @@ namespace micro
                 return ERR_SUCCESS;
             }
 
-            void clear() { m_timers.clear(); }
+            void clear()
+            {
+                timer_metrics::instance().m_removed.add(m_timers.size());
+                m_timers.clear();
+            }
 
         protected:
 
@@ -147,7 +159,7 @@ namespace micro
             typedef std::shared_ptr<timer_processor> timer_processor_type;
             typedef std::shared_ptr<session> session_ptr_type;
 
-            typedef std::unordered_map<std::string, msg_functor_type> msg_functors_type;
+            typedef std::vector<msg_functor_type> msg_functors_type;                          //indexed by message id
             typedef std::unordered_map<std::string, timer_functor_type> timer_functors_type;
             typedef std::unordered_map<std::string, session_ptr_type> sessions_type;
 
@@ -158,12 +170,20 @@ namespace micro
                 , m_timer_processor(std::make_shared<timer_processor>(this))
                 , m_send_queue(std::make_shared<multi_priority_queue<msg_ptr_type>>())
                 , m_worker_queue(std::make_shared<multi_priority_queue<msg_ptr_type>>())
+                , m_timer_tick_msg_id(MSG_TYPE_REGISTRY.intern(BROADCAST_TIMER_TICK))
             {}
 
-            virtual ~module() = default;
+            virtual ~module()
+            {
+                for (auto id : m_metrics_gauges)
+                {
+                    METRICS.remove_gauge(id);
+                }
+            }
 
             virtual int32_t init(any_map &vars)
             {
+                init_metrics();
                 init_timer();
                 init_invoker();
                 init_time_tick_subscription();
@@ -205,10 +225,14 @@ namespace micro
 
             virtual int32_t run()
             {
-                msg_ptr_type msg;
+                std::vector<msg_ptr_type> msgs;
+                msgs.reserve(MODULE_POP_MSG_COUNT);
 
                 while (!m_exited)
                 {
+                    //async publish of handlers delivered once per batch, and on wait timeout
+                    MSG_BUS_FLUSH();
+
                     {
                         std::unique_lock<std::mutex> lock(m_mutex);
                         std::chrono::milliseconds ms(100);
@@ -225,17 +249,23 @@ namespace micro
 
                     while (!m_worker_queue->empty())
                     {
-                        msg = m_worker_queue->front();
-                        m_worker_queue->pop();
+                        m_worker_queue->pop(std::back_inserter(msgs), MODULE_POP_MSG_COUNT);
 
-                        try
-                        {
-                            on_invoke(msg);
-                        }
-                        catch (...)
+                        for (auto &msg : msgs)
                         {
-                            LOG_ERROR << "!!!!!! module on invoke exception: " << this->name() << " msg name: " << msg->get_name();
+                            count_mailbox(m_mailbox_out, msg);
+
+                            try
+                            {
+                                on_invoke(msg);
+                            }
+                            catch (...)
+                            {
+                                LOG_ERROR << "!!!!!! module on invoke exception: " << this->name() << " msg name: " << msg->get_name();
+                            }
                         }
+
+                        msgs.clear();
                     }
 
                 }
@@ -269,7 +299,14 @@ namespace micro
                     //return ERR_FAILED;
                 }
 
-                m_send_queue->push(msg, msg->m_header->m_priority);
+                if (ERR_SUCCESS != m_send_queue->push(msg, msg->m_header->m_priority))
+                {
+                    LOG_ERROR << "module message priority out of range: " << this->name() << " send msg: " << msg->get_name()
+                        << " priority: " << msg->m_header->m_priority;
+                    return ERR_FAILED;
+                }
+
+                count_mailbox(m_mailbox_in, msg);
 
                 if (!m_send_queue->empty())
                 {
@@ -279,13 +316,51 @@ namespace micro
                 return ERR_SUCCESS;
             }
 
+            //batch send from message bus async publish, one lock and one notify for all messages
+            int32_t send(const std::vector<std::shared_ptr<message>> &msgs)
+            {
+                if (msgs.empty())
+                {
+                    return ERR_SUCCESS;
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if (m_send_queue->size() >= MAX_MSG_COUNT)
+                {
+                    BEGIN_COUNT_TO_DO(MSG_QUEUE, 100000)
+                    LOG_WARNING << "module message queue overloaded: " << this->name() << " batch send msg count: " << std::to_string(msgs.size())
+                        << " send queue size: " << std::to_string(m_send_queue->size())
+                        << " worker queue size: " << std::to_string(m_worker_queue->size());
+                    END_COUNT_TO_DO
+                }
+
+                int32_t ret = ERR_SUCCESS;
+                for (auto &msg : msgs)
+                {
+                    if (ERR_SUCCESS != m_send_queue->push(msg, msg->m_header->m_priority))
+                    {
+                        LOG_ERROR << "module message priority out of range: " << this->name() << " send msg: " << msg->get_name()
+                            << " priority: " << msg->m_header->m_priority;
+                        ret = ERR_FAILED;
+                        continue;
+                    }
+
+                    count_mailbox(m_mailbox_in, msg);
+                }
+
+                m_cv.notify_all();
+
+                return ret;
+            }
+
             bool is_empty() const { return m_send_queue->empty(); }
 
         protected:
 
             virtual int32_t on_invoke(msg_ptr_type msg)
             {
-                if (msg->get_name() == BROADCAST_TIMER_TICK)
+                if (msg->get_msg_id() == m_timer_tick_msg_id)
                 {
                     return on_timer_invoke(msg);
                 }
@@ -297,14 +372,14 @@ namespace micro
 
             int32_t on_msg_invoke(msg_ptr_type msg)
             {
-                auto it = m_msg_invokers.find(msg->get_name());
-                if (it == m_msg_invokers.end())
+                uint32_t msg_id = msg->get_msg_id();
+                if (msg_id >= m_msg_invokers.size() || !m_msg_invokers[msg_id])
                 {
                     LOG_ERROR << this->name() << " unknown message: " << msg->get_name();
                     return ERR_FAILED;
                 }
 
-                return (it->second)(msg);
+                return m_msg_invokers[msg_id](msg);
             }
 
             int32_t on_timer_invoke(msg_ptr_type msg)
@@ -324,6 +399,48 @@ namespace micro
 
             virtual void init_timer() {}
 
+            void register_msg_invoker(const std::string &msg_name, msg_functor_type functor)
+            {
+                uint32_t msg_id = MSG_TYPE_REGISTRY.intern(msg_name);
+                if (msg_id >= m_msg_invokers.size())
+                {
+                    m_msg_invokers.resize(msg_id + 1);
+                }
+
+                m_msg_invokers[msg_id] = functor;
+            }
+
+            //mailbox depth per priority = pushed - popped, counted lock free and sampled on export
+            void init_metrics()
+            {
+                std::string module = "module=\"" + metrics_registry::escape(name()) + "\"";
+
+                for (uint32_t i = 0; i < m_send_queue->priority_count(); i++)
+                {
+                    std::string labels = module + ",priority=\"" + std::to_string(i) + "\"";
+
+                    metrics_counter *in = &METRICS_COUNTER("micro_module_mailbox_in_total", "Messages pushed to module mailbox.", labels);
+                    metrics_counter *out = &METRICS_COUNTER("micro_module_mailbox_out_total", "Messages popped from module mailbox.", labels);
+
+                    m_mailbox_in.push_back(in);
+                    m_mailbox_out.push_back(out);
+
+                    m_metrics_gauges.push_back(METRICS_GAUGE("micro_module_mailbox_depth", "Messages waiting in module mailbox.", labels, [in, out]()
+                    {
+                        return (double)in->value() - (double)out->value();
+                    }));
+                }
+            }
+
+            static void count_mailbox(const std::vector<metrics_counter *> &counters, const msg_ptr_type &msg)
+            {
+                uint32_t priority = msg->m_header->m_priority;
+                if (!counters.empty())
+                {
+                    counters[priority < counters.size() ? priority : counters.size() - 1]->add();
+                }
+            }
+
             virtual void init_time_tick_subscription()
             {
                 MSG_BUS_SUB(BROADCAST_TIMER_TICK, [this](std::shared_ptr<message> &msg) {return this->send(msg); });
@@ -380,12 +497,20 @@ namespace micro
 
             timer_processor_type m_timer_processor;
 
+            uint32_t m_timer_tick_msg_id;
+
             msg_functors_type m_msg_invokers;
 
             timer_functors_type m_timer_invokers;
 
             sessions_type m_sessions;
 
+            std::vector<metrics_counter *> m_mailbox_in;            //by priority
+
+            std::vector<metrics_counter *> m_mailbox_out;
+
+            std::vector<metrics_registry::gauge_id_type> m_metrics_gauges;
+
         };
 
     }
@@ -1,10 +1,19 @@
 #pragma once
 
-#include <queue>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <common/error.hpp>
 #include <message/message.hpp>
 
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
 
 #define DEFAULT_PRIORITY_COUNT      3
+#define MAX_PRIORITY_COUNT          64
+#define RING_CHUNK_SIZE             64                  //elements per ring chunk
 
 
 namespace micro
@@ -12,6 +21,7 @@ namespace micro
     namespace core
     {
 
+        //one chunked ring per priority, non-empty priorities tracked in bit mask
         template<typename T>
         class multi_priority_queue
         {
@@ -25,102 +35,266 @@ namespace micro
 
             typedef size_t size_type;
 
-            multi_priority_queue(uint32_t priority_count = DEFAULT_PRIORITY_COUNT) 
-                : m_priority_count(priority_count < DEFAULT_PRIORITY_COUNT ? DEFAULT_PRIORITY_COUNT : priority_count)
+            //priority count kept within DEFAULT_PRIORITY_COUNT and MAX_PRIORITY_COUNT (mask width), push beyond it fails
+            multi_priority_queue(uint32_t priority_count = DEFAULT_PRIORITY_COUNT)
+                : m_priority_count(priority_count < DEFAULT_PRIORITY_COUNT ? DEFAULT_PRIORITY_COUNT : (priority_count > MAX_PRIORITY_COUNT ? MAX_PRIORITY_COUNT : priority_count))
+                , m_mask(0)
+                , m_size(0)
+                , m_rings(m_priority_count)
             {
-                m_queues = new std::queue<T> *[m_priority_count];
-                for (uint32_t i = 0; i < m_priority_count; i++)
-                {
-                    m_queues[i] = new std::queue<T>();
-                }
             }
 
-            ~multi_priority_queue()
+            ~multi_priority_queue() = default;
+
+            bool empty() const { return 0 == m_mask; }
+
+            size_type size() const { return m_size; }
+
+            uint32_t priority_count() const { return m_priority_count; }
+
+            //size of one priority
+            size_type size(uint32_t priority) const { return priority < m_priority_count ? m_rings[priority].size() : 0; }
+
+            //ERR_FAILED: priority out of range, value not queued
+            int32_t push(const value_type& value, uint32_t priority = LOW_PRIORITY)
             {
-                for (uint32_t i = 0; i < m_priority_count; i++)
+                if (priority >= m_priority_count)
                 {
-                    //m_queues[i]->clear();
-                    delete m_queues[i];
+                    return ERR_FAILED;
                 }
-                delete [] m_queues;
+
+                m_rings[priority].push(value);
+                m_mask |= (1ULL << priority);
+                m_size++;
+
+                return ERR_SUCCESS;
             }
 
-            bool empty() const
+            int32_t push(value_type&& value, uint32_t priority = LOW_PRIORITY)
             {
-                for (uint32_t i = 0; i < m_priority_count; i++)
+                if (priority >= m_priority_count)
                 {
-                    if (!m_queues[i]->empty())
-                    {
-                        return false;
-                    }
+                    return ERR_FAILED;
                 }
-                return true;
+
+                m_rings[priority].push(std::move(value));
+                m_mask |= (1ULL << priority);
+                m_size++;
+
+                return ERR_SUCCESS;
             }
 
-            size_type size() const
+            reference front()
             {
-                size_type total_size = 0;
-                for (uint32_t i = 0; i < m_priority_count; i++)
+                if (empty())
                 {
-                    total_size += m_queues[i]->size();
+                    throw std::runtime_error("multi priority queue front error: queue empty");
                 }
-                return total_size;
+
+                return m_rings[top_priority()].front();
             }
 
-            void push(const value_type& value, uint32_t priority = LOW_PRIORITY)
+            const_reference front() const
             {
-                assert(priority < m_priority_count);
-                m_queues[priority]->push(value);
+                if (empty())
+                {
+                    throw std::runtime_error("multi priority queue front error: queue empty");
+                }
+
+                return m_rings[top_priority()].front();
             }
 
-            void push(value_type&& value, uint32_t priority = LOW_PRIORITY)
+            void pop()
             {
-                assert(priority < m_priority_count);
-                m_queues[priority]->push(value);
+                if (empty())
+                {
+                    return;
+                }
+
+                uint32_t priority = top_priority();
+                m_rings[priority].pop();
+                m_size--;
+
+                if (m_rings[priority].empty())
+                {
+                    m_mask &= ~(1ULL << priority);
+                }
             }
 
-            reference front()
+            //move up to n elements to out in priority order, return moved count
+            template<typename output_iterator>
+            size_type pop(output_iterator out, size_type n)
             {
-                for (uint32_t i = 0; i < m_priority_count; i++)
+                size_type count = 0;
+
+                while (count < n && !empty())
                 {
-                    if (!m_queues[i]->empty())
+                    uint32_t priority = top_priority();
+                    ring &r = m_rings[priority];
+
+                    while (count < n && !r.empty())
                     {
-                        return m_queues[i]->front();
+                        *out++ = std::move(r.front());
+                        r.pop();
+                        count++;
+                    }
+
+                    if (r.empty())
+                    {
+                        m_mask &= ~(1ULL << priority);
                     }
                 }
 
-                throw new std::runtime_error("multi priority queue fron error");
+                m_size -= count;
+                return count;
             }
 
-            const_reference front() const
+        protected:
+
+            //fixed size chunks linked head to tail: growing allocates one chunk and copies nothing,
+            //drained chunks are freed so ring shrinks back after burst, one spare kept for steady traffic
+            class ring
             {
-                for (uint32_t i = 0; i < m_priority_count; i++)
+            public:
+
+                ring() : m_head(nullptr), m_tail(nullptr), m_spare(nullptr), m_begin(0), m_end(0), m_size(0) {}
+
+                ~ring()
                 {
-                    if (!m_queues[i]->empty())
+                    while (nullptr != m_head)
                     {
-                        return m_queues[i]->front();
+                        chunk *next = m_head->m_next;
+                        delete m_head;
+                        m_head = next;
                     }
+
+                    delete m_spare;
                 }
 
-                throw new std::runtime_error("multi priority queue fron error");
-            }
+                ring(const ring &) = delete;
 
-            void pop()
-            {
-                for (uint32_t i = 0; i < m_priority_count; i++)
+                ring & operator=(const ring &) = delete;
+
+                bool empty() const { return 0 == m_size; }
+
+                size_type size() const { return m_size; }
+
+                template<typename U>
+                void push(U&& value)
                 {
-                    if (!m_queues[i]->empty())
+                    if (nullptr == m_tail || RING_CHUNK_SIZE == m_end)
                     {
-                        return m_queues[i]->pop();
+                        add_chunk();
                     }
+
+                    m_tail->m_items[m_end++] = std::forward<U>(value);
+                    m_size++;
+                }
+
+                reference front() { return m_head->m_items[m_begin]; }
+
+                const_reference front() const { return m_head->m_items[m_begin]; }
+
+                void pop()
+                {
+                    m_head->m_items[m_begin++] = value_type();      //release element now
+                    m_size--;
+
+                    if (RING_CHUNK_SIZE == m_begin || 0 == m_size)
+                    {
+                        remove_chunk();
+                    }
+                }
+
+            protected:
+
+                class chunk
+                {
+                public:
+
+                    value_type m_items[RING_CHUNK_SIZE];
+
+                    chunk *m_next = nullptr;
+                };
+
+                void add_chunk()
+                {
+                    chunk *c = (nullptr != m_spare) ? m_spare : new chunk();
+                    m_spare = nullptr;
+                    c->m_next = nullptr;
+
+                    if (nullptr == m_tail)
+                    {
+                        m_head = c;
+                        m_begin = 0;
+                    }
+                    else
+                    {
+                        m_tail->m_next = c;
+                    }
+
+                    m_tail = c;
+                    m_end = 0;
                 }
+
+                //head chunk drained
+                void remove_chunk()
+                {
+                    chunk *c = m_head;
+                    m_head = c->m_next;
+                    m_begin = 0;
+
+                    if (nullptr == m_head)
+                    {
+                        m_tail = nullptr;
+                        m_end = 0;
+                    }
+
+                    if (nullptr == m_spare)
+                    {
+                        m_spare = c;
+                    }
+                    else
+                    {
+                        delete c;
+                    }
+                }
+
+            protected:
+
+                chunk *m_head;
+
+                chunk *m_tail;
+
+                chunk *m_spare;
+
+                size_type m_begin;                              //next element in head chunk
+
+                size_type m_end;                                //next free slot in tail chunk
+
+                size_type m_size;
+            };
+
+            uint32_t top_priority() const
+            {
+#ifdef _WIN32
+                unsigned long idx = 0;
+                _BitScanForward64(&idx, m_mask);
+                return (uint32_t)idx;
+#else
+                return (uint32_t)__builtin_ctzll(m_mask);
+#endif
             }
 
         protected:
 
             const uint32_t m_priority_count;
 
-            std::queue<T> ** m_queues;           //0-->top priority, 1, 2-->less priority
+            uint64_t m_mask;                            //bit i set: priority i not empty, 0-->top priority
+
+            size_type m_size;
+
+            std::vector<ring> m_rings;
         };
 
     }
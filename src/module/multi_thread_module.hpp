@@ -4,6 +4,7 @@
 #include <mutex>
 #include <queue>
 #include <memory>
+#include <vector>
 #include <unordered_map>
 #include <algorithm>
 #include <module/base_module.hpp>
@@ -12,6 +13,7 @@
 #include <logger/logger.hpp>
 #include <common/common.hpp>
 #include <common/core_macro.h>
+#include <bus/message_bus.hpp>
 
 
 #define WORKER_THREAD_COUNT                             10
@@ -41,7 +43,7 @@ namespace micro
             typedef std::shared_ptr<message> msg_ptr_type;
             typedef std::queue<std::shared_ptr<message>> queue_type;
             typedef std::function<int32_t(msg_ptr_type)> msg_functor_type;
-            typedef std::unordered_map<std::string, msg_functor_type> msg_functors_type;
+            typedef std::vector<msg_functor_type> msg_functors_type;                          //indexed by message id
 
 
             worker_thread(uint32_t thread_idx)
@@ -113,7 +115,13 @@ namespace micro
 
             void register_msg_functor(const std::string & msg_name, msg_functor_type functor)
             {
-                m_msg_invokers[msg_name] = functor;
+                uint32_t msg_id = MSG_TYPE_REGISTRY.intern(msg_name);
+                if (msg_id >= m_msg_invokers.size())
+                {
+                    m_msg_invokers.resize(msg_id + 1);
+                }
+
+                m_msg_invokers[msg_id] = functor;
             }
 
             int32_t run()
@@ -127,6 +135,8 @@ namespace micro
 
                 while (!m_exited)
                 {
+                    //async publish of handlers delivered once per batch, and on wait timeout
+                    MSG_BUS_FLUSH();
 
                     {
                         std::unique_lock<std::mutex> lock(m_mutex);
@@ -173,14 +183,14 @@ namespace micro
 
             int32_t on_msg_invoke(msg_ptr_type msg)
             {
-                auto it = m_msg_invokers.find(msg->get_name());
-                if (it == m_msg_invokers.end())
+                uint32_t msg_id = msg->get_msg_id();
+                if (msg_id >= m_msg_invokers.size() || !m_msg_invokers[msg_id])
                 {
                     LOG_ERROR << this->name() << " unknown message: " << msg->get_name();
                     return ERR_FAILED;
                 }
 
-                return (it->second)(msg);
+                return m_msg_invokers[msg_id](msg);
             }
 
             virtual std::string name() const { return "thread woker"; };
@@ -1,8 +1,23 @@
 #pragma once
 
 
+#include <new>
 #include <mutex>
+#include <atomic>
+#include <thread>
 #include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+#define CACHE_LINE_SIZE                 64
+#define RW_MUTEX_STRIPE_COUNT           16
+#define RW_MUTEX_SPIN_COUNT             64
+#define RW_MUTEX_WRITER_SPIN_COUNT      256                 //drain checks before writer parks
 
 
 namespace micro
@@ -10,64 +25,234 @@ namespace micro
     namespace core
     {
 
+        //small number of calling thread handed out round robin on first use, picks stripe / shard of striped counters
+        inline uint32_t thread_slot_idx()
+        {
+            static std::atomic<uint32_t> next_idx(0);
+            static thread_local uint32_t idx = next_idx.fetch_add(1, std::memory_order_relaxed);
+            return idx;
+        }
+
+        //heap allocator for types with alignas(CACHE_LINE_SIZE) members, plain operator new guarantees alignment only from c++17
+        template<typename T>
+        class cache_aligned_allocator
+        {
+        public:
+
+            typedef T value_type;
+
+            cache_aligned_allocator() = default;
+
+            template<typename U>
+            cache_aligned_allocator(const cache_aligned_allocator<U> &) {}
+
+            T * allocate(size_t n)
+            {
+                size_t align = alignof(T) > CACHE_LINE_SIZE ? alignof(T) : CACHE_LINE_SIZE;
+                size_t size = (n * sizeof(T) + align - 1) / align * align;
+                void *p = nullptr;
+
+#ifdef _WIN32
+                p = _aligned_malloc(size, align);
+#else
+                if (0 != posix_memalign(&p, align, size))
+                {
+                    p = nullptr;
+                }
+#endif
+
+                if (nullptr == p)
+                {
+                    throw std::bad_alloc();
+                }
+
+                return static_cast<T *>(p);
+            }
+
+            void deallocate(T *p, size_t n)
+            {
+#ifdef _WIN32
+                _aligned_free(p);
+#else
+                free(p);
+#endif
+            }
+
+            template<typename U>
+            bool operator==(const cache_aligned_allocator<U> &) const { return true; }
+
+            template<typename U>
+            bool operator!=(const cache_aligned_allocator<U> &) const { return false; }
+        };
+
+        //reader counters striped over cache lines: readers only touch the stripe of their own thread,
+        //writers are serialized by mutex and wait until all stripes drained, spinning first then parked till last reader leaves
         class rw_mutex
         {
         public:
 
             typedef std::unique_lock<std::mutex> LOCK_TYPE;
 
-            rw_mutex() 
-                : m_r_count(0)
-                , m_w_count(0)
+            rw_mutex(bool writer_preferred = true)
+                : m_writer_preferred(writer_preferred)
                 , m_w_status(false)
-            {}
+                , m_w_parked(false)
+            {
+                for (uint32_t i = 0; i < RW_MUTEX_STRIPE_COUNT; i++)
+                {
+                    m_stripes[i].m_count.store(0);
+                }
+            }
 
             ~rw_mutex() = default;
 
+            rw_mutex(const rw_mutex&) = delete;
+            rw_mutex& operator=(const rw_mutex&) = delete;
+
             void r_lock()
             {
-                LOCK_TYPE lock(m_mutex);
-                m_r_cv.wait(lock, [=]()->bool {return 0 == m_w_count;});
-                ++m_r_count;
+                reader_stripe &stripe = m_stripes[stripe_idx()];
+
+                while (true)
+                {
+                    stripe.m_count.fetch_add(1);
+                    if (!m_w_status.load())
+                    {
+                        return;
+                    }
+
+                    //writer owns or waits for lock, back off
+                    leave(stripe);
+
+                    uint32_t spin_count = 0;
+                    while (m_w_status.load(std::memory_order_relaxed))
+                    {
+                        backoff(spin_count);
+                    }
+                }
             }
 
             void r_unlock()
             {
-                LOCK_TYPE lock(m_mutex);
-                if ((--m_r_count == 0) && (m_w_count > 0))
-                {
-                    m_w_cv.notify_one();
-                }
+                leave(m_stripes[stripe_idx()]);
             }
 
             void w_lock()
             {
-                LOCK_TYPE lock(m_mutex);
-                ++m_w_count;
-                m_w_cv.wait(lock, [=]()->bool {return (0 == m_r_count) && (!m_w_status);});
-                m_w_status = true;
+                m_w_mutex.lock();
+
+                if (m_writer_preferred)
+                {
+                    //new readers back off as soon as writer announced
+                    m_w_status.store(true);
+                    wait_readers_drained();
+                    return;
+                }
+
+                //reader preferred: only take lock when no reader inside
+                while (true)
+                {
+                    wait_readers_drained();
+
+                    m_w_status.store(true);
+                    if (readers_drained())
+                    {
+                        return;
+                    }
+
+                    m_w_status.store(false);
+                    std::this_thread::yield();
+                }
             }
 
             void w_unlock()
             {
-                LOCK_TYPE lock(m_mutex);
-                (--m_w_count == 0) ? m_r_cv.notify_all() : m_w_cv.notify_one();
-                m_w_status = false;
+                m_w_status.store(false, std::memory_order_release);
+                m_w_mutex.unlock();
+            }
+
+        protected:
+
+            //one cache line each, alignment holds in static storage and members of aligned owners
+            class alignas(CACHE_LINE_SIZE) reader_stripe
+            {
+            public:
+
+                std::atomic<int32_t> m_count;
+            };
+
+            static uint32_t stripe_idx() { return thread_slot_idx() % RW_MUTEX_STRIPE_COUNT; }
+
+            //seq cst decrement then parked check, pairs with writer setting parked then checking stripes
+            void leave(reader_stripe &stripe)
+            {
+                stripe.m_count.fetch_sub(1);
+
+                if (m_w_parked.load())
+                {
+                    std::lock_guard<std::mutex> lock(m_park_mutex);
+                    m_drained.notify_one();
+                }
+            }
+
+            static void backoff(uint32_t &spin_count)
+            {
+                if (++spin_count > RW_MUTEX_SPIN_COUNT)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            bool readers_drained() const
+            {
+                for (uint32_t i = 0; i < RW_MUTEX_STRIPE_COUNT; i++)
+                {
+                    if (0 != m_stripes[i].m_count.load())
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            //one writer at a time, under m_w_mutex
+            void wait_readers_drained()
+            {
+                uint32_t spin_count = 0;
+                while (!readers_drained())
+                {
+                    if (spin_count < RW_MUTEX_WRITER_SPIN_COUNT)
+                    {
+                        backoff(spin_count);
+                        continue;
+                    }
+
+                    //readers stay long, sleep till last one leaves
+                    std::unique_lock<std::mutex> lock(m_park_mutex);
+                    m_w_parked.store(true);
+                    m_drained.wait(lock, [this]() { return readers_drained(); });
+                    m_w_parked.store(false);
+
+                    return;
+                }
             }
 
         private:
 
-            std::mutex m_mutex;
+            reader_stripe m_stripes[RW_MUTEX_STRIPE_COUNT];
+
+            const bool m_writer_preferred;
 
-            volatile bool m_w_status;
+            alignas(CACHE_LINE_SIZE) std::atomic<bool> m_w_status;            //read by every reader, off last stripe line
 
-            volatile uint32_t m_r_count;
+            std::atomic<bool> m_w_parked;                                     //read by every leaving reader, same line as status
 
-            volatile uint32_t m_w_count;
+            std::mutex m_w_mutex;
 
-            std::condition_variable m_r_cv;
+            std::mutex m_park_mutex;
 
-            std::condition_variable m_w_cv;
+            std::condition_variable m_drained;
 
         };
 
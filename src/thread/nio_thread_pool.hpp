@@ -5,6 +5,8 @@
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <common/error.hpp>
+#include <common/metrics.hpp>
+#include <bus/message_bus.hpp>
 
 #define MAX_THR_POOL_SIZE    128
 
@@ -29,6 +31,22 @@ namespace micro
 
             std::shared_ptr<boost::asio::io_service> get_ios() { return m_ios; }
 
+            //run ready handlers as one loop iteration and then flush message bus async publish
+            void run()
+            {
+                while (!m_ios->stopped())
+                {
+                    if (0 == m_ios->run_one())
+                    {
+                        break;
+                    }
+
+                    m_ios->poll();
+
+                    MSG_BUS_FLUSH();
+                }
+            }
+
             void stop() { if (m_ios) m_ios->stop(); }
 
         protected:
@@ -64,8 +82,10 @@ namespace micro
                 {
                     for (size_t i = 0; i < m_ioses.size(); i++)
                     {
-                        m_thrs.emplace_back(std::make_shared<std::thread>(boost::bind(&boost::asio::io_service::run, m_ioses[i]->get_ios())));
+                        m_thrs.emplace_back(std::make_shared<std::thread>(boost::bind(&io_service_helper::run, m_ioses[i])));
                     }
+
+                    init_metrics();
                 }
                 catch (...)
                 {
@@ -87,6 +107,14 @@ namespace micro
 
             int32_t exit()
             {
+                //thread handles invalid after join
+                for (auto id : m_metrics_gauges)
+                {
+                    METRICS.remove_gauge(id);
+                }
+
+                m_metrics_gauges.clear();
+
                 for (size_t i = 0; i < m_ioses.size(); i++)
                 {
                     try
@@ -115,6 +143,23 @@ namespace micro
             }
 
 
+        protected:
+
+            //loop busy time: cpu time of loop thread, idle wait in epoll costs none
+            void init_metrics()
+            {
+                static std::atomic<uint32_t> pool_idx(0);
+                std::string pool = "pool=\"nio" + std::to_string(pool_idx++) + "\"";
+
+                for (size_t i = 0; i < m_thrs.size(); i++)
+                {
+                    std::thread::native_handle_type handle = m_thrs[i]->native_handle();
+
+                    m_metrics_gauges.push_back(METRICS.counter_func("micro_loop_cpu_seconds_total", "CPU time of event loop thread, rate is loop utilization.",
+                        pool + ",loop=\"" + std::to_string(i) + "\"", [handle]() { return metrics_registry::thread_cpu_seconds(handle); }));
+                }
+            }
+
         protected:
 
             std::mutex m_mutex;
@@ -126,6 +171,8 @@ namespace micro
             std::vector<std::shared_ptr<std::thread>> m_thrs;
 
             std::vector<std::shared_ptr<io_service_helper>> m_ioses;
+
+            std::vector<metrics_registry::gauge_id_type> m_metrics_gauges;
         };
 
     }
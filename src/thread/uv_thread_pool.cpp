@@ -1,7 +1,25 @@
 #include <thread/uv_thread_pool.hpp>
 
+#ifndef _WIN32
+#include <signal.h>
+#include <pthread.h>
+#endif
+
 void uv_thread_func(void *arg)
 {
+#ifndef _WIN32
+    //socket writes of this loop fail with EPIPE instead of raising SIGPIPE, other threads keep process disposition
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+#endif
+
     micro::core::uv_thread_pool *pool = (micro::core::uv_thread_pool *)arg;
     pool->run();
+}
+
+void uv_flush_check_func(uv_check_t *handle)
+{
+    MSG_BUS_FLUSH();
 }
\ No newline at end of file
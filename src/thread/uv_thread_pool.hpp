@@ -7,6 +7,8 @@
 #include <uv.h>
 
 #include <common/error.hpp>
+#include <common/metrics.hpp>
+#include <bus/message_bus.hpp>
 
 #define DEFAULT_UV_WORKER_COUNT         1
 
@@ -16,6 +18,7 @@
     POOL->start();
 
 extern void uv_thread_func(void *arg);
+extern void uv_flush_check_func(uv_check_t *handle);
 
 namespace micro
 {
@@ -43,12 +46,20 @@ namespace micro
             {
                 m_loop = uv_loop_new();
 
-                return nullptr != m_loop ? ERR_SUCCESS : ERR_FAILED;
+                return nullptr != m_loop ? init_flush_check() : ERR_FAILED;
             }
 
             virtual int32_t start()
             {
                 m_thr = std::make_shared<std::thread>(m_functor, this);
+
+                //loop busy time: cpu time of loop thread, idle wait in poll costs none
+                static std::atomic<uint32_t> loop_idx(0);
+                std::thread::native_handle_type handle = m_thr->native_handle();
+
+                m_metrics_gauge = METRICS.counter_func("micro_loop_cpu_seconds_total", "CPU time of event loop thread, rate is loop utilization.",
+                    "pool=\"uv\",loop=\"" + std::to_string(loop_idx++) + "\"", [handle]() { return metrics_registry::thread_cpu_seconds(handle); });
+
                 return ERR_SUCCESS;
             }
 
@@ -58,6 +69,9 @@ namespace micro
 
                 if (m_thr)
                 {
+                    //thread handle invalid after join
+                    METRICS.remove_gauge(m_metrics_gauge);
+
                     try
                     {
                         m_thr->join();
@@ -68,12 +82,14 @@ namespace micro
                     }
                 }
 
-                uv_stop(m_loop);
                 return ERR_SUCCESS;
             }
 
             virtual int32_t exit()
             {
+                uv_close((uv_handle_t *)&m_flush_check, nullptr);
+                uv_run(m_loop, UV_RUN_NOWAIT);
+
                 uv_loop_delete(m_loop);
 
                 return ERR_SUCCESS;
@@ -94,6 +110,18 @@ namespace micro
                 return ERR_SUCCESS;
             }
 
+        protected:
+
+            //flush message bus async publish at the end of each loop iteration
+            int32_t init_flush_check()
+            {
+                uv_check_init(m_loop, &m_flush_check);
+                uv_check_start(&m_flush_check, uv_flush_check_func);
+                uv_unref((uv_handle_t *)&m_flush_check);
+
+                return ERR_SUCCESS;
+            }
+
         protected:
 
             bool m_exited;
@@ -102,8 +130,12 @@ namespace micro
 
             uv_loop_t * m_loop;
 
+            uv_check_t m_flush_check;
+
             functor_type m_functor;
 
+            metrics_registry::gauge_id_type m_metrics_gauge = 0;
+
         };
 
         class default_uv_thread_pool : public uv_thread_pool
@@ -120,7 +152,7 @@ namespace micro
             {
                 m_loop = uv_default_loop();
 
-                return nullptr != m_loop ? ERR_SUCCESS : ERR_FAILED;
+                return nullptr != m_loop ? init_flush_check() : ERR_FAILED;
             }
 
             virtual int32_t exit()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <common/metrics.hpp>
 
 
 typedef std::function<void(uint64_t)>  functor_type;
@@ -11,3 +12,49 @@ typedef std::function<void(uint64_t)>  functor_type;
 #define DEFAULT_MILLISECONDS_ONE_TICK                      100                                                  //100 ms for one tick
 
 
+
+namespace micro
+{
+    namespace core
+    {
+
+        //process wide timer counters, active timers = added - removed
+        class timer_metrics
+        {
+        public:
+
+            static timer_metrics & instance()
+            {
+                static timer_metrics metrics;
+                return metrics;
+            }
+
+        protected:
+
+            timer_metrics()
+                : m_ticks(METRICS_COUNTER("micro_timer_ticks_total", "Ticks broadcast by timer generator."))
+                , m_added(METRICS_COUNTER("micro_timers_added_total", "Module timers added."))
+                , m_removed(METRICS_COUNTER("micro_timers_removed_total", "Module timers removed or expired."))
+                , m_fired(METRICS_COUNTER("micro_timers_fired_total", "Module timer callbacks invoked."))
+            {
+                metrics_counter *added = &m_added, *removed = &m_removed;
+                METRICS_GAUGE("micro_timers_active", "Module timers currently scheduled.", "", [added, removed]()
+                {
+                    return (double)added->value() - (double)removed->value();
+                });
+            }
+
+        public:
+
+            metrics_counter &m_ticks;
+
+            metrics_counter &m_added;
+
+            metrics_counter &m_removed;
+
+            metrics_counter &m_fired;
+        };
+
+    }
+
+}
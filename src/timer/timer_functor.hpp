@@ -11,11 +11,11 @@ namespace micro
 
         inline void broadcast_tick_notification(uint64_t time_tick)
         {
-            std::shared_ptr<message> msg = std::make_shared<message>();
-            msg->set_name(BROADCAST_TIMER_TICK);
+            std::shared_ptr<message> msg = make_message();
+            msg->set_msg_id(MSG_TYPE_ID(BROADCAST_TIMER_TICK));
             msg->set_priority(MIDDLE_PRIORITY);
             
-            std::shared_ptr<broadcast_timer_tick> msg_body = std::make_shared<broadcast_timer_tick>();
+            std::shared_ptr<broadcast_timer_tick> msg_body = make_pooled<broadcast_timer_tick>();
             msg_body->time_tick = time_tick;
             msg->m_body = msg_body;
 
@@ -66,9 +66,13 @@ namespace micro
                 }
 
                 ++m_timer_tick;
+                timer_metrics::instance().m_ticks.add();
 
                 m_expired_functor(m_timer_tick);
 
+                //async publish of threads without loop or module run, e.g. timer callbacks
+                MSG_BUS_FLUSH_IDLE();
+
                 start_timer();
             }
 
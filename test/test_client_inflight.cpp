@@ -0,0 +1,105 @@
+#include <test_client_inflight.h>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_CLIENT_INFLIGHT_PORT           18120
+#define TEST_CLIENT_INFLIGHT_LATENCY_MS     2                   //server handler blocks its worker this long
+#define TEST_CLIENT_INFLIGHT_WORKERS        64
+#define TEST_CLIENT_INFLIGHT_TIMEOUT_MS     5000
+
+
+//rpc rate of http_client by requests in flight against a server whose handlers take fixed time in workers,
+//POST with header and body built by http_client_req, K futures sent then all awaited, repeated
+//rate grows with K until server workers or client connections x depth are saturated
+//usage: test_client_inflight [requests per row]
+static void run_row(http_client &client, uint32_t inflight, uint64_t requests)
+{
+    uint64_t failed = 0;
+    std::vector<std::future<http_client_rsp>> futures;
+    futures.reserve(inflight);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t sent = 0; sent < requests; sent += inflight)
+    {
+        for (uint32_t i = 0; i < inflight; i++)
+        {
+            http_client_req req("POST", "http://127.0.0.1:" + std::to_string(TEST_CLIENT_INFLIGHT_PORT) + "/rpc");
+            req.set_header("Content-Type", "application/json").set_body("{\"id\":1}").set_timeout(TEST_CLIENT_INFLIGHT_TIMEOUT_MS);
+
+            futures.push_back(client.send_future(std::move(req)));
+        }
+
+        for (auto &future : futures)
+        {
+            http_client_rsp rsp = future.get();
+            if (0 != rsp.m_error || 200 != rsp.m_status_code || rsp.m_body != "{\"id\":1}")
+            {
+                failed++;
+            }
+        }
+
+        futures.clear();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << inflight << "\t" << (uint64_t)(requests / seconds) << "\t" << failed << std::endl;
+}
+
+int test_client_inflight(int argc, char* argv[])
+{
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+
+    any_map vars;
+    vars.set(MULTI_THREADS_COUNT, (uint32_t)TEST_CLIENT_INFLIGHT_WORKERS);
+
+    multi_thread_module workers;
+    workers.init(vars);
+
+    //echo body after fixed handler time
+    http_server server([](http_req &req, http_rsp &rsp)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(TEST_CLIENT_INFLIGHT_LATENCY_MS));
+        rsp.end(req.m_body.to_string());
+    });
+
+    server.set_workers(workers);
+    server.set_max_requests(UINT32_MAX);
+
+    if (ERR_SUCCESS != server.listen("127.0.0.1", TEST_CLIENT_INFLIGHT_PORT))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    workers.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //up to 256 requests on the wire
+    http_client client;
+    client.set_max_conns(16);
+    client.set_pipeline_depth(16);
+
+    std::cout << "handler " << TEST_CLIENT_INFLIGHT_LATENCY_MS << " ms in " << TEST_CLIENT_INFLIGHT_WORKERS << " workers" << std::endl;
+    std::cout << "in flight\trequests/s\tfailed" << std::endl;
+
+    for (uint32_t inflight = 1; inflight <= 256; inflight *= 4)
+    {
+        run_row(client, inflight, inflight < 16 ? requests / 20 : requests);
+    }
+
+    //clients done, no request left in workers
+    server.stop();
+
+    workers.stop();
+    workers.exit();
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
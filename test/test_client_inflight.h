@@ -0,0 +1,9 @@
+#pragma once
+
+#include <io/http_server.hpp>
+#include <io/http_client.hpp>
+#include <module/multi_thread_module.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_client_inflight(int argc, char* argv[]);
@@ -0,0 +1,135 @@
+#include <test_client_throughput.h>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_CLIENT_THROUGHPUT_PORT         18110
+
+
+//http_client request rate against local http_server by connections per host and pipeline depth,
+//requests kept at connections x depth in flight, callback of each response sends next one;
+//last row: server closes after each response, every request opens a connection
+//usage: test_client_throughput [requests per row]
+class throughput_run
+{
+public:
+
+    throughput_run(http_client &client, uint64_t requests) : m_client(client), m_requests(requests) {}
+
+    void send_next()
+    {
+        if (m_sent++ >= m_requests)
+        {
+            return;
+        }
+
+        m_client.request("GET", "127.0.0.1", TEST_CLIENT_THROUGHPUT_PORT, "/ok", [this](http_client_rsp &rsp)
+        {
+            if (0 != rsp.m_error || 200 != rsp.m_status_code)
+            {
+                m_failed++;
+            }
+
+            send_next();
+
+            if (++m_done == m_requests)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.notify_all();
+            }
+        });
+    }
+
+    //requests per second
+    double run(uint32_t window)
+    {
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < window; i++)
+        {
+            send_next();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() { return m_done == m_requests; });
+
+        return m_requests / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    http_client &m_client;
+
+    uint64_t m_requests;
+
+    std::atomic<uint64_t> m_sent{ 0 };
+
+    std::atomic<uint64_t> m_done{ 0 };
+
+    std::atomic<uint64_t> m_failed{ 0 };
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_cond;
+};
+
+static void run_row(uint32_t conns, uint32_t depth, uint64_t requests, const char *note)
+{
+    http_client client;
+    client.set_max_conns(conns);
+    client.set_pipeline_depth(depth);
+
+    throughput_run run(client, requests);
+    double rate = run.run(conns * depth);
+
+    std::cout << conns << "\t" << depth << "\t" << (uint64_t)rate << "\t" << run.m_failed << note << std::endl;
+}
+
+int test_client_throughput(int argc, char* argv[])
+{
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+
+    http_server server([](http_req &req, http_rsp &rsp) { rsp.end("ok"); });
+    server.set_max_requests(UINT32_MAX);
+
+    http_server close_server([](http_req &req, http_rsp &rsp) { rsp.end("ok"); });
+    close_server.set_keep_alive(false);
+
+    if (ERR_SUCCESS != server.listen("127.0.0.1", TEST_CLIENT_THROUGHPUT_PORT))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::cout << "conns\tdepth\trequests/s\tfailed" << std::endl;
+
+    uint32_t conns[] = { 1, 4 };
+    uint32_t depths[] = { 1, 4, 16 };
+    for (uint32_t c : conns)
+    {
+        for (uint32_t d : depths)
+        {
+            run_row(c, d, requests, "");
+        }
+    }
+
+    //same port, keep alive off
+    server.stop();
+    if (ERR_SUCCESS != close_server.listen("127.0.0.1", TEST_CLIENT_THROUGHPUT_PORT))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    run_row(4, 1, requests / 10, "\tconnection per request");
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
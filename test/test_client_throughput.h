@@ -0,0 +1,8 @@
+#pragma once
+
+#include <io/http_server.hpp>
+#include <io/http_client.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_client_throughput(int argc, char* argv[]);
@@ -0,0 +1,88 @@
+#include <test_dispatch.h>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include <unordered_map>
+#include <cstdlib>
+
+
+#define TEST_DISPATCH_TYPE_COUNT            64
+
+
+//message dispatch by interned id (vector index) against by name (hash map), and set_name through registry
+//usage: test_dispatch [ops]
+typedef std::function<int32_t(std::shared_ptr<message>)> functor_type;
+
+template<typename func_type>
+static double rate(uint64_t ops, func_type func)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t n = 0; n < ops; n++)
+    {
+        func(n);
+    }
+
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int test_dispatch(int argc, char* argv[])
+{
+    uint64_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+
+    uint64_t handled = 0;
+    functor_type functor = [&handled](std::shared_ptr<message>) { handled++; return ERR_SUCCESS; };
+
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<message>> msgs;
+    std::vector<functor_type> by_id;
+    std::unordered_map<std::string, functor_type> by_name;
+
+    for (uint32_t i = 0; i < TEST_DISPATCH_TYPE_COUNT; i++)
+    {
+        names.push_back("test_dispatch_msg_" + std::to_string(i));
+
+        uint32_t msg_id = MSG_TYPE_REGISTRY.intern(names.back());
+        if (msg_id >= by_id.size())
+        {
+            by_id.resize(msg_id + 1);
+        }
+
+        by_id[msg_id] = functor;
+        by_name[names.back()] = functor;
+
+        msgs.push_back(make_message());
+        msgs.back()->set_msg_id(msg_id);
+    }
+
+    double id_rate = rate(ops, [&](uint64_t n)
+    {
+        const std::shared_ptr<message> &msg = msgs[n % TEST_DISPATCH_TYPE_COUNT];
+        by_id[msg->get_msg_id()](msg);
+    });
+
+    double name_rate = rate(ops, [&](uint64_t n)
+    {
+        const std::shared_ptr<message> &msg = msgs[n % TEST_DISPATCH_TYPE_COUNT];
+        by_name.find(names[n % TEST_DISPATCH_TYPE_COUNT])->second(msg);
+    });
+
+    double intern_rate = rate(ops, [&](uint64_t n)
+    {
+        msgs[0]->set_msg_id(MSG_TYPE_REGISTRY.intern(names[n % TEST_DISPATCH_TYPE_COUNT]));
+    });
+
+    double set_name_rate = rate(ops, [&](uint64_t n)
+    {
+        msgs[0]->set_name(names[n % TEST_DISPATCH_TYPE_COUNT]);
+    });
+
+    std::cout << "dispatch by id ops/s\t" << (uint64_t)id_rate << std::endl;
+    std::cout << "dispatch by name ops/s\t" << (uint64_t)name_rate << std::endl;
+    std::cout << "registry intern ops/s\t" << (uint64_t)intern_rate << std::endl;
+    std::cout << "set_name (cached) ops/s\t" << (uint64_t)set_name_rate << std::endl;
+    std::cout << "handled\t" << handled << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <common/error.hpp>
+#include <message/message.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_dispatch(int argc, char* argv[]);
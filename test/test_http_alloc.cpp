@@ -0,0 +1,200 @@
+#include <test_http_alloc.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_HTTP_ALLOC_PORT                18090
+#define TEST_HTTP_ALLOC_DEPTH               16
+#define TEST_HTTP_ALLOC_RSP_LEN             200                 //response bytes put in write buffer
+
+
+//heap allocations of http receive chunks and response write buffers, pooled against plain new / delete,
+//then allocations per request of http_server over loopback with pipelined keep alive requests
+//global operator new below counts every allocation of the process while counting is on, client side allocates none
+//usage: test_http_alloc [ops]
+typedef boost::asio::ip::tcp tcp;
+
+static std::atomic<bool> g_counting(false);
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void * operator new(size_t size)
+{
+    if (g_counting.load(std::memory_order_relaxed))
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *ptr = malloc(size ? size : 1);
+    if (nullptr == ptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+class alloc_count
+{
+public:
+
+    alloc_count() : m_begin(g_allocations.load()) { g_counting = true; }
+
+    ~alloc_count() { g_counting = false; }
+
+    uint64_t count() const { return g_allocations.load() - m_begin; }
+
+    uint64_t m_begin;
+};
+
+static void print_row(const char *name, uint64_t ops, double seconds, uint64_t allocations)
+{
+    std::cout << name << "\t" << (uint64_t)(ops / seconds) << "\t" << (double)allocations / ops << std::endl;
+}
+
+static void run_chunks(uint64_t ops)
+{
+    std::string rsp(TEST_HTTP_ALLOC_RSP_LEN, 'x');
+
+    for (int pooled = 1; pooled >= 0; pooled--)
+    {
+        //warm thread pool so rows show steady state
+        http_chunk::acquire();
+
+        alloc_count counter;
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < ops; i++)
+        {
+            http_chunk::ptr_type chunk = pooled ? http_chunk::acquire() : std::make_shared<http_chunk>();
+            chunk->m_data[0] = (char)i;
+        }
+
+        print_row(pooled ? "chunk pooled" : "chunk heap", ops, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(), counter.count());
+    }
+
+    for (int pooled = 1; pooled >= 0; pooled--)
+    {
+        http_write_req::release(http_write_req::acquire());
+
+        alloc_count counter;
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < ops; i++)
+        {
+            http_write_req *write_req = pooled ? http_write_req::acquire() : new http_write_req();
+            write_req->m_data.append(rsp);
+
+            if (pooled)
+            {
+                http_write_req::release(write_req);
+            }
+            else
+            {
+                delete write_req;
+            }
+        }
+
+        print_row(pooled ? "write pooled" : "write heap", ops, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(), counter.count());
+    }
+}
+
+//counts responses by body "ok" after headers, match state kept across reads, no allocation
+class rsp_matcher
+{
+public:
+
+    uint64_t feed(const char *data, size_t size)
+    {
+        static const char end_mark[] = "\r\n\r\nok";
+
+        uint64_t count = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            m_matched = (data[i] == end_mark[m_matched]) ? m_matched + 1 : (data[i] == end_mark[0] ? 1 : 0);
+            if (sizeof(end_mark) - 1 == m_matched)
+            {
+                count++;
+                m_matched = 0;
+            }
+        }
+
+        return count;
+    }
+
+    size_t m_matched = 0;
+};
+
+static void run_server(uint64_t requests)
+{
+    boost::asio::io_service ios;
+    tcp::socket socket(ios);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), TEST_HTTP_ALLOC_PORT));
+    socket.set_option(tcp::no_delay(true));
+
+    std::string batch;
+    for (uint32_t i = 0; i < TEST_HTTP_ALLOC_DEPTH; i++)
+    {
+        batch += "GET /ok HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+
+    std::vector<char> buf(65536);
+    rsp_matcher matcher;
+
+    //first round warms connection chunk and loop thread pools
+    boost::asio::write(socket, boost::asio::buffer(batch));
+    for (uint64_t received = 0; received < TEST_HTTP_ALLOC_DEPTH; )
+    {
+        received += matcher.feed(buf.data(), socket.read_some(boost::asio::buffer(buf)));
+    }
+
+    alloc_count counter;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t sent = 0; sent < requests; sent += TEST_HTTP_ALLOC_DEPTH)
+    {
+        boost::asio::write(socket, boost::asio::buffer(batch));
+
+        for (uint64_t received = 0; received < TEST_HTTP_ALLOC_DEPTH; )
+        {
+            received += matcher.feed(buf.data(), socket.read_some(boost::asio::buffer(buf)));
+        }
+    }
+
+    print_row("server request", requests, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(), counter.count());
+}
+
+int test_http_alloc(int argc, char* argv[])
+{
+    uint64_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::cout << "case\tops/s\tallocations/op" << std::endl;
+    run_chunks(ops);
+
+    http_server server([](http_req &req, http_rsp &rsp) { rsp.end("ok"); });
+    server.set_max_requests(UINT32_MAX);
+
+    if (ERR_SUCCESS != server.listen("127.0.0.1", TEST_HTTP_ALLOC_PORT))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    run_server(ops / 10);
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include <test_http_loops.h>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_HTTP_LOOPS_PORT                18210
+#define TEST_HTTP_LOOPS_CLIENTS             4                   //client loops driving load
+#define TEST_HTTP_LOOPS_CONNS               8                   //connections per client, spread over listen sockets by kernel
+#define TEST_HTTP_LOOPS_DEPTH               4
+
+
+//http_server request rate by listening loop count, 1, 2, 4 and one per core, each loop own SO_REUSEPORT socket;
+//several http_client loops keep clients x conns x depth requests in flight, callback of each response sends next one
+//usage: test_http_loops [requests per row]
+class loops_client
+{
+public:
+
+    loops_client(uint16_t port, uint64_t requests) : m_port(port), m_requests(requests)
+    {
+        m_client.set_max_conns(TEST_HTTP_LOOPS_CONNS);
+        m_client.set_pipeline_depth(TEST_HTTP_LOOPS_DEPTH);
+    }
+
+    void start()
+    {
+        for (uint32_t i = 0; i < TEST_HTTP_LOOPS_CONNS * TEST_HTTP_LOOPS_DEPTH; i++)
+        {
+            send_next();
+        }
+    }
+
+    void send_next()
+    {
+        if (m_sent++ >= m_requests)
+        {
+            return;
+        }
+
+        m_client.request("GET", "127.0.0.1", m_port, "/ok", [this](http_client_rsp &rsp)
+        {
+            if (0 != rsp.m_error || 200 != rsp.m_status_code)
+            {
+                m_failed++;
+            }
+
+            send_next();
+
+            if (++m_done == m_requests)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.notify_all();
+            }
+        });
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() { return m_done == m_requests; });
+    }
+
+    http_client m_client;
+
+    uint16_t m_port;
+
+    uint64_t m_requests;
+
+    std::atomic<uint64_t> m_sent{ 0 };
+
+    std::atomic<uint64_t> m_done{ 0 };
+
+    std::atomic<uint64_t> m_failed{ 0 };
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_cond;
+};
+
+int test_http_loops(int argc, char* argv[])
+{
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<uint32_t> loop_counts = { 1, 2, 4 };
+    if (cores > 4)
+    {
+        loop_counts.push_back(cores);
+    }
+
+    std::cout << "cores: " << cores << ", clients: " << TEST_HTTP_LOOPS_CLIENTS << " x " << TEST_HTTP_LOOPS_CONNS
+        << " conns x depth " << TEST_HTTP_LOOPS_DEPTH << std::endl;
+    std::cout << "loops\trequests/s\tscaling\tfailed" << std::endl;
+
+    //new port per row, no connection of last row lands on next server
+    uint16_t port = TEST_HTTP_LOOPS_PORT;
+    double base_rate = 0;
+    for (uint32_t loop_count : loop_counts)
+    {
+        http_server server([](http_req &req, http_rsp &rsp) { rsp.end("ok"); });
+        server.set_max_requests(UINT32_MAX);
+
+        if (ERR_SUCCESS != server.listen("127.0.0.1", port, loop_count))
+        {
+            std::cout << "listen failed" << std::endl;
+            return ERR_FAILED;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::vector<std::unique_ptr<loops_client>> clients;
+        for (uint32_t i = 0; i < TEST_HTTP_LOOPS_CLIENTS; i++)
+        {
+            clients.emplace_back(new loops_client(port, requests / TEST_HTTP_LOOPS_CLIENTS));
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+
+        uint64_t done = 0, failed = 0;
+        for (auto &client : clients)
+        {
+            client->start();
+        }
+
+        for (auto &client : clients)
+        {
+            client->wait();
+            done += client->m_done;
+            failed += client->m_failed;
+        }
+
+        double rate = done / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        base_rate = base_rate > 0 ? base_rate : rate;
+
+        std::cout << loop_count << "\t" << (uint64_t)rate << "\t" << rate / base_rate << "\t" << failed << std::endl;
+
+        clients.clear();
+        server.stop();
+        port++;
+    }
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#include <test_http_pipeline.h>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_HTTP_PIPELINE_PORT             18080
+
+
+//keep alive request rate at pipeline depth 1..64 over one connection, blocking asio client against http_server
+//also checks handler "Connection: Close" (any case) closes connection, listen on used port fails
+//and stop closes open connections
+//usage: test_http_pipeline [requests per depth]
+typedef boost::asio::ip::tcp tcp;
+
+//responses end with body "ok", count them across reads
+static uint64_t count_responses(const char *data, size_t size, std::string &tail)
+{
+    static const std::string end_mark = "\r\n\r\nok";
+
+    std::string buf = tail + std::string(data, size);
+    uint64_t count = 0;
+
+    for (size_t pos = buf.find(end_mark); std::string::npos != pos; pos = buf.find(end_mark, pos + end_mark.size()))
+    {
+        count++;
+    }
+
+    tail = buf.size() >= end_mark.size() ? buf.substr(buf.size() - end_mark.size() + 1) : buf;
+    return count;
+}
+
+static double run_depth(boost::asio::io_service &ios, uint64_t requests, uint32_t depth)
+{
+    tcp::socket socket(ios);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), TEST_HTTP_PIPELINE_PORT));
+    socket.set_option(tcp::no_delay(true));
+
+    std::string batch;
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        batch += "GET /ok HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+
+    char buf[65536];
+    std::string tail;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t sent = 0; sent < requests; sent += depth)
+    {
+        boost::asio::write(socket, boost::asio::buffer(batch));
+
+        for (uint64_t received = 0; received < depth; )
+        {
+            size_t n = socket.read_some(boost::asio::buffer(buf));
+            received += count_responses(buf, n, tail);
+        }
+    }
+
+    return requests / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+//handler sets "Connection: Close", server must close after response
+static bool closes_after(boost::asio::io_service &ios)
+{
+    tcp::socket socket(ios);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), TEST_HTTP_PIPELINE_PORT));
+
+    std::string req = "GET /close HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    boost::asio::write(socket, boost::asio::buffer(req));
+
+    char buf[4096];
+    boost::system::error_code ec;
+    while (!ec)
+    {
+        socket.read_some(boost::asio::buffer(buf), ec);
+    }
+
+    return boost::asio::error::eof == ec || boost::asio::error::connection_reset == ec;
+}
+
+//idle keep alive connection closed by server stop
+static bool stop_closes(boost::asio::io_service &ios, http_server &server)
+{
+    tcp::socket socket(ios);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), TEST_HTTP_PIPELINE_PORT));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    server.stop();
+
+    char buf[4096];
+    boost::system::error_code ec;
+    while (!ec)
+    {
+        socket.read_some(boost::asio::buffer(buf), ec);
+    }
+
+    return boost::asio::error::eof == ec || boost::asio::error::connection_reset == ec;
+}
+
+int test_http_pipeline(int argc, char* argv[])
+{
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+
+    http_server server([](http_req &req, http_rsp &rsp)
+    {
+        if (req.m_url == "/close")
+        {
+            rsp.set_header("Connection", "Close");
+        }
+
+        rsp.end("ok");
+    });
+
+    //one connection for whole run
+    server.set_max_requests(UINT32_MAX);
+
+    if (ERR_SUCCESS != server.listen("127.0.0.1", TEST_HTTP_PIPELINE_PORT))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    http_server other([](http_req &req, http_rsp &rsp) { rsp.end(); });
+    std::cout << "listen on used port fails\t" << (ERR_SUCCESS != other.listen("127.0.0.1", TEST_HTTP_PIPELINE_PORT) ? "yes" : "no") << std::endl;
+
+    boost::asio::io_service ios;
+
+    std::cout << "Connection: Close honoured\t" << (closes_after(ios) ? "yes" : "no") << std::endl;
+
+    std::cout << "depth\trequests/s" << std::endl;
+    for (uint32_t depth = 1; depth <= 64; depth *= 4)
+    {
+        std::cout << depth << "\t" << (uint64_t)run_depth(ios, requests, depth) << std::endl;
+    }
+
+    std::cout << "stop closes connections\t" << (stop_closes(ios, server) ? "yes" : "no") << std::endl;
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <io/http_server.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_http_pipeline(int argc, char* argv[]);
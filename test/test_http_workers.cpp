@@ -0,0 +1,162 @@
+#include <test_http_workers.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+
+#define TEST_HTTP_WORKERS_PORT              18100
+#define TEST_HTTP_WORKERS_SLOW_MS           20                  //slow handler blocks its thread this long
+#define TEST_HTTP_WORKERS_SLOW_CONNS        4                   //connections sending slow requests one at a time
+#define TEST_HTTP_WORKERS_DEPTH             16                  //pipeline depth of fast connection
+#define TEST_HTTP_WORKERS_THREADS           4
+
+
+//fast request rate of http_server while other connections keep slow handlers busy,
+//handlers on loop thread against handlers in multi_thread_module workers
+//usage: test_http_workers [fast requests]
+typedef boost::asio::ip::tcp tcp;
+
+//counts responses by body "ok" after headers, match state kept across reads
+class rsp_matcher
+{
+public:
+
+    uint64_t feed(const char *data, size_t size)
+    {
+        static const char end_mark[] = "\r\n\r\nok";
+
+        uint64_t count = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            m_matched = (data[i] == end_mark[m_matched]) ? m_matched + 1 : (data[i] == end_mark[0] ? 1 : 0);
+            if (sizeof(end_mark) - 1 == m_matched)
+            {
+                count++;
+                m_matched = 0;
+            }
+        }
+
+        return count;
+    }
+
+    size_t m_matched = 0;
+};
+
+//send depth requests of path, wait all responses, until count sent or stop set
+static uint64_t request_loop(uint16_t port, const std::string &path, uint32_t depth, uint64_t count, const std::atomic<bool> &stop)
+{
+    boost::asio::io_service ios;
+    tcp::socket socket(ios);
+    socket.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port));
+    socket.set_option(tcp::no_delay(true));
+
+    std::string batch;
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        batch += "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+
+    char buf[65536];
+    rsp_matcher matcher;
+
+    uint64_t done = 0;
+    while (done < count && !stop)
+    {
+        boost::asio::write(socket, boost::asio::buffer(batch));
+
+        for (uint64_t received = 0; received < depth; )
+        {
+            received += matcher.feed(buf, socket.read_some(boost::asio::buffer(buf)));
+        }
+
+        done += depth;
+    }
+
+    return done;
+}
+
+static void run(const char *name, uint16_t port, uint64_t requests)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> slow_done(0);
+
+    std::vector<std::thread> slow;
+    for (uint32_t i = 0; i < TEST_HTTP_WORKERS_SLOW_CONNS; i++)
+    {
+        slow.emplace_back([&]() { slow_done += request_loop(port, "/slow", 1, UINT64_MAX, stop); });
+    }
+
+    //slow connections in flight first
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t fast_done = request_loop(port, "/fast", TEST_HTTP_WORKERS_DEPTH, requests, stop);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    stop = true;
+    for (auto &t : slow)
+    {
+        t.join();
+    }
+
+    std::cout << name << "\t" << (uint64_t)(fast_done / seconds) << "\t" << (uint64_t)(slow_done / seconds) << std::endl;
+}
+
+int test_http_workers(int argc, char* argv[])
+{
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+
+    auto handler = [](http_req &req, http_rsp &rsp)
+    {
+        if (req.m_url == "/slow")
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(TEST_HTTP_WORKERS_SLOW_MS));
+        }
+
+        rsp.end("ok");
+    };
+
+    any_map vars;
+    vars.set(MULTI_THREADS_COUNT, (uint32_t)TEST_HTTP_WORKERS_THREADS);
+
+    multi_thread_module workers;
+    workers.init(vars);
+
+    http_server inline_server(handler);
+    http_server worker_server(handler);
+    worker_server.set_workers(workers);
+
+    inline_server.set_max_requests(UINT32_MAX);
+    worker_server.set_max_requests(UINT32_MAX);
+
+    if (ERR_SUCCESS != inline_server.listen("127.0.0.1", TEST_HTTP_WORKERS_PORT) || ERR_SUCCESS != worker_server.listen("127.0.0.1", TEST_HTTP_WORKERS_PORT + 1))
+    {
+        std::cout << "listen failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    workers.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::cout << "slow handler " << TEST_HTTP_WORKERS_SLOW_MS << " ms on " << TEST_HTTP_WORKERS_SLOW_CONNS << " connections, "
+        << TEST_HTTP_WORKERS_THREADS << " workers" << std::endl;
+    std::cout << "handlers\tfast requests/s\tslow requests/s" << std::endl;
+
+    run("loop thread", TEST_HTTP_WORKERS_PORT, requests / 10);
+    run("workers", TEST_HTTP_WORKERS_PORT + 1, requests);
+
+    //no request left in workers once clients are done
+    inline_server.stop();
+    worker_server.stop();
+
+    workers.stop();
+    workers.exit();
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
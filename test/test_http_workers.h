@@ -0,0 +1,9 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <io/http_server.hpp>
+#include <module/multi_thread_module.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_http_workers(int argc, char* argv[]);
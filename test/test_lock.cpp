@@ -0,0 +1,96 @@
+#include <test_lock.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <cstdlib>
+
+
+//read lock throughput of rw_mutex against std::mutex, 1 to 64 threads, optional writer every write_interval_us
+//usage: test_lock [ops per thread] [write interval us, 0: no writer]
+//writer takes write side of the same lock as readers: rw_mutex w_lock, or the std::mutex itself
+template<typename lock_func, typename unlock_func, typename w_lock_func, typename w_unlock_func>
+static double run_readers(uint32_t thread_count, uint64_t ops, uint32_t write_interval_us, lock_func lock, unlock_func unlock, w_lock_func w_lock, w_unlock_func w_unlock)
+{
+    std::atomic<bool> start(false), done(false);
+    std::atomic<uint32_t> ready(0);
+    volatile uint64_t shared_value = 0;
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            ready++;
+            while (!start.load()) std::this_thread::yield();
+
+            uint64_t sum = 0;
+            for (uint64_t n = 0; n < ops; n++)
+            {
+                lock();
+                sum += shared_value;
+                unlock();
+            }
+
+            (void)sum;
+        });
+    }
+
+    std::thread writer;
+    if (write_interval_us > 0)
+    {
+        writer = std::thread([&]()
+        {
+            while (!done.load())
+            {
+                w_lock();
+                shared_value = shared_value + 1;
+                w_unlock();
+
+                std::this_thread::sleep_for(std::chrono::microseconds(write_interval_us));
+            }
+        });
+    }
+
+    while (ready.load() < thread_count) std::this_thread::yield();
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    done = true;
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+
+    return thread_count * ops / seconds;
+}
+
+int test_lock(int argc, char* argv[])
+{
+    uint64_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    uint32_t write_interval_us = argc > 2 ? (uint32_t)atoi(argv[2]) : 0;
+
+    rw_mutex rw;
+    std::mutex mutex;
+
+    std::cout << "threads\trw_mutex read ops/s\tstd::mutex ops/s" << std::endl;
+
+    for (uint32_t thread_count = 1; thread_count <= 64; thread_count *= 2)
+    {
+        double rw_ops = run_readers(thread_count, ops, write_interval_us, [&]() { rw.r_lock(); }, [&]() { rw.r_unlock(); }, [&]() { rw.w_lock(); }, [&]() { rw.w_unlock(); });
+        double mutex_ops = run_readers(thread_count, ops, write_interval_us, [&]() { mutex.lock(); }, [&]() { mutex.unlock(); }, [&]() { mutex.lock(); }, [&]() { mutex.unlock(); });
+
+        std::cout << thread_count << "\t" << (uint64_t)rw_ops << "\t" << (uint64_t)mutex_ops << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <thread/lock.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_lock(int argc, char* argv[]);
@@ -0,0 +1,120 @@
+#include <test_pool.h>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <unordered_set>
+#include <condition_variable>
+#include <cstdlib>
+
+
+#define TEST_POOL_BATCH_SIZE                256
+#define TEST_POOL_MAX_BATCHES               16                      //in flight between producer and consumer
+
+
+//message allocation throughput of make_pooled against make_shared, same thread and producer / consumer threads
+//cross thread rows also count distinct blocks producer got, bounded when released blocks go back to producer
+//usage: test_pool [ops]
+typedef std::vector<std::shared_ptr<message>> batch_type;
+
+static double run_local(uint64_t ops, bool pooled)
+{
+    batch_type batch;
+    batch.reserve(TEST_POOL_BATCH_SIZE);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t n = 0; n < ops; n += TEST_POOL_BATCH_SIZE)
+    {
+        for (uint32_t i = 0; i < TEST_POOL_BATCH_SIZE; i++)
+        {
+            batch.push_back(pooled ? make_pooled<message>() : std::make_shared<message>());
+        }
+
+        batch.clear();
+    }
+
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static double run_cross(uint64_t ops, bool pooled, size_t &distinct)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<batch_type> queue;
+    bool done = false;
+
+    std::thread consumer([&]()
+    {
+        for (;;)
+        {
+            batch_type batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return done || !queue.empty(); });
+
+                if (queue.empty())
+                {
+                    return;
+                }
+
+                batch.swap(queue.front());
+                queue.pop_front();
+            }
+
+            cond.notify_all();
+            batch.clear();                                      //released on consumer thread
+        }
+    });
+
+    std::unordered_set<const void *> blocks;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t n = 0; n < ops; n += TEST_POOL_BATCH_SIZE)
+    {
+        batch_type batch;
+        batch.reserve(TEST_POOL_BATCH_SIZE);
+
+        for (uint32_t i = 0; i < TEST_POOL_BATCH_SIZE; i++)
+        {
+            batch.push_back(pooled ? make_pooled<message>() : std::make_shared<message>());
+            blocks.insert(batch.back().get());
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return queue.size() < TEST_POOL_MAX_BATCHES; });
+
+        queue.push_back(std::move(batch));
+        cond.notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done = true;
+    }
+
+    cond.notify_all();
+    consumer.join();
+
+    distinct = blocks.size();
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int test_pool(int argc, char* argv[])
+{
+    uint64_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t pooled_distinct = 0, heap_distinct = 0;
+
+    std::cout << "case\tmake_pooled ops/s\tmake_shared ops/s" << std::endl;
+    std::cout << "same thread\t" << (uint64_t)run_local(ops, true) << "\t" << (uint64_t)run_local(ops, false) << std::endl;
+
+    double pooled_ops = run_cross(ops, true, pooled_distinct);
+    double heap_ops = run_cross(ops, false, heap_distinct);
+
+    std::cout << "cross thread\t" << (uint64_t)pooled_ops << "\t" << (uint64_t)heap_ops << std::endl;
+    std::cout << "distinct blocks\t" << pooled_distinct << "\t" << heap_distinct << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <message/message.hpp>
+#include <io/http_pool.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_pool(int argc, char* argv[]);
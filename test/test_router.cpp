@@ -0,0 +1,115 @@
+#include <test_router.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+
+
+#define TEST_ROUTER_RESOURCE_COUNT          50
+
+
+//route match rate over static, ":param" and "*wildcard" routes, checks a few matches first
+//usage: test_router [matches]
+static std::string matched;
+
+static http_router::handler_type tag(const std::string &name)
+{
+    return [name](http_req &, http_rsp &) { matched = name; };
+}
+
+//route name and params of url, "" when not found
+static std::string route_of(const http_router &router, const std::string &method, const std::string &url)
+{
+    http_req req;
+    req.m_method = method;
+    req.m_url = url;
+
+    const http_router::handler_type *handler = router.match(req);
+    if (nullptr == handler)
+    {
+        return "";
+    }
+
+    http_rsp rsp;
+    (*handler)(req, rsp);
+
+    std::string result = matched;
+    for (auto &param : req.m_params)
+    {
+        result += " " + std::string(param.first) + "=" + std::string(param.second);
+    }
+
+    return result;
+}
+
+static bool check(const http_router &router, const std::string &method, const std::string &url, const std::string &expected)
+{
+    std::string result = route_of(router, method, url);
+    std::cout << (result == expected ? "ok  " : "FAIL") << "\t" << method << " " << url << " --> " << (result.empty() ? "not found" : result) << std::endl;
+
+    return result == expected;
+}
+
+int test_router(int argc, char* argv[])
+{
+    uint64_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+
+    http_router router;
+    std::vector<std::string> urls;
+
+    for (uint32_t i = 0; i < TEST_ROUTER_RESOURCE_COUNT; i++)
+    {
+        std::string res = "/api/v1/res" + std::to_string(i);
+
+        router.get(res, tag("list"));
+        router.get(res + "/:id", tag("get"));
+        router.put(res + "/:id", tag("put"));
+        router.get(res + "/:id/items/:item", tag("item"));
+
+        urls.push_back(res);
+        urls.push_back(res + "/" + std::to_string(i * 7));
+        urls.push_back(res + "/" + std::to_string(i) + "/items/" + std::to_string(i * 3));
+    }
+
+    router.get("/static/*path", tag("static"));
+    router.get("/time/12:30", tag("noon"));
+    router.get("/time/:at", tag("time"));
+    router.get("/files/a*b", tag("star"));
+
+    urls.push_back("/static/css/site.css");
+    urls.push_back("/time/08:15");
+
+    bool ok = true;
+    ok &= check(router, "GET", "/api/v1/res3", "list");
+    ok &= check(router, "PUT", "/api/v1/res3/42", "put id=42");
+    ok &= check(router, "GET", "/api/v1/res3/42/items/7?x=1", "item id=42 item=7");
+    ok &= check(router, "GET", "/static/css/site.css", "static path=css/site.css");
+    ok &= check(router, "GET", "/time/12:30", "noon");
+    ok &= check(router, "GET", "/time/08:15", "time at=08:15");
+    ok &= check(router, "GET", "/files/a*b", "star");
+    ok &= check(router, "GET", "/files/axb", "");
+    ok &= check(router, "DELETE", "/api/v1/res3", "");
+
+    std::vector<http_req> reqs(urls.size());
+    for (size_t i = 0; i < urls.size(); i++)
+    {
+        reqs[i].m_method = "GET";
+        reqs[i].m_url = urls[i];
+    }
+
+    uint64_t found = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint64_t n = 0; n < ops; n++)
+    {
+        found += nullptr != router.match(reqs[n % reqs.size()]);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "routes\t" << TEST_ROUTER_RESOURCE_COUNT * 4 + 4 << std::endl;
+    std::cout << "matches/s\t" << (uint64_t)(ops / seconds) << "\tfound " << found << std::endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <io/http_router.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_router(int argc, char* argv[]);
@@ -71,16 +71,19 @@ public:
             return ctx.fire_channel_write();
         }
 
-        send_data *snd_data = new send_data();                        //malloc should check
+        //pooled send data, one buffer of echo size
+        send_data *snd_data = ch->alloc_send_data(msg_body->m_echo.size());
+        if (nullptr == snd_data)
+        {
+            return ctx.fire_channel_write();
+        }
 
-        uv_ip4_addr(GET_IP(msg->get_dst_endpoint()), msg->get_dst_endpoint().port(), &snd_data->m_send_addr);
+        snd_data->m_send_addr = udp_address(msg->get_dst_endpoint());
 
-        snd_data->m_uv_buf = (uv_buf_t *)malloc(sizeof (uv_buf_t));
-        snd_data->m_uv_buf->base = (char *)malloc(msg_body->m_echo.size());
-        snd_data->m_uv_buf->len = (ULONG)msg_body->m_echo.size();
-        memcpy(snd_data->m_uv_buf->base, msg_body->m_echo.c_str(), snd_data->m_uv_buf->len);
+        memcpy(snd_data->m_uv_buf->base, msg_body->m_echo.c_str(), msg_body->m_echo.size());
 
-        ch->get_send_bufs().push_back(snd_data);
+        //write() runs encoder on caller thread, inbox push is safe there and wakes loop to send
+        ch->push_and_notify_async(snd_data);
 
         return ctx.fire_channel_write();
     }
@@ -151,16 +154,19 @@ public:
             return ctx.fire_channel_write();
         }
 
-        send_data *snd_data = new send_data();                        //malloc should check
+        //pooled send data, one buffer of echo size
+        send_data *snd_data = ch->alloc_send_data(msg_body->m_echo.size());
+        if (nullptr == snd_data)
+        {
+            return ctx.fire_channel_write();
+        }
 
-        uv_ip4_addr(GET_IP(msg->get_dst_endpoint()), msg->get_dst_endpoint().port(), &snd_data->m_send_addr);
+        snd_data->m_send_addr = udp_address(msg->get_dst_endpoint());
 
-        snd_data->m_uv_buf = (uv_buf_t *)malloc(sizeof(uv_buf_t));
-        snd_data->m_uv_buf->base = (char *)malloc(msg_body->m_echo.size());
-        snd_data->m_uv_buf->len = (ULONG)msg_body->m_echo.size();
-        memcpy(snd_data->m_uv_buf->base, msg_body->m_echo.c_str(), snd_data->m_uv_buf->len);
+        memcpy(snd_data->m_uv_buf->base, msg_body->m_echo.c_str(), msg_body->m_echo.size());
 
-        ch->get_send_bufs().push_back(snd_data);
+        //write() runs encoder on caller thread, inbox push is safe there and wakes loop to send
+        ch->push_and_notify_async(snd_data);
 
         return ctx.fire_channel_write();
     }
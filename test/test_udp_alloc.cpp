@@ -0,0 +1,190 @@
+#include <test_udp_alloc.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+
+#define TEST_UDP_ALLOC_PORT                 39400
+#define TEST_UDP_ALLOC_PAYLOAD_LEN          512
+#define TEST_UDP_ALLOC_MAX_QUEUED           4096                //producer backs off above this send queue depth
+
+
+//localhost pps and heap allocations per datagram of pooled send data (alloc_send_data) against encoder style
+//heap send data (send_data, uv_buf and payload malloc'd, freed by free_send_data), batch 1 goes through uv_udp_send
+//and mallocs a request per heap datagram, batch 64 goes through sendmmsg; pooled count read from send pool heap counter
+//usage: test_udp_alloc [datagrams per run]
+class alloc_counter : public channel_inbound_handler
+{
+public:
+
+    void channel_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        if (ch->recv_buf()->get_valid_read_len() > 0)
+        {
+            m_received++;
+        }
+    }
+
+    void channel_batch_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        m_received += ch->recv_datagrams().size();
+    }
+
+    std::atomic<uint64_t> m_received{ 0 };
+};
+
+class alloc_initializer : public io_handler_initializer
+{
+public:
+
+    alloc_initializer(std::shared_ptr<alloc_counter> counter) : m_counter(counter) {}
+
+    void init(context_chain & chain)
+    {
+        chain.add_last("alloc counter", m_counter);
+    }
+
+    std::shared_ptr<alloc_counter> m_counter;
+};
+
+struct alloc_run
+{
+    uint32_t m_batch_size;
+
+    bool m_pooled;
+
+    std::shared_ptr<udp_channel> m_receiver;
+
+    std::shared_ptr<udp_channel> m_sender;
+
+    std::shared_ptr<alloc_counter> m_counter;
+};
+
+static std::shared_ptr<udp_channel> make_channel(uv_thread_pool *pool, uint16_t port, uint32_t batch_size, std::shared_ptr<alloc_counter> counter)
+{
+    udp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+
+    auto ch = std::make_shared<udp_channel>(pool, endpoint);
+    ch->set_batch_size(batch_size);
+    ch->channel_initializer(std::make_shared<alloc_initializer>(counter), std::make_shared<alloc_initializer>(counter));
+
+    return ERR_SUCCESS == ch->init() ? ch : nullptr;
+}
+
+//built the way encoders do it
+static send_data * heap_send_data(size_t len)
+{
+    send_data *snd_data = (send_data *)malloc(sizeof(send_data));
+    new (snd_data) send_data();
+
+    snd_data->m_uv_buf = (uv_buf_t *)malloc(sizeof(uv_buf_t));
+    snd_data->m_uv_buf->base = (char *)malloc(len);
+    snd_data->m_uv_buf->len = len;
+    snd_data->m_uv_buf_count = 1;
+
+    return snd_data;
+}
+
+int test_udp_alloc(int argc, char* argv[])
+{
+    uint64_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    //pools are never stopped, loops run until process exit
+    uv_thread_pool *send_pool = new uv_thread_pool();
+    uv_thread_pool *recv_pool = new uv_thread_pool();
+    send_pool->init();
+    recv_pool->init();
+
+    alloc_run runs[] = { { 1, false }, { 1, true }, { 64, false }, { 64, true } };
+
+    //channels of all runs registered before loops start, poll of a running loop is not woken for new fds
+    uint16_t port = TEST_UDP_ALLOC_PORT;
+    for (auto &run : runs)
+    {
+        run.m_counter = std::make_shared<alloc_counter>();
+        run.m_receiver = make_channel(recv_pool, port++, run.m_batch_size, run.m_counter);
+        run.m_sender = make_channel(send_pool, port++, run.m_batch_size, std::make_shared<alloc_counter>());
+
+        if (!run.m_receiver || !run.m_sender)
+        {
+            std::cout << "channel init failed" << std::endl;
+            return ERR_FAILED;
+        }
+    }
+
+    send_pool->start();
+    recv_pool->start();
+
+    std::cout << "payload " << TEST_UDP_ALLOC_PAYLOAD_LEN << " bytes" << std::endl;
+    std::cout << "batch\tsend data\tsent/s\treceived/s\tallocs/datagram\tloss %" << std::endl;
+
+    uint64_t heap_pps = 0;
+    for (auto &run : runs)
+    {
+        udp_address dst(run.m_receiver->get_local_endpoint());
+        uint64_t pool_heap_begin = run.m_sender->get_send_pool().heap_allocations();
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < count; )
+        {
+            send_data *snd_data = nullptr;
+            if (run.m_sender->get_send_queue_depth() < TEST_UDP_ALLOC_MAX_QUEUED)
+            {
+                snd_data = run.m_pooled ? run.m_sender->alloc_send_data(TEST_UDP_ALLOC_PAYLOAD_LEN) : heap_send_data(TEST_UDP_ALLOC_PAYLOAD_LEN);
+            }
+
+            if (nullptr == snd_data)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            memset(snd_data->m_uv_buf->base, 'x', TEST_UDP_ALLOC_PAYLOAD_LEN);
+            memcpy(snd_data->m_uv_buf->base, &i, sizeof(i));
+            snd_data->m_send_addr = dst;
+
+            run.m_sender->push_and_notify_async(snd_data);
+            i++;
+        }
+
+        double send_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        //receiver done when count stops moving
+        uint64_t received = 0;
+        auto last = begin;
+        do
+        {
+            received = run.m_counter->m_received;
+            last = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        } while (received != run.m_counter->m_received || run.m_sender->get_send_queue_depth() > 0);
+
+        double recv_seconds = std::chrono::duration<double>(last - begin).count();
+        uint64_t pps = (uint64_t)(received / recv_seconds);
+
+        //heap: send data, uv_buf, payload, plus request when sent through uv_udp_send; pooled: slab chunks and blocks only
+        double allocs = run.m_pooled ? (double)(run.m_sender->get_send_pool().heap_allocations() - pool_heap_begin) / count
+            : (1 == run.m_batch_size ? 4.0 : 3.0);
+
+        std::cout << run.m_batch_size << "\t" << (run.m_pooled ? "pooled" : "heap") << "\t" << (uint64_t)(count / send_seconds)
+            << "\t" << pps << "\t" << allocs << "\t" << 100.0 * (count - received) / count;
+
+        if (run.m_pooled && heap_pps > 0)
+        {
+            std::cout << "\tpps delta " << 100.0 * ((double)pps - heap_pps) / heap_pps << " %";
+        }
+
+        std::cout << std::endl;
+        heap_pps = run.m_pooled ? 0 : pps;
+    }
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
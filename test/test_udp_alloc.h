@@ -0,0 +1,7 @@
+#pragma once
+
+#include <io/udp_channel.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_udp_alloc(int argc, char* argv[]);
@@ -0,0 +1,162 @@
+#include <test_udp_gso.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+
+#define TEST_UDP_GSO_PORT                   39300
+#define TEST_UDP_GSO_PAYLOAD_LEN            1200
+#define TEST_UDP_GSO_BATCH_SIZE             64
+#define TEST_UDP_GSO_MAX_QUEUED             4096                //producer backs off above this send queue depth
+
+
+//localhost bulk throughput of udp_channel batch mode with gso send and gro receive off and on,
+//one destination so runs of queued send data go out as one gso super buffer; gro coalesced reads split in user space
+//usage: test_udp_gso [datagrams per run]
+class gso_counter : public channel_inbound_handler
+{
+public:
+
+    void channel_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        if (ch->recv_buf()->get_valid_read_len() > 0)
+        {
+            m_received++;
+        }
+    }
+
+    void channel_batch_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        m_received += ch->recv_datagrams().size();
+    }
+
+    std::atomic<uint64_t> m_received{ 0 };
+};
+
+class gso_initializer : public io_handler_initializer
+{
+public:
+
+    gso_initializer(std::shared_ptr<gso_counter> counter) : m_counter(counter) {}
+
+    void init(context_chain & chain)
+    {
+        chain.add_last("gso counter", m_counter);
+    }
+
+    std::shared_ptr<gso_counter> m_counter;
+};
+
+struct gso_run
+{
+    const char *m_name;
+
+    bool m_gso;
+
+    bool m_gro;
+
+    std::shared_ptr<udp_channel> m_receiver;
+
+    std::shared_ptr<udp_channel> m_sender;
+
+    std::shared_ptr<gso_counter> m_counter;
+};
+
+static std::shared_ptr<udp_channel> make_channel(uv_thread_pool *pool, uint16_t port, bool gso, bool gro, std::shared_ptr<gso_counter> counter)
+{
+    udp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+
+    auto ch = std::make_shared<udp_channel>(pool, endpoint);
+    ch->set_batch_size(TEST_UDP_GSO_BATCH_SIZE);
+    ch->set_gso(gso);
+    ch->set_gro(gro);
+    ch->channel_initializer(std::make_shared<gso_initializer>(counter), std::make_shared<gso_initializer>(counter));
+
+    return ERR_SUCCESS == ch->init() ? ch : nullptr;
+}
+
+int test_udp_gso(int argc, char* argv[])
+{
+    uint64_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    //pools are never stopped, loops run until process exit
+    uv_thread_pool *send_pool = new uv_thread_pool();
+    uv_thread_pool *recv_pool = new uv_thread_pool();
+    send_pool->init();
+    recv_pool->init();
+
+    gso_run runs[] = { { "off", false, false }, { "gso", true, false }, { "gso+gro", true, true } };
+
+    //channels of all runs registered before loops start, poll of a running loop is not woken for new fds
+    uint16_t port = TEST_UDP_GSO_PORT;
+    for (auto &run : runs)
+    {
+        run.m_counter = std::make_shared<gso_counter>();
+        run.m_receiver = make_channel(recv_pool, port++, false, run.m_gro, run.m_counter);
+        run.m_sender = make_channel(send_pool, port++, run.m_gso, false, std::make_shared<gso_counter>());
+
+        if (!run.m_receiver || !run.m_sender)
+        {
+            std::cout << "channel init failed" << std::endl;
+            return ERR_FAILED;
+        }
+    }
+
+    send_pool->start();
+    recv_pool->start();
+
+    std::cout << "payload " << TEST_UDP_GSO_PAYLOAD_LEN << " bytes, batch " << TEST_UDP_GSO_BATCH_SIZE << std::endl;
+    std::cout << "offload\tgso on\tgro on\tsent/s\treceived/s\tMB/s received\tloss %" << std::endl;
+
+    for (auto &run : runs)
+    {
+        udp_address dst(run.m_receiver->get_local_endpoint());
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < count; )
+        {
+            send_data *snd_data = run.m_sender->get_send_queue_depth() < TEST_UDP_GSO_MAX_QUEUED ? run.m_sender->alloc_send_data(TEST_UDP_GSO_PAYLOAD_LEN) : nullptr;
+            if (nullptr == snd_data)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            memset(snd_data->m_uv_buf->base, 'x', TEST_UDP_GSO_PAYLOAD_LEN);
+            memcpy(snd_data->m_uv_buf->base, &i, sizeof(i));
+            snd_data->m_send_addr = dst;
+
+            run.m_sender->push_and_notify_async(snd_data);
+            i++;
+        }
+
+        double send_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        //receiver done when count stops moving
+        uint64_t received = 0;
+        auto last = begin;
+        do
+        {
+            received = run.m_counter->m_received;
+            last = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        } while (received != run.m_counter->m_received || run.m_sender->get_send_queue_depth() > 0);
+
+        double recv_seconds = std::chrono::duration<double>(last - begin).count();
+
+        //offload turned off at init when kernel or device lacks it
+        std::cout << run.m_name << "\t" << run.m_sender->gso() << "\t" << run.m_receiver->gro() << "\t" << (uint64_t)(count / send_seconds)
+            << "\t" << (uint64_t)(received / recv_seconds) << "\t" << (uint64_t)(received * TEST_UDP_GSO_PAYLOAD_LEN / recv_seconds / 1000000)
+            << "\t" << 100.0 * (count - received) / count << std::endl;
+    }
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
@@ -0,0 +1,166 @@
+#include <test_udp_pps.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+
+#define TEST_UDP_PPS_PORT                   39100
+#define TEST_UDP_PPS_PAYLOAD_LEN            64
+#define TEST_UDP_PPS_MAX_QUEUED             4096                //producer backs off above this send queue depth
+
+
+//localhost datagram rate through udp_channel at recvmmsg / sendmmsg batch size 1 (libuv path), 16 and 64
+//producer threads push pooled send data with push_and_notify_async, receiver counts datagrams in read handlers
+//usage: test_udp_pps [datagrams per run] [producer threads]
+class pps_counter : public channel_inbound_handler, public channel_outbound_handler
+{
+public:
+
+    void channel_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        if (ch->recv_buf()->get_valid_read_len() > 0)
+        {
+            m_received++;
+        }
+    }
+
+    void channel_batch_read_complete(context_type &ctx)
+    {
+        auto ch = boost::any_cast<std::shared_ptr<udp_channel>>(ctx.get(std::string(IO_CONTEXT)));
+        m_received += ch->recv_datagrams().size();
+    }
+
+    std::atomic<uint64_t> m_received{ 0 };
+};
+
+class pps_initializer : public io_handler_initializer
+{
+public:
+
+    pps_initializer(std::shared_ptr<pps_counter> counter) : m_counter(counter) {}
+
+    void init(context_chain & chain)
+    {
+        chain.add_last("pps counter", m_counter);
+    }
+
+    std::shared_ptr<pps_counter> m_counter;
+};
+
+static std::shared_ptr<udp_channel> make_channel(uv_thread_pool *pool, uint16_t port, uint32_t batch_size, std::shared_ptr<pps_counter> counter)
+{
+    udp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+
+    auto ch = std::make_shared<udp_channel>(pool, endpoint);
+    ch->set_batch_size(batch_size);
+    ch->channel_initializer(std::make_shared<pps_initializer>(counter), std::make_shared<pps_initializer>(counter));
+
+    return ERR_SUCCESS == ch->init() ? ch : nullptr;
+}
+
+int test_udp_pps(int argc, char* argv[])
+{
+    uint64_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    uint32_t producers = argc > 2 ? std::max(1, atoi(argv[2])) : 1;
+
+    //pools are never stopped, loops run until process exit
+    uv_thread_pool *send_pool = new uv_thread_pool();
+    uv_thread_pool *recv_pool = new uv_thread_pool();
+    send_pool->init();
+    recv_pool->init();
+
+    //channels of all runs registered before loops start, poll of a running loop is not woken for new fds
+    uint32_t batch_sizes[] = { 1, 16, 64 };
+    std::vector<std::shared_ptr<pps_counter>> counters;
+    std::vector<std::shared_ptr<udp_channel>> receivers, senders;
+
+    uint16_t port = TEST_UDP_PPS_PORT;
+    for (uint32_t batch_size : batch_sizes)
+    {
+        counters.push_back(std::make_shared<pps_counter>());
+        receivers.push_back(make_channel(recv_pool, port++, batch_size, counters.back()));
+        senders.push_back(make_channel(send_pool, port++, batch_size, std::make_shared<pps_counter>()));
+
+        if (!receivers.back() || !senders.back())
+        {
+            std::cout << "channel init failed" << std::endl;
+            return ERR_FAILED;
+        }
+    }
+
+    send_pool->start();
+    recv_pool->start();
+
+    std::cout << "producers: " << producers << std::endl;
+    std::cout << "batch\tsent/s\treceived/s\tloss %" << std::endl;
+
+    for (size_t run = 0; run < receivers.size(); run++)
+    {
+        auto counter = counters[run];
+        auto receiver = receivers[run];
+        auto sender = senders[run];
+
+        udp_address dst(receiver->get_local_endpoint());
+        auto begin = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p]()
+            {
+                for (uint64_t i = p; i < count; )
+                {
+                    send_data *snd_data = sender->get_send_queue_depth() < TEST_UDP_PPS_MAX_QUEUED ? sender->alloc_send_data(TEST_UDP_PPS_PAYLOAD_LEN) : nullptr;
+                    if (nullptr == snd_data)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    memset(snd_data->m_uv_buf->base, 'x', TEST_UDP_PPS_PAYLOAD_LEN);
+                    memcpy(snd_data->m_uv_buf->base, &i, sizeof(i));
+                    snd_data->m_send_addr = dst;
+
+                    sender->push_and_notify_async(snd_data);
+                    i += producers;
+                }
+            });
+        }
+
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+
+        double send_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        //receiver done when count stops moving
+        uint64_t received = 0;
+        auto last = begin;
+        do
+        {
+            received = counter->m_received;
+            last = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        } while (received != counter->m_received || sender->get_send_queue_depth() > 0);
+
+        double recv_seconds = std::chrono::duration<double>(last - begin).count();
+
+        std::cout << batch_sizes[run] << "\t" << (uint64_t)(count / send_seconds) << "\t" << (uint64_t)(received / recv_seconds)
+            << "\t" << 100.0 * (count - received) / count << std::endl;
+    }
+
+    //loops never stop, keep pools and channels alive until process exit
+    new std::vector<std::shared_ptr<udp_channel>>(receivers.begin(), receivers.end());
+    new std::vector<std::shared_ptr<udp_channel>>(senders.begin(), senders.end());
+
+    fflush(stdout);
+    return ERR_SUCCESS;
+}
@@ -0,0 +1,354 @@
+#include <test_udp_reliable.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <memory>
+#include <iostream>
+#include <cstdlib>
+
+
+#define TEST_UDP_RELIABLE_PORT              39200
+#define TEST_UDP_RELIABLE_LOSS_RATE         0.2
+#define TEST_UDP_RELIABLE_DROP_MARK         "drop"              //message eaten by receiver link until sender gives up
+#define TEST_UDP_RELIABLE_TIMEOUT_S         60
+
+
+//ordered delivery over loopback with injected loss at recvmmsg batch size 1 and 16
+//random loss: every message delivered once and in order
+//give up: receiver link eats one message until sender abandons it; later messages still delivered,
+//failure functor sees it, handler after reliable one sees foreign datagrams only
+//restart: sender replaced by fresh handler on same port starts over at seq 0, new epoch makes receiver start over too
+//usage: test_udp_reliable [messages per run]
+class reliable_receiver
+{
+public:
+
+    void on_deliver(const char *data, size_t len)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_messages.push_back(std::string(data, len));
+    }
+
+    std::vector<std::string> messages()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_messages;
+    }
+
+    std::mutex m_mutex;
+
+    std::vector<std::string> m_messages;
+
+    std::atomic<uint64_t> m_foreign{ 0 };
+};
+
+//eats marked data datagrams before reliable handler sees them, forward and retransmits of others pass
+class drop_marked_handler : public channel_inbound_handler
+{
+public:
+
+    drop_marked_handler(udp_channel *channel) : m_channel(channel) {}
+
+    static bool marked(const char *data, size_t len)
+    {
+        size_t mark_len = strlen(TEST_UDP_RELIABLE_DROP_MARK);
+        return len >= mark_len && 0 == memcmp(data + len - mark_len, TEST_UDP_RELIABLE_DROP_MARK, mark_len);
+    }
+
+    void channel_read_complete(context_type &ctx) override
+    {
+        udp_channel::buf_ptr_type buf = m_channel->recv_buf();
+        if (!marked(buf->get_read_ptr(), buf->get_valid_read_len()))
+        {
+            ctx.fire_channel_read_complete();
+        }
+    }
+
+    void channel_batch_read_complete(context_type &ctx) override
+    {
+        m_channel->remove_datagrams([](const udp_datagram &datagram) { return marked(datagram.m_data, datagram.m_len); });
+        if (!m_channel->recv_datagrams().empty())
+        {
+            ctx.fire_channel_batch_read_complete();
+        }
+    }
+
+    udp_channel *m_channel;
+};
+
+class foreign_counter : public channel_inbound_handler
+{
+public:
+
+    foreign_counter(udp_channel *channel, reliable_receiver *receiver) : m_channel(channel), m_receiver(receiver) {}
+
+    void channel_read_complete(context_type &ctx) override
+    {
+        m_receiver->m_foreign++;
+    }
+
+    void channel_batch_read_complete(context_type &ctx) override
+    {
+        m_receiver->m_foreign += m_channel->recv_datagrams().size();
+    }
+
+    udp_channel *m_channel;
+
+    reliable_receiver *m_receiver;
+};
+
+class reliable_initializer : public io_handler_initializer
+{
+public:
+
+    reliable_initializer(udp_channel *channel, reliable_receiver *receiver, bool drop_marked)
+        : m_channel(channel), m_receiver(receiver), m_drop_marked(drop_marked) {}
+
+    void init(context_chain & chain)
+    {
+        reliable_receiver *receiver = m_receiver;
+        m_handler = std::make_shared<udp_reliable_handler>(m_channel, [receiver](udp_reliable_handler &, const udp_address &, const char *data, size_t len)
+        {
+            receiver->on_deliver(data, len);
+        });
+
+        if (m_drop_marked)
+        {
+            chain.add_last("drop marked", std::make_shared<drop_marked_handler>(m_channel));
+        }
+
+        chain.add_last("reliable", m_handler);
+        chain.add_last("foreign", std::make_shared<foreign_counter>(m_channel, m_receiver));
+    }
+
+    udp_channel *m_channel;
+
+    reliable_receiver *m_receiver;
+
+    bool m_drop_marked;
+
+    std::shared_ptr<udp_reliable_handler> m_handler;
+};
+
+class reliable_peer
+{
+public:
+
+    std::shared_ptr<udp_channel> m_channel;
+
+    std::shared_ptr<reliable_initializer> m_initializer;
+
+    reliable_receiver m_receiver;
+
+    udp_reliable_handler & handler() { return *m_initializer->m_handler; }
+};
+
+static int32_t make_peer(reliable_peer &peer, uv_thread_pool *pool, uint16_t port, uint32_t batch_size, bool drop_marked)
+{
+    udp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+
+    peer.m_channel = std::make_shared<udp_channel>(pool, endpoint);
+    peer.m_channel->set_batch_size(batch_size);
+
+    //inbound initializer builds handler, outbound chain left empty
+    peer.m_initializer = std::make_shared<reliable_initializer>(peer.m_channel.get(), &peer.m_receiver, drop_marked);
+    peer.m_channel->channel_initializer(peer.m_initializer, std::make_shared<default_initializer>());
+
+    return peer.m_channel->init();
+}
+
+static bool wait_for(std::function<bool()> done)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TEST_UDP_RELIABLE_TIMEOUT_S);
+    while (!done())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return true;
+}
+
+static bool check_in_order(const std::vector<std::string> &got, const std::vector<std::string> &expected)
+{
+    if (got != expected)
+    {
+        std::cout << "delivered " << got.size() << " expected " << expected.size() << ", order or content differs" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static int32_t run_loss(reliable_peer &sender, reliable_peer &receiver, uint32_t batch_size, uint32_t count)
+{
+    sender.handler().set_loss_rate(TEST_UDP_RELIABLE_LOSS_RATE);
+    receiver.handler().set_loss_rate(TEST_UDP_RELIABLE_LOSS_RATE);
+
+    udp_address dst(receiver.m_channel->get_local_endpoint());
+    std::vector<std::string> expected;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        expected.push_back("message " + std::to_string(i));
+        sender.handler().send(dst, expected.back().data(), expected.back().size());
+    }
+
+    bool done = wait_for([&]() { return receiver.m_receiver.messages().size() >= count && 0 == sender.handler().pending(dst); });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    udp_reliable_stats stats = sender.handler().stats();
+    std::cout << "loss " << TEST_UDP_RELIABLE_LOSS_RATE * 100 << "%, batch " << batch_size << ": " << count << " messages in " << seconds << " s, sent " << stats.m_sent
+        << " retransmitted " << stats.m_retransmitted << " injected losses " << stats.m_injected_losses + receiver.handler().stats().m_injected_losses
+        << " failed " << stats.m_failed << std::endl;
+
+    return done && 0 == stats.m_failed && check_in_order(receiver.m_receiver.messages(), expected) ? ERR_SUCCESS : ERR_FAILED;
+}
+
+static int32_t run_give_up(reliable_peer &sender, reliable_peer &receiver, uint32_t batch_size)
+{
+    std::mutex mutex;
+    std::vector<std::string> failed;
+
+    sender.handler().set_failed([&](udp_reliable_handler &, const udp_address &, const char *data, size_t len)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        failed.push_back(std::string(data, len));
+    });
+
+    udp_address dst(receiver.m_channel->get_local_endpoint());
+    std::vector<std::string> expected;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        std::string msg = "message " + std::to_string(i) + (5 == i ? " " TEST_UDP_RELIABLE_DROP_MARK : "");
+        if (5 != i)
+        {
+            expected.push_back(msg);
+        }
+
+        sender.handler().send(dst, msg.data(), msg.size());
+    }
+
+    //datagram without reliable framing goes past reliable handler
+    boost::asio::io_context io;
+    boost::asio::ip::udp::socket raw(io, boost::asio::ip::udp::v4());
+    raw.send_to(boost::asio::buffer("foreign", 7), receiver.m_channel->get_local_endpoint());
+
+    bool done = wait_for([&]() { return receiver.m_receiver.messages().size() >= expected.size() && 0 == sender.handler().pending(dst); });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    std::cout << "give up, batch " << batch_size << ": " << receiver.m_receiver.messages().size() << " of 10 delivered in " << seconds << " s, failed "
+        << failed.size() << ", foreign " << receiver.m_receiver.m_foreign << std::endl;
+
+    return done && 1 == failed.size() && failed[0] == "message 5 " TEST_UDP_RELIABLE_DROP_MARK && 1 == receiver.m_receiver.m_foreign
+        && 0 == sender.m_receiver.m_foreign && check_in_order(receiver.m_receiver.messages(), expected) ? ERR_SUCCESS : ERR_FAILED;
+}
+
+static int32_t send_batch(reliable_peer &sender, reliable_peer &receiver, const std::string &prefix, std::vector<std::string> &expected)
+{
+    udp_address dst(receiver.m_channel->get_local_endpoint());
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        expected.push_back(prefix + " " + std::to_string(i));
+        sender.handler().send(dst, expected.back().data(), expected.back().size());
+    }
+
+    return wait_for([&]() { return receiver.m_receiver.messages().size() >= expected.size() && 0 == sender.handler().pending(dst); }) ? ERR_SUCCESS : ERR_FAILED;
+}
+
+//new sender binds port of closed one on its own pool, as restarted process would
+static int32_t run_restart(reliable_peer &old_sender, reliable_peer &receiver, uint32_t batch_size)
+{
+    std::vector<std::string> expected;
+    if (ERR_SUCCESS != send_batch(old_sender, receiver, "before restart", expected))
+    {
+        std::cout << "restart, batch " << batch_size << ": first session not delivered" << std::endl;
+        return ERR_FAILED;
+    }
+
+    old_sender.m_channel->close_async();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    uv_thread_pool *pool = new uv_thread_pool();
+    pool->init();
+
+    reliable_peer *new_sender = new reliable_peer();
+    if (ERR_SUCCESS != make_peer(*new_sender, pool, old_sender.m_channel->get_local_endpoint().port(), batch_size, false))
+    {
+        std::cout << "restart, batch " << batch_size << ": channel init failed" << std::endl;
+        return ERR_FAILED;
+    }
+
+    pool->start();
+
+    int32_t ret = send_batch(*new_sender, receiver, "after restart", expected);
+
+    std::cout << "restart, batch " << batch_size << ": " << receiver.m_receiver.messages().size() << " of " << expected.size() << " delivered, duplicates "
+        << receiver.handler().stats().m_duplicates << std::endl;
+
+    return ERR_SUCCESS == ret && check_in_order(receiver.m_receiver.messages(), expected) ? ERR_SUCCESS : ERR_FAILED;
+}
+
+int test_udp_reliable(int argc, char* argv[])
+{
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+
+    //pools are never stopped, loops run until process exit
+    uv_thread_pool *pool = new uv_thread_pool();
+    pool->init();
+
+    //channels registered before loop starts, poll of a running loop is not woken for new fds
+    uint32_t batch_sizes[] = { 1, 16 };
+    std::vector<reliable_peer *> peers;
+
+    uint16_t port = TEST_UDP_RELIABLE_PORT;
+    for (uint32_t batch_size : batch_sizes)
+    {
+        //loss run, give up run, then restart run sender and receiver
+        for (int i = 0; i < 6; i++)
+        {
+            peers.push_back(new reliable_peer());
+            if (ERR_SUCCESS != make_peer(*peers.back(), pool, port++, batch_size, 3 == i))
+            {
+                std::cout << "channel init failed" << std::endl;
+                return ERR_FAILED;
+            }
+        }
+    }
+
+    pool->start();
+
+    int32_t ret = ERR_SUCCESS;
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+    {
+        if (ERR_SUCCESS != run_loss(*peers[i * 6], *peers[i * 6 + 1], batch_sizes[i], count))
+        {
+            ret = ERR_FAILED;
+        }
+
+        if (ERR_SUCCESS != run_give_up(*peers[i * 6 + 2], *peers[i * 6 + 3], batch_sizes[i]))
+        {
+            ret = ERR_FAILED;
+        }
+
+        if (ERR_SUCCESS != run_restart(*peers[i * 6 + 4], *peers[i * 6 + 5], batch_sizes[i]))
+        {
+            ret = ERR_FAILED;
+        }
+    }
+
+    std::cout << (ERR_SUCCESS == ret ? "passed" : "FAILED") << std::endl;
+
+    fflush(stdout);
+    return ret;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <io/udp_reliable.hpp>
+
+using namespace micro::core;
+
+extern "C" int test_udp_reliable(int argc, char* argv[]);